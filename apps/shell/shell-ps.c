@@ -59,7 +59,17 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   for(p = PROCESS_LIST(); p != NULL; p = p->next) {
     char namebuf[30];
     strncpy(namebuf, PROCESS_NAME_STRING(p), sizeof(namebuf));
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+    {
+      /* CPU time the process has used since boot */
+      char timebuf[16];
+      snprintf(timebuf, sizeof(timebuf), " %lu ms",
+               (unsigned long)(energest_process_time(p) * 1000 / RTIMER_SECOND));
+      shell_output_str(&ps_command, namebuf, timebuf);
+    }
+#else
     shell_output_str(&ps_command, namebuf, "");
+#endif
   }
 
   PROCESS_END();
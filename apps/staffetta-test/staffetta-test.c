@@ -39,7 +39,7 @@ PROCESS_THREAD(staffetta_test, ev, data){
     while(1){
 		wakeups = getWakeups(); //Get wakeups/period from Staffetta
 		Tw = ((CLOCK_SECOND*(10*BUDGET_PRECISION))/wakeups); //Compute Tw
-		etimer_set(&et,((Tw*3)/4) + (random_rand()%(Tw/2))); //Add some randomness
+		etimer_set(&et,staffetta_wakeup_delay(((Tw*3)/4) + (random_rand()%(Tw/2)))); //Add some randomness
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
 		staffetta_result = staffetta_send_packet(); //Perform a data exchange
 		//TODO compute histogram of staffetta results
@@ -58,6 +58,7 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#include "sys/profile.h"
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -1100,6 +1101,7 @@ cfs_read(int fd, void *buf, unsigned size)
   unsigned bytes_left;
   int r;
 #endif
+  PROFILE_SCOPE(COFFEE_READ);
 
   if(!(FD_VALID(fd) && FD_READABLE(fd))) {
     return -1;
@@ -1157,6 +1159,7 @@ cfs_write(int fd, const void *buf, unsigned size)
   cfs_offset_t bytes_left;
   const char dummy[1] = { 0xff };
 #endif
+  PROFILE_SCOPE(COFFEE_WRITE);
 
   if(!(FD_VALID(fd) && FD_WRITABLE(fd))) {
     return -1;
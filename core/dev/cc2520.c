@@ -331,6 +331,7 @@ cc2520_init(void)
 
   flushrx();
 
+  process_set_priority(&cc2520_process, PROCESS_PRIORITY_HIGH);
   process_start(&cc2520_process, NULL);
   return 1;
 }
@@ -8,6 +8,9 @@
 #include "staffetta.h"
 #include "node-id.h"
 #include "dev/gpio.h"
+#include "sys/profile.h"
+#include "sys/stack-check.h"
+#include "lib/msgq.h"
 
 /*---------------------------VARIABLES------------------------------------------------*/
 
@@ -31,18 +34,45 @@ static uint32_t avg_edc;
 #endif
 
 // Data exchange
-static uint8_t mySeq,data[DATA_SIZE],seq[DATA_SIZE],ttl[DATA_SIZE];
-static uint8_t read_idx,write_idx,q_size;
-static uint8_t unique_bitmap[10000/8] = {0};
+static uint16_t data[DATA_SIZE];
+static uint8_t mySeq,seq[DATA_SIZE],ttl[DATA_SIZE];
+static uint16_t qtime[DATA_SIZE]; // clock_seconds() when the packet was queued
+static uint16_t read_idx,write_idx,q_size;
+// Queue dedup: queue indexes hashed on (origin,seq), chained through dup_next
+static uint16_t dup_bucket[DEDUP_BUCKETS];
+static uint16_t dup_next[DATA_SIZE];
+static uint16_t fwd_data[LOOP_HISTORY]; // packets we forwarded last, to detect loops
+static uint8_t fwd_seq[LOOP_HISTORY],fwd_idx;
+static uint16_t loops,dropped_hops,dropped_expired;
 
 #if WITH_AGGREGATE
 static uint8_t aggregateValue;
 #endif
 
+#if WITH_SINK
+// Sink accounting
+static struct sink_origin sink_origins[SINK_MAX_ORIGINS];
+static uint8_t sink_dirty[(SINK_MAX_ORIGINS+7)/8];
+static uint16_t sink_num_origins,sink_report_idx;
+static uint32_t sink_received,sink_expected,sink_dups,sink_late,sink_unknown;
+static clock_time_t sink_last_report;
+// Deliveries waiting to be printed
+struct sink_delivery {
+    uint32_t received;
+    uint16_t origin;
+    uint8_t seq,hops,complete;
+};
+MSGQ(sink_uplink, struct sink_delivery, SINK_UPLINK_QUEUE);
+PROCESS(sink_uplink_process, "Staffetta sink uplink");
+#endif
+
 // Staffetta
 static uint32_t num_wakeups = 10;
 static uint8_t fast_forward = 0;
 static int p_retx = 50;
+#if SINK_DUTY_CYCLE
+static uint8_t sink_in_range = 0; // a duty-cycled sink acked our last strobe train
+#endif
 static enum mac_state current_state = disabled;
 
 static struct pt pt;
@@ -50,9 +80,20 @@ static struct pt pt;
 // Our variables.
 static uint8_t hop_count = 0;
 static uint32_t duty_cycle = 100;
-static uint8_t history[NUM_OF_HISTORY] = {0};
+static uint16_t history[NUM_OF_HISTORY] = {0};
 static uint8_t history_idx = 0;
 
+// Energy accounting
+static uint8_t phase = PHASE_NONE;
+static energest_time_t phase_time[NUM_PHASES]; // radio time spent in each phase
+static energest_time_t phase_tx[NUM_PHASES]; // TRANSMIT time spent in each phase
+static rtimer_clock_t phase_start;
+static energest_time_t phase_tx_start;
+
+#if SYNC_WAKEUP
+static rtimer_clock_t sync_sleep; // radio off time between the slots of our strobe train
+#endif
+
 static uint8_t sqrt(uint8_t n)
 {
 	int i;
@@ -64,7 +105,7 @@ static uint8_t sqrt(uint8_t n)
 	return i-1;
 }
 
-static uint8_t check_history(uint8_t id) // 1 if all is same with 'id'
+static uint8_t check_history(uint16_t id) // 1 if all is same with 'id'
 {
 	int i=0, n=0;
 	int r = sqrt(NUM_OF_NODES);
@@ -141,10 +182,91 @@ static inline void radio_flush_rx(void) {
     FASTSPI_STROBE(CC2420_SFLUSHRX);
 }
 
+// Write a frame to the TXFIFO. Synchronized wakeups stamp it with our time.
+static void radio_write(uint8_t *pkt) {
+#if SYNC_WAKEUP
+    rtimer_clock_t now;
+    int level;
+    level = timesynch_authority_level();
+    now = timesynch_time() + SYNC_TX_DELAY;
+    PKT_SYNC(pkt)[PKT_SYNC_LEVEL] = MIN(level, SYNC_LEVEL_NONE);
+    PKT_SYNC(pkt)[PKT_SYNC_TIME] = now & 0xff;
+    PKT_SYNC(pkt)[PKT_SYNC_TIME+1] = now >> 8;
+#endif
+    FASTSPI_WRITE_FIFO(pkt, PKT_TX_LEN(pkt));
+}
+
+// Send the frame in the TXFIFO. The radio goes back to RX when it is out.
+static inline void radio_tx(void) {
+    ENERGEST_OFF(ENERGEST_TYPE_LISTEN);
+    ENERGEST_ON(ENERGEST_TYPE_TRANSMIT);
+    FASTSPI_STROBE(CC2420_STXON);
+    //We wait until transmission has ended
+    BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+    ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
+    ENERGEST_ON(ENERGEST_TYPE_LISTEN);
+}
+
+/*--------------------------- ENERGY FUNCTIONS ------------------------------------------------*/
+
+/*
+ * The radio time of an exchange is split into phases, timed here with the
+ * rtimer like the energest types (a phase lasts less than a wrap of it):
+ *   BACKOFF       listening for beacons before strobing
+ *   STROBE        sending beacons
+ *   STROBE_WAIT   listening for a beacon ack after each beacon
+ *   ACK           sending a beacon ack (or NACK) and waiting for the select
+ *   SELECT        sending the select
+ *   FAST_FORWARD  the beacons and waits of a packet forwarded right away
+ * A phase may mix RX and TX, so the TRANSMIT time spent in it is kept too.
+ */
+static void phase_enter(uint8_t type) {
+#if ENERGEST_CONF_ON
+    if (phase != PHASE_NONE) {
+		phase_time[phase] += (rtimer_clock_t)(RTIMER_NOW() - phase_start);
+		phase_tx[phase] += energest_type_time_wide(ENERGEST_TYPE_TRANSMIT) - phase_tx_start;
+    }
+    phase = type;
+    if (phase != PHASE_NONE) {
+		phase_tx_start = energest_type_time_wide(ENERGEST_TYPE_TRANSMIT);
+		phase_start = RTIMER_NOW();
+    }
+#endif
+}
+
+// Energy (uJ) of 'rx' ticks in RX and 'tx' ticks in TX, reported modulo 2^32
+static uint32_t radio_energy(uint64_t rx, uint64_t tx) {
+    return (uint32_t)((rx * CURRENT_RX + tx * CURRENT_TX) * SUPPLY_VOLTAGE / 1000 / RTIMER_ARCH_SECOND);
+}
+
+static uint32_t phase_energy(uint8_t type) {
+#if ENERGEST_CONF_ON
+    return radio_energy(phase_time[type] - phase_tx[type], phase_tx[type]);
+#else
+    return 0;
+#endif
+}
+
+static void phase_report(void) {
+    // 9 total backoff strobe strobe_wait ack select fast_forward: Radio energy (uJ) since boot, per phase
+    printf("9 %lu %lu %lu %lu %lu %lu %lu\n",
+		radio_energy(energest_type_time_wide(ENERGEST_TYPE_LISTEN), energest_type_time_wide(ENERGEST_TYPE_TRANSMIT)),
+		phase_energy(PHASE_BACKOFF), phase_energy(PHASE_STROBE),
+		phase_energy(PHASE_STROBE_WAIT), phase_energy(PHASE_ACK),
+		phase_energy(PHASE_SELECT), phase_energy(PHASE_FAST_FORWARD));
+}
+
+// Radio on time, per mill of the time since boot
+static uint32_t radio_duty_cycle(void) {
+    energest_time_t on = energest_type_time_wide(ENERGEST_TYPE_LISTEN) + energest_type_time_wide(ENERGEST_TYPE_TRANSMIT);
+    energest_time_t all = energest_type_time_wide(ENERGEST_TYPE_CPU) + energest_type_time_wide(ENERGEST_TYPE_LPM);
+    return (uint32_t)((1000 * on) / all);
+}
+
 /*--------------------------- DC FUNCTIONS ------------------------------------------------*/
 
 static void powercycle_turn_radio_off(void) {
-    if ((current_state == idle) && !(IS_SINK)){
+    if ((current_state == idle) && !(SINK_ALWAYS_ON)){
 		radio_off();
 		leds_off(LEDS_BLUE);
     }
@@ -161,6 +283,7 @@ static void powercycle_turn_radio_on(void) {
 }
 
 static void goto_idle() {
+    phase_enter(PHASE_NONE);
     radio_flush_rx();
     radio_flush_tx();
     current_state = idle;
@@ -174,6 +297,9 @@ static void goto_idle() {
 /*--------------------------- DATA FUNCTIONS ------------------------------------------------*/
 
 uint32_t getWakeups(){
+#if SINK_DUTY_CYCLE
+    if (IS_SINK) return SINK_WAKEUPS;
+#endif
     return MIN(num_wakeups, 25);
 }
 
@@ -182,35 +308,50 @@ uint32_t get_duty_cycle()
 	return duty_cycle;
 }
 
-static void set_bitmap(int idx){
-    unique_bitmap[idx / 8] |= 1 << (idx % 8);
+static uint8_t dedup_hash(uint16_t _data, uint8_t _seq){
+    return (uint8_t)((_data * 31u + _seq) % DEDUP_BUCKETS);
 }
 
-static void clear_bitmap (int idx){
-    unique_bitmap[idx / 8] &= ~(1 << (idx % 8));
+static int is_queued(uint16_t _data, uint8_t _seq){
+    uint16_t i;
+    for (i = dup_bucket[dedup_hash(_data,_seq)]; i != DEDUP_NONE; i = dup_next[i]) {
+		if ((data[i] == _data) && (seq[i] == _seq)) return 1;
+    }
+    return 0;
 }
 
-static uint8_t get_bitmap(int idx){
-    return (unique_bitmap[idx / 8] >> (idx % 8)) & 1;
+static void dedup_remove(uint16_t idx){
+    uint16_t *p;
+    p = &dup_bucket[dedup_hash(data[idx],seq[idx])];
+    while (*p != DEDUP_NONE) {
+		if (*p == idx) {
+		    *p = dup_next[idx];
+		    return;
+		}
+		p = &dup_next[*p];
+    }
 }
 
-static int add_data(uint8_t _data, uint8_t _ttl, uint8_t _seq){
-    int next_idx, _unique;
-    _unique = (_data-1)*100 + _seq;
-    if(get_bitmap(_unique)) return 0; // if the message is already in the queue, do not add it again
-    set_bitmap(_unique);
+static int add_data(uint16_t _data, uint8_t _ttl, uint8_t _seq){
+    uint16_t next_idx;
+    uint8_t h;
+    if (_data == 0) return 0; // do not add 0 data
+    if (is_queued(_data,_seq)) return 0; // if the message is already in the queue, do not add it again
     next_idx = (write_idx+1)%DATA_SIZE;
     if (next_idx == read_idx) return 0; // error if queue is full
-    if (_data == 0) return 0; // do not add 0 data
     data[write_idx] = _data;
     ttl[write_idx] = _ttl;
     seq[write_idx] = _seq;
+    qtime[write_idx] = (uint16_t)clock_seconds();
+    h = dedup_hash(_data,_seq);
+    dup_next[write_idx] = dup_bucket[h];
+    dup_bucket[h] = write_idx;
     write_idx = next_idx;
     q_size++;
     return 1;
 }
 
-static uint8_t read_data(){
+static uint16_t read_data(){
     if (read_idx == write_idx) return 0;
     return data[read_idx];
 }
@@ -225,35 +366,215 @@ static uint8_t read_ttl(){
     return ttl[read_idx];
 }
 
-static uint8_t pop_data(){
-    uint8_t _data,_seq;
-    int _unique;
+// seconds spent in the queue by the oldest packet
+static uint16_t read_age(){
+    if (read_idx == write_idx) return 0;
+    return (uint16_t)clock_seconds() - qtime[read_idx];
+}
+
+static uint16_t pop_data(){
+    uint16_t _data;
     if (read_idx == write_idx) return 0; // error if queue is empty
     _data = data[read_idx];
-    _seq = seq[read_idx];
-    _unique = (_data-1)*100 + _seq;
-    clear_bitmap(_unique);
+    dedup_remove(read_idx);
     read_idx = (read_idx+1)%DATA_SIZE;
     q_size--;
     return _data;
 }
 
+// Remember a packet we handed to a forwarder
+static void fwd_add(uint16_t _data, uint8_t _seq){
+    fwd_data[fwd_idx] = _data;
+    fwd_seq[fwd_idx] = _seq;
+    fwd_idx = (fwd_idx+1)%LOOP_HISTORY;
+}
+
+// A packet that we generated or forwarded recently is coming back to us
+static int is_loop(uint16_t _data, uint8_t _seq){
+    uint8_t i;
+    if (_data == node_id) return 1;
+    for (i=0;i<LOOP_HISTORY;i++) {
+		if ((fwd_data[i] == _data) && (fwd_seq[i] == _seq)) return 1;
+    }
+    return 0;
+}
+
+// Drop the packets at the head of the queue that should not be forwarded anymore:
+// too many hops (they are looping) or too long in the queue
+static void queue_expire(void){
+    while (read_idx != write_idx) {
+		if (read_ttl() >= MAX_HOPS) {
+		    dropped_hops++;
+#if MAX_QUEUE_AGE
+		} else if (read_age() >= MAX_QUEUE_AGE) {
+		    dropped_expired++;
+#endif
+		} else {
+		    break;
+		}
+		pop_data();
+    }
+}
+
+/*--------------------------- FRAME FUNCTIONS ------------------------------------------------*/
+
+static uint16_t pkt_get_addr(const uint8_t *pkt, uint8_t lo, uint8_t hi){
+    if (PKT_IS_EXT(pkt)) return pkt[lo] | ((uint16_t)pkt[hi] << 8);
+    if (pkt[lo] == STAFFETTA_SHORT_NONE) return STAFFETTA_ADDR_NONE;
+    return pkt[lo];
+}
+
+#define PKT_GET_SRC(p)   pkt_get_addr((p), PKT_SRC, PKT_SRC_HI)
+#define PKT_GET_DST(p)   pkt_get_addr((p), PKT_DST, PKT_DST_HI)
+#define PKT_GET_DATA(p)  pkt_get_addr((p), PKT_DATA, PKT_DATA_HI)
+
+// Set type, addresses and length. The high bytes are only sent if an address does not fit in one byte.
+static void pkt_set_header(uint8_t *pkt, uint8_t type, uint16_t src, uint16_t dst, uint16_t _data){
+    if (STAFFETTA_ADDR_IS_SHORT(src) && STAFFETTA_ADDR_IS_SHORT(dst) && STAFFETTA_ADDR_IS_SHORT(_data)) {
+		pkt[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
+		pkt[PKT_TYPE] = type;
+    } else {
+		pkt[PKT_LEN] = STAFFETTA_PKT_LEN+STAFFETTA_EXT_LEN+FOOTER_LEN;
+		pkt[PKT_TYPE] = type | TYPE_FLAG_EXT_ADDR;
+		pkt[PKT_SRC_HI] = src >> 8;
+		pkt[PKT_DST_HI] = dst >> 8;
+		pkt[PKT_DATA_HI] = _data >> 8;
+    }
+#if SYNC_WAKEUP
+    // the sync bytes are filled in by radio_write()
+    pkt[PKT_LEN] += STAFFETTA_SYNC_LEN;
+    pkt[PKT_TYPE] |= TYPE_FLAG_SYNC;
+#endif
+    pkt[PKT_SRC] = src & 0xff;
+    pkt[PKT_DST] = dst & 0xff;
+    pkt[PKT_DATA] = _data & 0xff;
+}
+
+// Read a whole frame (length byte, payload and footer) from the RXFIFO. Return 0 on a bad length or timeout.
+static int radio_read_frame(uint8_t *pkt){
+    rtimer_clock_t t,t_rx;
+    uint8_t bytes_read;
+    t_rx = RTIMER_NOW ();
+    t = t_rx; while(RTIMER_CLOCK_LT (RTIMER_NOW (), t + 3));
+    FASTSPI_READ_FIFO_BYTE(pkt[PKT_LEN]);
+    //check if the packet size is right
+    if ((pkt[PKT_LEN] < STAFFETTA_PKT_LEN+FOOTER_LEN) || (pkt[PKT_LEN] > STAFFETTA_MAX_PKT_LEN+FOOTER_LEN)) {
+		return 0;
+    }
+    for (bytes_read = 1; bytes_read < pkt[PKT_LEN]+1; bytes_read++) {
+		t = RTIMER_NOW ();
+		// wait until the FIFO pin is 1 (until one more byte is received)
+		while (!FIFO_IS_1) {
+		    if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t + RTIMER_ARCH_SECOND/200)) {
+				return 0;
+		    }
+		};
+		FASTSPI_READ_FIFO_BYTE(pkt[bytes_read]); // read another byte from the RXFIFO
+    }
+#if SYNC_WAKEUP
+    // synchronize to nodes closer to the time reference
+    if ((pkt[PKT_TYPE] & TYPE_FLAG_SYNC) && (PKT_CRC_BYTE(pkt) & FOOTER1_CRC_OK)) {
+		timesynch_incoming(PKT_SYNC(pkt)[PKT_SYNC_LEVEL],
+			PKT_SYNC(pkt)[PKT_SYNC_TIME] | (PKT_SYNC(pkt)[PKT_SYNC_TIME+1] << 8), t_rx);
+    }
+#endif
+    return 1;
+}
+
 /*--------------------------- STAFFETTA FUNCTIONS ------------------------------------------------*/
 
+#if SINK_DUTY_CYCLE && WITH_SINK
+static int sink_listen_window(void);
+#endif
+
+#if SYNC_WAKEUP
+static int sync_ok(void){
+    return timesynch_authority_level() < SYNC_LEVEL_NONE;
+}
+
+// Our wakeup time in a slot: nodes closer to the sink (more wakeups) wake up later than their children
+static rtimer_clock_t sync_offset(void){
+    return MIN(num_wakeups, SYNC_MAX_GRADIENT) * SYNC_STEP + random_rand() % SYNC_JITTER;
+}
+
+static struct rtimer sync_rtimer;
+static volatile uint8_t sync_rtimer_fired;
+
+static void sync_rtimer_callback(struct rtimer *t, void *ptr){
+    sync_rtimer_fired = 1;
+}
+
+// Wait until 'offset' in the next slot. The radio should be off: the CPU sleeps until the rtimer fires.
+static void sync_wait(rtimer_clock_t offset){
+    rtimer_clock_t t0,d;
+    d = (rtimer_clock_t)(offset - timesynch_time()) % SYNC_SLOT;
+    t0 = RTIMER_NOW();
+    sync_rtimer_fired = 0;
+    if (d < SYNC_MIN_SLEEP || rtimer_set(&sync_rtimer, t0 + d, 1, sync_rtimer_callback, NULL) != RTIMER_OK) {
+		while(RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + d));
+		return;
+    }
+    ENERGEST_OFF(ENERGEST_TYPE_CPU);
+    ENERGEST_ON(ENERGEST_TYPE_LPM);
+    STAFFETTA_SLEEP_WHILE(!sync_rtimer_fired);
+    ENERGEST_OFF(ENERGEST_TYPE_LPM);
+    ENERGEST_ON(ENERGEST_TYPE_CPU);
+}
+#endif
+
+// Time to sleep before the next staffetta_send_packet(), given the random 'delay' of the application.
+// Synchronized nodes wake up at the start of the slot the delay ends in, staffetta_send_packet() waits for their offset.
+clock_time_t staffetta_wakeup_delay(clock_time_t delay){
+#if SYNC_WAKEUP
+    clock_time_t late;
+    if (sync_ok()) {
+		late = ((rtimer_clock_t)(timesynch_time() + (unsigned long)delay * (RTIMER_ARCH_SECOND/CLOCK_SECOND)) % SYNC_SLOT)
+			/ (RTIMER_ARCH_SECOND/CLOCK_SECOND) + 1;
+		delay = (delay > late) ? delay - late : 1;
+    }
+#endif
+    return delay;
+}
+
+// After receiving a packet, decide whether to forward it right away instead of going back to sleep.
+// Congested or slow queues forward immediately, as long as the energy budget allows it.
+static int should_fast_forward(void){
+#if FAST_FORWARD
+    return 1;
+#elif ADAPTIVE_FF
+    if (duty_cycle >= FF_DUTY_LIMIT) return 0;
+    return (q_size >= FF_QUEUE_THRESHOLD) || (read_age() >= FF_AGE_THRESHOLD);
+#else
+    return 0;
+#endif
+}
+
 int staffetta_send_packet(void) {
     rtimer_clock_t t0,t1,t2;
-    uint8_t strobe[STAFFETTA_PKT_LEN+3];
-    uint8_t strobe_ack[STAFFETTA_PKT_LEN+3];
-    uint8_t select[STAFFETTA_PKT_LEN+3];
+    uint8_t strobe[STAFFETTA_MAX_PKT_LEN+3];
+    uint8_t strobe_ack[STAFFETTA_MAX_PKT_LEN+3];
+    uint8_t select[STAFFETTA_MAX_PKT_LEN+3];
     uint8_t footer[2];
-    int i,collisions,strobes,bytes_read;
+    int i,collisions,strobes;
+    rtimer_clock_t strobe_time = STROBE_TIME;
+    PROFILE_SCOPE(STAFFETTA_SEND);
+
+#if SINK_DUTY_CYCLE
+#if WITH_SINK
+    if (IS_SINK) return sink_listen_window();
+#endif
+    //the sink wakes up at least every SINK_STROBE_TIME, no need to strobe longer if it is our neighbor
+    if (sink_in_range) strobe_time = SINK_STROBE_TIME;
+#endif
 
     //prepare strobe_ack packet
-    strobe_ack[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
-    strobe_ack[PKT_SRC] = node_id;
-    strobe_ack[PKT_TYPE] = TYPE_BEACON_ACK;
     strobe_ack[PKT_GRADIENT] = 0;
 
+#if SYNC_WAKEUP
+    sync_sleep = 0;
+    if (sync_ok()) sync_wait(sync_offset());
+#endif
+
     //turn radio on
     radio_on();
     radio_flush_rx();
@@ -264,49 +585,29 @@ int staffetta_send_packet(void) {
     rendezvous_starting_time = RTIMER_NOW();
 
     //start backoff
+    phase_enter(PHASE_BACKOFF);
     current_state = wait_to_send;
     leds_on(LEDS_GREEN);
     t0 = RTIMER_NOW();
     while (current_state == wait_to_send && RTIMER_CLOCK_LT (RTIMER_NOW(),t0 + BACKOFF_TIME)) {
 		if(FIFO_IS_1){
-		    t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + 3));
-		    FASTSPI_READ_FIFO_BYTE(strobe[PKT_LEN]);
-		    bytes_read = 1;
-	    //check if the packet size is right
-		    if (strobe[PKT_LEN]>=(STAFFETTA_PKT_LEN+3)) {
+		    if (!radio_read_frame(strobe)) {
 				radio_flush_rx();
 				goto_idle();
-		//printf("goto sleep after waiting for SELECT. Wrong packet length\n");
+		//printf("goto sleep after waiting for BEACON. Wrong packet length or timeout\n");
 				return RET_FAIL_RX_BUFF;
-	    	}
-	    
-			while (bytes_read < 10) {
-		//while (bytes_read < strobe[PKT_LEN]+1) {
-				t1 = RTIMER_NOW ();
-		// wait until the FIFO pin is 1 (until one more byte is received)
-				while (!FIFO_IS_1) {
-		    		if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t1 + RTIMER_ARCH_SECOND/200)) {
-						radio_flush_rx();
-						goto_idle();
-				//printf("goto sleep after waiting for BEACON's byte %u from radio\n",bytes_read);
-						return RET_FAIL_RX_BUFF;
-		    		}
-				};
-				FASTSPI_READ_FIFO_BYTE(strobe[bytes_read]); // read another byte from the RXFIFO
-				bytes_read++;
 	    	}
 	    //Check CRC
-	    	if (strobe[PKT_CRC] & FOOTER1_CRC_OK) {}
+	    	if (PKT_CRC_BYTE(strobe) & FOOTER1_CRC_OK) {}
 	    	else {
 #if WITH_CRC
 		// packet is corrupted. we send a beacon ack to a non-existing node as a NACK
-				strobe_ack[PKT_DST] = 255;
-				strobe_ack[PKT_DATA] = 0;
+				pkt_set_header(strobe_ack, TYPE_BEACON_ACK, node_id, STAFFETTA_ADDR_NONE, 0);
 				strobe_ack[PKT_SEQ] = 0;
 				strobe_ack[PKT_TTL] = 0;
-				FASTSPI_WRITE_FIFO(strobe_ack, STAFFETTA_PKT_LEN+1);
-				FASTSPI_STROBE(CC2420_STXON);
-				BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+				phase_enter(PHASE_ACK);
+				radio_write(strobe_ack);
+				radio_tx();
 		// and go to sleep
 				leds_off(LEDS_GREEN);
 				radio_flush_rx();
@@ -329,7 +630,7 @@ int staffetta_send_packet(void) {
 	    	count_hop_num();
 	    	if(strobe[PKT_GRADIENT] < hop_count){
 				printf("drop because %u is smaller then %u\n", strobe[PKT_GRADIENT], hop_count);
-				printf("packet from %u is dropped\n", strobe[PKT_SRC]);
+				printf("packet from %u is dropped\n", PKT_GET_SRC(strobe));
 #else
 			printf("nomal mode rx\n");
 		    if(strobe[PKT_GRADIENT] > num_wakeups){
@@ -341,7 +642,7 @@ int staffetta_send_packet(void) {
 				return RET_WRONG_GRADIENT;
 	    	}
 #endif
-	    	if (strobe[PKT_TYPE] == TYPE_BEACON){
+	    	if (PKT_GET_TYPE(strobe) == TYPE_BEACON){
 				current_state = sending_ack;
 	    	} else {
 				leds_off(LEDS_GREEN);
@@ -354,8 +655,8 @@ int staffetta_send_packet(void) {
 	}
     //send beacon ack and wait to be selected
     if(current_state==sending_ack){
-		strobe_ack[PKT_DST] = strobe[PKT_SRC];
-		strobe_ack[PKT_DATA] = strobe[PKT_DATA];
+		phase_enter(PHASE_ACK);
+		pkt_set_header(strobe_ack, TYPE_BEACON_ACK, node_id, PKT_GET_SRC(strobe), PKT_GET_DATA(strobe));
 		strobe_ack[PKT_SEQ] = strobe[PKT_SEQ];
 		strobe_ack[PKT_TTL] = strobe[PKT_TTL];
 #if ORW_GRADIENT
@@ -367,10 +668,8 @@ int staffetta_send_packet(void) {
 		strobe_ack[PKT_GRADIENT] = aggregateValue;
 #endif
 
-		FASTSPI_WRITE_FIFO(strobe_ack, STAFFETTA_PKT_LEN+1);
-		FASTSPI_STROBE(CC2420_STXON);
-		//We wait until transmission has ended
-		BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+		radio_write(strobe_ack);
+		radio_tx();
 
 		//wait for the select packet
 		current_state = wait_select;
@@ -378,35 +677,14 @@ int staffetta_send_packet(void) {
 		t1 = RTIMER_NOW ();
 		while (current_state == wait_select && RTIMER_CLOCK_LT (RTIMER_NOW(),t1 + STROBE_WAIT_TIME)) {
 	    	if(FIFO_IS_1){
-				t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + 3));
-				FASTSPI_READ_FIFO_BYTE(select[PKT_LEN]);
-				bytes_read = 1;
-				//check if the size is right
-				if (select[PKT_LEN]>=(STAFFETTA_PKT_LEN+3)) {
+				if (!radio_read_frame(select)) {
 			    	radio_flush_rx();
 			    	goto_idle();
-			    	//printf("goto sleep after waiting for SELECT. Wrong packet length\n");
+			    	//printf("goto sleep after waiting for SELECT. Wrong packet length or timeout\n");
 			    	return RET_FAIL_RX_BUFF;
 				}
-				//PRINTF("len %u\n",strobe[PKT_LEN]);
-				while (bytes_read < 10) {
-			    	//while (bytes_read < select[PKT_LEN]+1) {
-			    	t2 = RTIMER_NOW ();
-			    	// wait until the FIFO pin is 1 (until one more byte is received)
-			    	while (!FIFO_IS_1) {
-						if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t2 + RTIMER_ARCH_SECOND/200)) {
-					    	radio_flush_rx();
-					    	goto_idle();
-					    	//printf("goto sleep after waiting for SELECT's byte %u from radio\n",bytes_read);
-					    	return RET_FAIL_RX_BUFF;
-						}
-				    };
-				    // read another byte from the RXFIFO
-				    FASTSPI_READ_FIFO_BYTE(select[bytes_read]);
-				    bytes_read++;
-				}
 				//Check CRC
-				if (select[PKT_CRC] & FOOTER1_CRC_OK) {}
+				if (PKT_CRC_BYTE(select) & FOOTER1_CRC_OK) {}
 				else {
 #if WITH_CRC
 			    	leds_off(LEDS_GREEN);
@@ -421,12 +699,13 @@ int staffetta_send_packet(void) {
 	    	}
 		}
 		//Save received data
-		if((current_state==select_received)&&(select[PKT_DST]!=node_id)){
+		if((current_state==select_received)&&(PKT_GET_DST(select)!=node_id)){
 	    	//if we received a select and it is not for us, trash the packet.
 	    	//printf("select not for us\n");
 		} else {
-	    	//otherwise save the packet
-	    	add_data(strobe[PKT_DATA], strobe[PKT_TTL]+1, strobe[PKT_SEQ]);
+	    	//otherwise save the packet. If it went around, MAX_HOPS ends the loop
+	    	if (is_loop(PKT_GET_DATA(strobe), strobe[PKT_SEQ])) loops++;
+	    	add_data(PKT_GET_DATA(strobe), strobe[PKT_TTL]+1, strobe[PKT_SEQ]);
 		}
 		// Give time to the radio to finish sending the data
 		t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + RTIMER_ARCH_SECOND/1000));
@@ -439,20 +718,18 @@ int staffetta_send_packet(void) {
 	    	goto_idle();
 	    	return RET_WRONG_SELECT;
 		}
-#if !FAST_FORWARD
-		goto_idle();
-		return RET_NO_RX;
-#endif
+		fast_forward = should_fast_forward();
+		if(!fast_forward){
+			goto_idle();
+			return RET_NO_RX;
+		}
     }
     leds_off(LEDS_GREEN);
     leds_on(LEDS_RED);
     //No message from backoff or backoff with fast-forward. LET'S TRANSMIT!
+    queue_expire();
     //prepare strobe packet
-    strobe[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
-    strobe[PKT_SRC] = node_id;
-    strobe[PKT_DST] = 0;
-    strobe[PKT_TYPE] = TYPE_BEACON;
-    strobe[PKT_DATA] = read_data();
+    pkt_set_header(strobe, TYPE_BEACON, node_id, 0, read_data());
     strobe[PKT_TTL] = read_ttl();
     strobe[PKT_SEQ] = read_seq();
 #if BCP_GRADIENT
@@ -478,66 +755,40 @@ int staffetta_send_packet(void) {
 		goto_idle();
 		return RET_EMPTY_QUEUE;
     }
-	printf("Beacon send DATA: %u, TTL: %u, SEQ: %u\n", strobe[PKT_DATA], strobe[PKT_TTL], strobe[PKT_SEQ]);
+	printf("Beacon send DATA: %u, TTL: %u, SEQ: %u\n", PKT_GET_DATA(strobe), strobe[PKT_TTL], strobe[PKT_SEQ]);
     current_state = wait_beacon_ack;
     t0 = RTIMER_NOW();
     collisions = 0;
-    for (strobes = 0; current_state == wait_beacon_ack && collisions == 0 && RTIMER_CLOCK_LT (RTIMER_NOW (), t0 + STROBE_TIME); strobes++) {
+    for (strobes = 0; current_state == wait_beacon_ack && collisions == 0 && RTIMER_CLOCK_LT (RTIMER_NOW (), t0 + strobe_time); strobes++) {
+		phase_enter(fast_forward ? PHASE_FAST_FORWARD : PHASE_STROBE);
 		radio_flush_tx();
-		FASTSPI_WRITE_FIFO(strobe, STAFFETTA_PKT_LEN+1);
-		FASTSPI_STROBE(CC2420_STXON);
-		//We wait until transmission has ended
-		BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+		radio_write(strobe);
+		radio_tx();
+		phase_enter(fast_forward ? PHASE_FAST_FORWARD : PHASE_STROBE_WAIT);
 		t1 = RTIMER_NOW ();
 		while (current_state == wait_beacon_ack && RTIMER_CLOCK_LT (RTIMER_NOW(),t1 + STROBE_WAIT_TIME)) {
 		   	if(FIFO_IS_1){
-				//TODO check why we need this delay
-				t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + 3));
-				FASTSPI_READ_FIFO_BYTE(strobe_ack[PKT_LEN]);
-				bytes_read = 1;
-				//check if the size is right
-				if (strobe_ack[PKT_LEN]>=(STAFFETTA_PKT_LEN+3)) {
+				//TODO check why we need the delay in radio_read_frame
+				if (!radio_read_frame(strobe_ack)) {
 			   		radio_flush_rx();
 		    		goto_idle();
-			   		//printf("goto sleep after waiting for SELECT. Wrong packet length\n");
+			   		//printf("goto sleep after waiting for BEACON ACK. Wrong packet length or timeout\n");
 			   		return RET_FAIL_RX_BUFF;
 				}
-				//debug = strobe_ack[PKT_LEN];
-				while (bytes_read < 10) {
-			    	//while (bytes_read < strobe_ack[PKT_LEN]+1) {
-			    	t2 = RTIMER_NOW ();
-			    	// wait until the FIFO pin is 1 (until one more byte is received)
-			    	while (!FIFO_IS_1) {
-						if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t2 + RTIMER_ARCH_SECOND/200)) {
-				    		radio_flush_rx();
-				    		goto_idle();
-				    		//printf("goto sleep after waiting for BEACON's byte %u from radio\n",bytes_read);
-				    		return RET_FAIL_RX_BUFF;
-						}
-			    	};
-			    	// read another byte from the RXFIFO
-			    	FASTSPI_READ_FIFO_BYTE(strobe_ack[bytes_read]);
-			    	bytes_read++;
-				}
 				//Check CRC
-				if (strobe_ack[PKT_CRC] & FOOTER1_CRC_OK) {}
+				if (PKT_CRC_BYTE(strobe_ack) & FOOTER1_CRC_OK) {}
 				else {
 #if WITH_CRC
 			    	//CRC wrong, send a select to a non-existing node
 #if WITH_SELECT
-			    	select[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
-			    	select[PKT_SRC] = node_id;
-			    	select[PKT_TYPE] = TYPE_SELECT;
-			    	select[PKT_DATA] = 0;
+			    	pkt_set_header(select, TYPE_SELECT, node_id, STAFFETTA_ADDR_NONE, 0);
 			    	select[PKT_TTL] = 0;
 			    	select[PKT_SEQ] = 0;
 			    	select[PKT_GRADIENT] = 0;
-			    	select[PKT_DST] = 255;
+			    	phase_enter(PHASE_SELECT);
 			    	radio_flush_tx();
-			    	FASTSPI_WRITE_FIFO(select, STAFFETTA_PKT_LEN+1);
-			    	FASTSPI_STROBE(CC2420_STXON);
-			    	//We wait until transmission has ended
-			    	BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+			    	radio_write(select);
+			    	radio_tx();
 			    	//t2 = RTIMER_NOW ();while(RTIMER_CLOCK_LT(RTIMER_NOW(),t2+32)); //give time to the radio to send a message (1ms) TODO: add this time to .h file
 #endif
 			    	radio_flush_rx();
@@ -548,9 +799,12 @@ int staffetta_send_packet(void) {
 				}
 				//PRINTF("ack: %u %u %u %u %u %u %u %u\n",strobe_ack[0],strobe_ack[1],strobe_ack[2],strobe_ack[3],strobe_ack[4],strobe_ack[5],strobe_ack[6],strobe_ack[7]);
 				//packet received, process it
-				if (strobe_ack[PKT_TYPE] == TYPE_BEACON_ACK){
-			    	if ((strobe_ack[PKT_DST] == node_id)&&(strobe_ack[PKT_DATA] == strobe[PKT_DATA] )) {
+				if (PKT_GET_TYPE(strobe_ack) == TYPE_BEACON_ACK){
+			    	if ((PKT_GET_DST(strobe_ack) == node_id)&&(PKT_GET_DATA(strobe_ack) == PKT_GET_DATA(strobe))) {
 						current_state = beacon_sent;
+#if SINK_DUTY_CYCLE
+						if (strobe_ack[PKT_TYPE] & TYPE_FLAG_SINK) sink_in_range = 1;
+#endif
 						//radio_flush_tx();
 						//PRINTF("beacon ack for us from %d\n", strobe_ack[PKT_SRC]);
 			    	} else {
@@ -565,8 +819,24 @@ int staffetta_send_packet(void) {
 				}
 		    }
 		}
+#if SYNC_WAKEUP
+		// past the wake window of this slot: turn the radio off until our offset in the next one
+		if (current_state == wait_beacon_ack && sync_ok() && (timesynch_time() % SYNC_SLOT) >= SYNC_WINDOW) {
+		    phase_enter(PHASE_NONE);
+		    radio_off();
+		    t1 = RTIMER_NOW();
+		    sync_wait(sync_offset());
+		    sync_sleep += RTIMER_NOW() - t1;
+		    radio_on();
+		    radio_flush_rx();
+		}
+#endif
     }
     //Message sent. Send a select packet and go to sleep
+#if SINK_DUTY_CYCLE
+    //nobody answered: the sink may have moved away, strobe for the whole period next time
+    if (current_state == wait_beacon_ack && collisions == 0) sink_in_range = 0;
+#endif
 
 	if (node_id == SOURCE)
 	{
@@ -575,31 +845,26 @@ int staffetta_send_packet(void) {
 
     if(current_state == beacon_sent && collisions == 0){
 #if WITH_SELECT
-		select[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
-		select[PKT_SRC] = node_id;
-		select[PKT_TYPE] = TYPE_SELECT;
-		select[PKT_DATA] = 0;
+		pkt_set_header(select, TYPE_SELECT, node_id, PKT_GET_SRC(strobe_ack), 0);
 		select[PKT_TTL] = 0;
 		select[PKT_SEQ] = 0;
 		select[PKT_GRADIENT] = 0;
-		select[PKT_DST] = strobe_ack[PKT_SRC];
 
 #if WITH_HISTORY
 		printf("history[0]: %u, history[1]: %u, history[2]: %u\n", history[0], history[1], history[2]);
 
-		if (!check_history(select[PKT_DST]))
+		if (!check_history(PKT_GET_DST(select)))
 		{
 			printf("check success\n");
-			history[history_idx] = select[PKT_DST];
+			history[history_idx] = PKT_GET_DST(select);
 			history_idx = (history_idx + 1) % NUM_OF_HISTORY;
 #endif
+			phase_enter(PHASE_SELECT);
 			radio_flush_tx();
-			FASTSPI_WRITE_FIFO(select, STAFFETTA_PKT_LEN+1);
-			FASTSPI_STROBE(CC2420_STXON);
-		//We wait until transmission has ended
-			BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
+			radio_write(select);
+			radio_tx();
 		// 5 src dst: Send packet from 'src' to 'dst'
-			printf("5 %d %d\n", node_id, strobe_ack[PKT_SRC]);
+			printf("5 %u %u\n", node_id, PKT_GET_SRC(strobe_ack));
 #if WITH_HISTORY
 		} else {
 			printf("drop for load balancing\n");
@@ -615,6 +880,7 @@ int staffetta_send_packet(void) {
 		aggregateValue = MAX(aggregateValue,strobe_ack[PKT_GRADIENT]);
 #endif
 		//Message delivered. Remove from our queue
+		fwd_add(read_data(), read_seq());
 		pop_data();
 //		printf("pop_data: DATA: %u, SEQ: %u, TTL: %u\n", read_data(), read_seq(), read_ttl());
     }
@@ -624,11 +890,17 @@ int staffetta_send_packet(void) {
 	// add the rendezvous measure to our average window
 	if (collisions==0) {
 	//leds_off(LEDS_BLUE);
-		rendezvous_time = ((RTIMER_NOW() - rendezvous_starting_time) * 10000) / RTIMER_ARCH_SECOND ;
-		if(rendezvous_time<10000) {
-		   	rendezvous[rendezvous_idx] = rendezvous_time;
-		   	rendezvous_idx = (rendezvous_idx+1)%AVG_SIZE;
-		}
+		// rtimer_clock_t arithmetic: the 16-bit rtimer may wrap during the strobe train
+#if SYNC_WAKEUP
+		// only the time with the radio on counts
+		rendezvous_time = ((uint32_t)(rtimer_clock_t)(RTIMER_NOW() - rendezvous_starting_time - sync_sleep) * 10000) / RTIMER_ARCH_SECOND ;
+#else
+		rendezvous_time = ((uint32_t)(rtimer_clock_t)(RTIMER_NOW() - rendezvous_starting_time) * 10000) / RTIMER_ARCH_SECOND ;
+#endif
+		// a strobe train nobody answered counts as a full period, so that a node without
+		// forwarders wakes up less and stops advertising the gradient it started with
+	   	rendezvous[rendezvous_idx] = MIN(rendezvous_time, 10000);
+	   	rendezvous_idx = (rendezvous_idx+1)%AVG_SIZE;
 		// TODO make a running average
 		rendezvous_sum = 0;
 		for (i=0;i<AVG_SIZE;i++){
@@ -654,10 +926,10 @@ int staffetta_send_packet(void) {
 #endif
 		if (!IS_SINK) {
 		    	// 2 src frequency: When a beacon ack from 'src' is received, report my wakeup 'frequency'.
-		   	printf("2 %d %ld\n",strobe_ack[PKT_SRC],num_wakeups);
-			uint32_t power = (energest_type_time(ENERGEST_TYPE_LISTEN) + energest_type_time(ENERGEST_TYPE_TRANSMIT)) * 10000 / RTIMER_ARCH_SECOND * 20 * 3 / 10; // Need to divide by 1000 then in mW
+		   	printf("2 %u %ld\n",PKT_GET_SRC(strobe_ack),num_wakeups);
+			uint32_t power = radio_energy(energest_type_time_wide(ENERGEST_TYPE_LISTEN), energest_type_time_wide(ENERGEST_TYPE_TRANSMIT)); // Need to divide by 1000 then in mW
 			printf("power: %lu\n", power);
-			duty_cycle = (1000 * (energest_type_time(ENERGEST_TYPE_LISTEN) + energest_type_time(ENERGEST_TYPE_TRANSMIT))) / ((energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM)));
+			duty_cycle = radio_duty_cycle();
 //			uint32_t nominator = energest_type_time(ENERGEST_TYPE_LISTEN) + energest_type_time(ENERGEST_TYPE_TRANSMIT);
 //			uint32_t denominator = energest_type_time(ENERGEST_TYPE_CPU) + energest_type_time(ENERGEST_TYPE_LPM);
 //			printf("LISTEN: %lu, TRANSMIT: %lu, CPU: %lu, LPM: %lu\n", energest_type_time(ENERGEST_TYPE_LISTEN), energest_type_time(ENERGEST_TYPE_TRANSMIT), energest_type_time(ENERGEST_TYPE_CPU), energest_type_time(ENERGEST_TYPE_LPM));
@@ -680,225 +952,350 @@ int staffetta_send_packet(void) {
 	return RET_FAST_FORWARD;
 }
 
+/*--------------------------- SINK FUNCTIONS ------------------------------------------------*/
+
+#if WITH_SINK
+// Entry of 'origin' in the origin table, a new one if it is not there yet. NULL if the table is full.
+static struct sink_origin *sink_origin(uint16_t origin){
+    uint16_t i,n;
+    // node ids are mostly consecutive: the low bits spread them without collisions
+    i = origin & (SINK_MAX_ORIGINS-1);
+    for (n = 0; n < SINK_MAX_ORIGINS; n++) {
+		if (sink_origins[i].id == origin) return &sink_origins[i];
+		if (sink_origins[i].id == 0) {
+		    sink_origins[i].id = origin;
+		    return &sink_origins[i];
+		}
+		i = (i+1) & (SINK_MAX_ORIGINS-1);
+    }
+    return NULL;
+}
+
+// Account a delivery from 'origin'. Return its entry if it is new, NULL if it is a duplicate or cannot be accounted.
+static struct sink_origin *sink_account(uint16_t origin, uint8_t _seq){
+    struct sink_origin *o;
+    uint16_t i;
+    int8_t diff;
+    o = NULL;
+    if ((origin != 0) && (origin != STAFFETTA_ADDR_NONE)) o = sink_origin(origin);
+    if (o == NULL) {
+		sink_unknown++;
+		return NULL;
+    }
+    if (o->expected == 0) {
+		// first packet from this origin. Sequence numbers start at 0, so the ones before are gaps
+		o->window = 1;
+		o->last_seq = _seq;
+		o->expected = _seq+1;
+		sink_expected += _seq+1;
+		sink_num_origins++;
+    } else {
+		diff = (int8_t)(_seq - o->last_seq);
+		if (diff > 0) {
+		    o->window = (diff >= SINK_WINDOW) ? 1 : ((o->window << diff) | 1);
+		    o->last_seq = _seq;
+		    o->expected += diff;
+		    sink_expected += diff;
+		} else if (-diff >= SINK_WINDOW) {
+		    // older than our window, we cannot tell if it is a duplicate
+		    sink_late++;
+		    return NULL;
+		} else if (o->window & (1u << -diff)) {
+		    sink_dups++;
+		    return NULL;
+		} else {
+		    o->window |= 1u << -diff;
+		    if (o->reorder < 255) o->reorder++;
+		}
+    }
+    o->received++;
+    sink_received++;
+    i = o - sink_origins;
+    sink_dirty[i / 8] |= 1 << (i % 8);
+    return o;
+}
+
+static uint16_t pdr(uint32_t received, uint32_t expected){
+    if (expected == 0) return 0;
+    return (uint16_t)((received * 1000) / expected);
+}
+
+// Print the origins updated since their last report, at most SINK_REPORT_LINES at a time.
+static void sink_report(void){
+    struct sink_origin *o;
+    uint16_t i,lines;
+    for (lines = 0; lines < SINK_REPORT_LINES && sink_report_idx < SINK_MAX_ORIGINS; sink_report_idx++) {
+		i = sink_report_idx;
+		if (!(sink_dirty[i / 8] & (1 << (i % 8)))) continue;
+		sink_dirty[i / 8] &= ~(1 << (i % 8));
+		o = &sink_origins[i];
+		// 7 origin pdr received gaps reorder: Per-origin delivery, 'pdr' in per mill
+		printf("7 %u %u %u %u %u\n", o->id, pdr(o->received, o->expected), o->received, o->expected - o->received, o->reorder);
+		lines++;
+    }
+    if (sink_report_idx < SINK_MAX_ORIGINS) return; // continue in the next call
+    sink_report_idx = 0;
+    sink_last_report = clock_time();
+    // 8 origins pdr received gaps dups late unknown: Network-wide delivery seen by the sink
+    printf("8 %u %u %lu %lu %lu %lu %lu\n", sink_num_origins, pdr(sink_received, sink_expected), sink_received,
+		sink_expected - sink_received, sink_dups, sink_late, sink_unknown);
+}
+
 void sink_busy_wait(void) {
     printf("Sink busy loop\n");
     while (1);
     printf("Sink end busy loop\n");
 }
 
-void sink_listen(void) {
-    rtimer_clock_t t0,t1,t2;
-    uint8_t strobe[STAFFETTA_PKT_LEN+3];
-    uint8_t strobe_ack[STAFFETTA_PKT_LEN+3];
-    uint8_t select[STAFFETTA_PKT_LEN+3];
-    int i,collisions,strobes,bytes_read, num_of_recv = 0;
-	uint8_t recv_data[PAKETS_PER_NODE] = {0};
+static void sink_print_delivery(const struct sink_delivery *d){
+    printf("%u %u %u %lu\n", d->origin, d->seq, d->hops, d->received);
+    if (d->complete)
+		printf("complete! %u\n", d->origin);
+}
+
+// Queue a delivery, so that printing does not hold up the exchange
+static void sink_deliver(const struct sink_origin *o, uint8_t _seq, uint8_t hops){
+    struct sink_delivery d;
+    d.received = sink_received;
+    d.origin = o->id;
+    d.seq = _seq;
+    d.hops = hops;
+    d.complete = (o->received == PAKETS_PER_NODE);
+    if (!msgq_put(&sink_uplink, &d)) {
+		sink_print_delivery(&d);
+    }
+}
+
+// Serve one beacon from the RXFIFO, if any. Return 1 if a beacon was acknowledged.
+static int sink_poll(void) {
+    rtimer_clock_t t1,t2;
+    uint8_t strobe[STAFFETTA_MAX_PKT_LEN+3];
+    uint8_t strobe_ack[STAFFETTA_MAX_PKT_LEN+3];
+    uint8_t select[STAFFETTA_MAX_PKT_LEN+3];
+    struct sink_origin *o;
     //prepare strobe_ack packet
-    strobe_ack[PKT_LEN] = STAFFETTA_PKT_LEN+FOOTER_LEN;
-    strobe_ack[PKT_SRC] = node_id;
-    strobe_ack[PKT_TYPE] = TYPE_BEACON_ACK;
     strobe_ack[PKT_GRADIENT] = 0; // we limit the # of wakeups to 25
-    //turn radio on
-    radio_on();
-    radio_flush_rx();
-    radio_flush_tx();
-    watchdog_stop();
-    current_state = idle;
 
-    while (1) {
-		//there is a message in the buffer
-		if(FIFO_IS_1){
-		    leds_on(LEDS_GREEN);
-		    t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + 3));
-		    FASTSPI_READ_FIFO_BYTE(strobe[PKT_LEN]);
-		    bytes_read = 1;
-		    if (strobe[PKT_LEN]>=(STAFFETTA_PKT_LEN+3)) {
-				leds_off(LEDS_GREEN);
-				radio_flush_rx();
-				current_state=idle;
-				//printf("sink got a too long beacon\n");
-				continue;
-		    }
-		    debug = strobe[PKT_LEN];
-		    while (bytes_read < 10) {
-				//while (bytes_read < strobe[PKT_LEN]+1) {
-				t1 = RTIMER_NOW ();
-				// wait until the FIFO pin is 1 (until one more byte is received)
-				while (!FIFO_IS_1) {
-			    	if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t1 + RTIMER_ARCH_SECOND/200)) {
-					leds_off(LEDS_GREEN);
-					radio_flush_rx();
-					current_state=idle;
-					//printf("sink goto sleep after waiting for BEACON's byte %u from radio\n",bytes_read);
-					continue;
-			    	}
-				};
-				// read another byte from the RXFIFO
-				FASTSPI_READ_FIFO_BYTE(strobe[bytes_read]);
-				bytes_read++;
-		    }
+	//nothing in the buffer: no beacon to serve, whatever state an earlier poll left
+	if(!FIFO_IS_1){
+	    return 0;
+	}
+	leds_on(LEDS_GREEN);
+	if (!radio_read_frame(strobe)) {
+		leds_off(LEDS_GREEN);
+		radio_flush_rx();
+		current_state=idle;
+		//printf("sink got a wrong beacon length or timed out\n");
+		return 0;
+	}
+	debug = strobe[PKT_LEN];
 #if WITH_FLOCKLAB_SINK
-		    if((!(P2IN & BV(7)))){
-				//we are not selected as sink in flocklab
-				gpio_off(GPIO_GREEN);
-				gpio_on(GPIO_RED);
-				radio_flush_rx();
-				current_state=idle;
-				continue;
-		    } else {
-				gpio_on(GPIO_GREEN);
-				gpio_off(GPIO_RED);
-		    }
+	if((!(P2IN & BV(7)))){
+		//we are not selected as sink in flocklab
+		gpio_off(GPIO_GREEN);
+		gpio_on(GPIO_RED);
+		radio_flush_rx();
+		current_state=idle;
+		return 0;
+	} else {
+		gpio_on(GPIO_GREEN);
+		gpio_off(GPIO_RED);
+	}
 #endif
-	    	//Check CRC
-		    if (strobe[PKT_CRC] & FOOTER1_CRC_OK) {}
-		    else {
+	//Check CRC
+	if (PKT_CRC_BYTE(strobe) & FOOTER1_CRC_OK) {}
+	else {
 #if WITH_CRC
-				//CRC wrong, send an ack to a non-existing node (NACK)
-				strobe_ack[PKT_DST] = 255;
-				strobe_ack[PKT_DATA] = 0;
-				strobe_ack[PKT_SEQ] = 0;
-				strobe_ack[PKT_TTL] = 0;
-				FASTSPI_WRITE_FIFO(strobe_ack, STAFFETTA_PKT_LEN+1);
-				FASTSPI_STROBE(CC2420_STXON);
-				BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
-				leds_off(LEDS_GREEN);
-				radio_flush_rx();
-				current_state=idle;
-				PRINTF("Wrong CRC\n");
-				continue;
+		//CRC wrong, send an ack to a non-existing node (NACK)
+		pkt_set_header(strobe_ack, TYPE_BEACON_ACK, node_id, STAFFETTA_ADDR_NONE, 0);
+		strobe_ack[PKT_SEQ] = 0;
+		strobe_ack[PKT_TTL] = 0;
+		phase_enter(PHASE_ACK);
+		radio_write(strobe_ack);
+		radio_tx();
+		phase_enter(PHASE_NONE);
+		leds_off(LEDS_GREEN);
+		radio_flush_rx();
+		current_state=idle;
+		PRINTF("Wrong CRC\n");
+		return 0;
 #endif
-		    }
-		    //PRINTF("sink beacon: %u %u %u %u %u %u %u %u\n",strobe[0],strobe[1],strobe[2],strobe[3],strobe[4],strobe[5],strobe[6],strobe[7]);
-		    //strobe received, process it
-		    if (strobe[PKT_TYPE] == TYPE_BEACON){
-				current_state = sending_ack;
-		    }  else {
-				leds_off(LEDS_GREEN);
-				radio_flush_rx();
-				current_state=idle;
-				continue;
-		    }
-		}
-		// we received a beacon
-		if(current_state==sending_ack){
-		    leds_off(LEDS_GREEN);
-		    leds_on(LEDS_BLUE);
-		    strobe_ack[PKT_DST] = strobe[PKT_SRC];
-		    strobe_ack[PKT_DATA] = strobe[PKT_DATA];
-		    strobe_ack[PKT_SEQ] = strobe[PKT_SEQ];
-		    strobe_ack[PKT_TTL] = strobe[PKT_TTL];
+	}
+	//PRINTF("sink beacon: %u %u %u %u %u %u %u %u\n",strobe[0],strobe[1],strobe[2],strobe[3],strobe[4],strobe[5],strobe[6],strobe[7]);
+	//strobe received, process it
+	if (PKT_GET_TYPE(strobe) == TYPE_BEACON){
+		current_state = sending_ack;
+	}  else {
+		leds_off(LEDS_GREEN);
+		radio_flush_rx();
+		current_state=idle;
+		return 0;
+	}
+	// we received a beacon
+    PROFILE_BEGIN(STAFFETTA_SINK);
+    phase_enter(PHASE_ACK);
+    leds_off(LEDS_GREEN);
+    leds_on(LEDS_BLUE);
+    // a duty-cycled sink flags its acks, so that its neighbors shorten their strobes
+    pkt_set_header(strobe_ack, TYPE_BEACON_ACK | (SINK_DUTY_CYCLE ? TYPE_FLAG_SINK : 0), node_id, PKT_GET_SRC(strobe), PKT_GET_DATA(strobe));
+    strobe_ack[PKT_SEQ] = strobe[PKT_SEQ];
+    strobe_ack[PKT_TTL] = strobe[PKT_TTL];
 #if ORW_GRADIENT
-		    strobe_ack[PKT_GRADIENT] = 0;
+    strobe_ack[PKT_GRADIENT] = 0;
 #endif
 #if WITH_AGGREGATE
-		    aggregateValue = MAX(aggregateValue,strobe[PKT_GRADIENT]);
-		    strobe_ack[PKT_GRADIENT] = aggregateValue;
-#endif
-		    FASTSPI_WRITE_FIFO(strobe_ack, STAFFETTA_PKT_LEN+1);
-		    FASTSPI_STROBE(CC2420_STXON);
-		    //We wait until transmission has ended
-		    BUSYWAIT_UNTIL(!(radio_status() & BV(CC2420_TX_ACTIVE)), RTIMER_SECOND / 10);
-		    //t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + RTIMER_ARCH_SECOND/500)); //give time to the radio to send a message (1ms) TODO: add this time to .h file
-		    //SINK output
-		//wait for the select packet
-			current_state = wait_select;
-			radio_flush_rx();
-			t1 = RTIMER_NOW ();
-			while (current_state == wait_select) {
-	    		if(FIFO_IS_1){
-					t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + 3));
-					FASTSPI_READ_FIFO_BYTE(select[PKT_LEN]);
-					bytes_read = 1;
-					//check if the size is right
-					if (select[PKT_LEN]>=(STAFFETTA_PKT_LEN+3)) {
-				    	radio_flush_rx();
-				    	goto_idle();
-			    	//printf("goto sleep after waiting for SELECT. Wrong packet length\n");
-						current_state = idle;
-					}
-					//PRINTF("len %u\n",strobe[PKT_LEN]);
-					while (bytes_read < 10) {
-				    	//while (bytes_read < select[PKT_LEN]+1) {
-				    	t2 = RTIMER_NOW ();
-				    	// wait until the FIFO pin is 1 (until one more byte is received)
-				    	while (!FIFO_IS_1) {
-							if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t2 + RTIMER_ARCH_SECOND/200)) {
-						    	radio_flush_rx();
-						    	goto_idle();
-						    	//printf("goto sleep after waiting for SELECT's byte %u from radio\n",bytes_read);
-								current_state = idle;
-							}
-					    };
-				    // read another byte from the RXFIFO
-				    	FASTSPI_READ_FIFO_BYTE(select[bytes_read]);
-				    	bytes_read++;
-					}
-				//Check CRC
-					if (select[PKT_CRC] & FOOTER1_CRC_OK) {}
-					else {
-#if WITH_CRC
-			    		leds_off(LEDS_GREEN);
-			    		radio_flush_rx();
-			    		goto_idle();
-			    		PRINTF("Wrong CRC\n");
-						current_state = idle;
-#endif
-					}
-					//change state to idle to signal that a message was received
-					current_state = select_received;
-	    		}
+    aggregateValue = MAX(aggregateValue,strobe[PKT_GRADIENT]);
+    strobe_ack[PKT_GRADIENT] = aggregateValue;
+#endif
+    radio_write(strobe_ack);
+    radio_tx();
+    //t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + RTIMER_ARCH_SECOND/500)); //give time to the radio to send a message (1ms) TODO: add this time to .h file
+    //SINK output
+	//wait for the select packet
+	current_state = wait_select;
+	radio_flush_rx();
+	t1 = RTIMER_NOW ();
+	while (current_state == wait_select && RTIMER_CLOCK_LT (RTIMER_NOW(),t1 + STROBE_WAIT_TIME)) {
+		if(FIFO_IS_1){
+			if (!radio_read_frame(select)) {
+		    	radio_flush_rx();
+		    	goto_idle();
+	    	//printf("goto sleep after waiting for SELECT. Wrong packet length or timeout\n");
+				current_state = idle;
+				break;
 			}
-		//Save received data
-			if((current_state==select_received)&&(select[PKT_DST]!=node_id)){
-	    	//if we received a select and it is not for us, trash the packet.
-	    	//printf("select not for us\n");
-			} else {
-	    	//otherwise save the packet
-				if ((current_state == select_received) && (select[PKT_DST] == node_id))
-				{
-					if (recv_data[strobe[PKT_SEQ]] == 0)
-					{
-						num_of_recv++;
-		    			printf("%u %u %u %u\n", strobe[PKT_DATA],strobe[PKT_SEQ],strobe[PKT_TTL]+1, num_of_recv);
-						recv_data[strobe[PKT_SEQ]] = 1;
-					}
-
-					if (num_of_recv == PAKETS_PER_NODE)
-						printf("complete!\n");
-				}
+		//Check CRC
+			if (PKT_CRC_BYTE(select) & FOOTER1_CRC_OK) {}
+			else {
+#if WITH_CRC
+	    		leds_off(LEDS_GREEN);
+	    		radio_flush_rx();
+	    		goto_idle();
+	    		PRINTF("Wrong CRC\n");
+				current_state = idle;
+				break;
+#endif
 			}
-		// Give time to the radio to finish sending the data
-			t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + RTIMER_ARCH_SECOND/1000));
-			leds_off(LEDS_GREEN);
-		
-			current_state = idle;
+			//change state to idle to signal that a message was received
+			current_state = select_received;
+		}
+	}
+	//Save received data
+	if ((current_state == select_received) && (PKT_GET_DST(select) == node_id)) {
+		o = sink_account(PKT_GET_DATA(strobe), strobe[PKT_SEQ]);
+		if (o != NULL)
+		{
+			sink_deliver(o, strobe[PKT_SEQ], strobe[PKT_TTL]+1);
+		}
+	} else {
+    	//if we did not receive a select, or it is not for us, trash the packet.
+    	//printf("select not for us\n");
+	}
+	// Give time to the radio to finish sending the data
+	t2 = RTIMER_NOW (); while(RTIMER_CLOCK_LT (RTIMER_NOW (), t2 + RTIMER_ARCH_SECOND/1000));
+	leds_off(LEDS_GREEN);
+	phase_enter(PHASE_NONE);
+
+	current_state = idle;
+    PROFILE_END(STAFFETTA_SINK);
 #if WITH_AGGREGATE
-		    printf("A %u\n",aggregateValue);
+    printf("A %u\n",aggregateValue);
 #endif
+	return 1;
+}
+
+// Print the queued deliveries between exchanges. It stops when a frame arrives, and goes on once the sink served it
+PROCESS_THREAD(sink_uplink_process, ev, data) {
+    static struct sink_delivery d;
+    PROCESS_BEGIN();
+    while (1) {
+		PROCESS_MSGQ_WAIT(&sink_uplink);
+		while (!FIFO_IS_1 && msgq_get(&sink_uplink, &d)) {
+		    sink_print_delivery(&d);
+		}
+		if (!msgq_empty(&sink_uplink)) {
+		    process_poll(PROCESS_CURRENT());
+		    PROCESS_YIELD();
 		}
+    }
+    PROCESS_END();
+}
+
+// Report while nothing is being received. A report round resumes until all origins are printed
+static void sink_report_if_due(void) {
+    if(!FIFO_IS_1 && ((sink_report_idx != 0) || (clock_time() - sink_last_report >= SINK_REPORT_PERIOD))){
+		sink_report();
+    }
+}
+
+void sink_listen(void) {
+    //turn radio on
+    radio_on();
+    radio_flush_rx();
+    radio_flush_tx();
+    watchdog_stop();
+    current_state = idle;
+    sink_last_report = clock_time();
+
+    while (1) {
+		// this loop never returns to the main loop, so it runs the scheduler itself while
+		// no frame is pending: the uplink process that msgq_put() polls prints from here,
+		// and so do the timers of the other processes (e.g. profile_process)
+		if (!FIFO_IS_1) {
+		    process_run();
+		}
+		sink_report_if_due();
+		sink_poll();
 	}
 }
 
+#if SINK_DUTY_CYCLE
+// One wakeup of a duty-cycled sink: listen for SINK_LISTEN_TIME, longer if beacons keep coming, then sleep.
+static int sink_listen_window(void) {
+    rtimer_clock_t t0;
+    int ret = RET_EMPTY_QUEUE;
+    radio_on();
+    radio_flush_rx();
+    radio_flush_tx();
+    current_state = idle;
+    t0 = RTIMER_NOW();
+    while (RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + SINK_LISTEN_TIME)) {
+		if (sink_poll()) {
+		    ret = RET_NO_RX;
+		    t0 = RTIMER_NOW();
+		}
+    }
+    goto_idle();
+    sink_report_if_due();
+    return ret;
+}
+#endif
+#endif /* WITH_SINK */
+
 void staffetta_print_stats(void){
-    uint32_t on_time,elapsed_time;
-    on_time = ((energest_type_time(ENERGEST_TYPE_TRANSMIT)+energest_type_time(ENERGEST_TYPE_LISTEN)) * 1000) / RTIMER_ARCH_SECOND;
-    elapsed_time = clock_time() * 1000 / CLOCK_SECOND;
+    energest_time_t on_time;
+    uint32_t elapsed_time;
+    on_time = ((energest_type_time_wide(ENERGEST_TYPE_TRANSMIT)+energest_type_time_wide(ENERGEST_TYPE_LISTEN)) * 1000) / RTIMER_ARCH_SECOND;
+    elapsed_time = (uint32_t)clock_time() * 1000 / CLOCK_SECOND;
     if (!(IS_SINK)){
 #if ORW_GRADIENT
 		// 3 duty-cycle avg_edc
-		printf("3 %ld %ld\n",(on_time*1000)/elapsed_time,avg_edc);
+		printf("3 %lu %ld\n",(unsigned long)((on_time*1000)/elapsed_time),avg_edc);
 #else
 		// 3 duty-cycle q_size
-		printf("3 %ld %d\n",(on_time*1000)/elapsed_time,q_size);
+		printf("3 %lu %d\n",(unsigned long)((on_time*1000)/elapsed_time),q_size);
 #endif
+		// 10 loops dropped_hops dropped_expired
+		printf("10 %u %u %u\n",loops,dropped_hops,dropped_expired);
 	}
+	phase_report();
+	stack_check_print();
 	//printf("id: %d\n",node_id);
 }
 
 void staffetta_add_data(uint8_t _seq){
     // 4 node_id seq: Add data with 'seq' number to node 'node_id'.
-    printf("4 %d %d\n",node_id,_seq);
+    printf("4 %u %d\n",node_id,_seq);
     add_data(node_id,0,_seq);
 }
 
@@ -924,7 +1321,18 @@ void staffetta_init(void) {
 		data[i]=0;
 		seq[i]=0;
 		ttl[i]=0;
+		qtime[i]=0;
+		dup_next[i]=DEDUP_NONE;
 	}
+    for (i=0;i<DEDUP_BUCKETS;i++) dup_bucket[i]=DEDUP_NONE;
+    for (i=0;i<LOOP_HISTORY;i++) {
+		fwd_data[i]=0;
+		fwd_seq[i]=0;
+	}
+    fwd_idx = 0;
+    loops = 0;
+    dropped_hops = 0;
+    dropped_expired = 0;
 
 	read_idx = 0;
 	write_idx = 0;
@@ -940,11 +1348,26 @@ void staffetta_init(void) {
 	aggregateValue = node_id;
 #endif
     PRINTF("SS: INIT\n");
+#if SYNC_WAKEUP
+    // the sink is the time reference, the others synchronize to the frames of nodes closer to it
+    timesynch_set_authority_level(IS_SINK ? 0 : SYNC_LEVEL_NONE);
+#endif
+#if WITH_SINK
     //If the node is a sink, start listening indefinetly
     if (IS_SINK){
+		//drain the uplink queue ahead of bulk work, so the MAC does not find it full
+		process_set_priority(&sink_uplink_process, PROCESS_PRIORITY_HIGH);
+		process_start(&sink_uplink_process, NULL);
+#if SINK_DUTY_CYCLE
+		//a duty-cycled sink listens at every wakeup instead (see staffetta_send_packet)
+		printf("Sink active (duty cycled)\n");
+		sink_last_report = clock_time();
+#else
 		printf("Sink active\n");
 		sink_listen();
 		PRINTF("Sink done\n");
+#endif
 	}
+#endif
 }
 
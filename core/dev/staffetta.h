@@ -21,31 +21,68 @@
 
 /*------------------------- OPTIONS --------------------------------------------------*/
 
+// Options guarded by STAFFETTA_CONF_* can be overridden at build time, e.g.
+// make TARGET=sky DEFINES=STAFFETTA_CONF_BUDGET=500,STAFFETTA_CONF_HC_GRADIENT=1
+
 // OUR OPTIONS
 #define PAKETS_PER_NODE 	    50                 // Initial queue size
 #define NUM_OF_NODES			SOURCE
 #define SOURCE					9
 #define IS_SOURCE				(node_id == SOURCE)		// Check whether the node is the source.
 #define NUM_OF_HISTORY			3
+#ifdef STAFFETTA_CONF_HC_GRADIENT
+#define HC_GRADIENT STAFFETTA_CONF_HC_GRADIENT
+#else
 #define HC_GRADIENT				0					// use hop count as gradient
+#endif
 #define WITH_HISTORY			0
 /////////////
 
 
 #define WITH_CRC 		          1                 // Check packet CRC
-#define IS_SINK 		          (node_id == 1)    // Define condition to be a sink node
+#ifdef STAFFETTA_CONF_WITH_SINK
+#define WITH_SINK STAFFETTA_CONF_WITH_SINK
+#else
+#define WITH_SINK		          1                 // build the sink role and its accounting tables (0 for forwarder-only images)
+#endif
+#define IS_SINK 		          (WITH_SINK && node_id == 1) // Define condition to be a sink node
+#define SINK_ALWAYS_ON		    (IS_SINK && !SINK_DUTY_CYCLE)  // the sink radio is never turned off
 //#define IS_SINK 		        (node_id < 4)     // Mobile sink on flocklab
 #define WITH_SELECT 		      1                 // enable 3-way handshake (in case of multiple forwarders, initiator can choose)
 
+#ifdef STAFFETTA_CONF_WITH_GRADIENT
+#define WITH_GRADIENT STAFFETTA_CONF_WITH_GRADIENT
+#else
 #define WITH_GRADIENT 		    1                 // ensure that messages follows a gradient to the sink (number of wakeups)
+#endif
+#ifdef STAFFETTA_CONF_BCP_GRADIENT
+#define BCP_GRADIENT STAFFETTA_CONF_BCP_GRADIENT
+#else
 #define BCP_GRADIENT		      0                 // use the queue size as gradient (BCP)
+#endif
+#ifdef STAFFETTA_CONF_ORW_GRADIENT
+#define ORW_GRADIENT STAFFETTA_CONF_ORW_GRADIENT
+#else
 #define ORW_GRADIENT		      0                 // use the expected duty cycle as gradient (ORW)
+#endif
 #define DYN_DC 			          1                 // Enable staffetta adaptative wakeups. If disabled, the wakeup of nodes will be fixed
 
 #define FAST_FORWARD 		      0                 // forward as soon as you can (not dummy messages)
+#define ADAPTIVE_FF		        1                 // if FAST_FORWARD is off, decide at every exchange whether to forward right away
+#define FF_QUEUE_THRESHOLD	  5                 // adaptive fast-forward when at least this many packets are queued...
+#define FF_AGE_THRESHOLD	    30                // ...or when the oldest queued packet waited this many seconds...
+#define FF_DUTY_LIMIT		      (BUDGET/10)       // ...unless our duty cycle (per mill) already reached the budget
 #define BUDGET_PRECISION 	    1                 //use fixed point precision to compute the number of wakeups
+#ifdef STAFFETTA_CONF_BUDGET
+#define BUDGET STAFFETTA_CONF_BUDGET
+#else
 #define BUDGET 			          750               // how ho long the radio should stay ON every second (in ms / 10)
+#endif
+#ifdef STAFFETTA_CONF_AVG_SIZE
+#define AVG_SIZE STAFFETTA_CONF_AVG_SIZE
+#else
 #define AVG_SIZE 		          5                 // windows size for averaging the rendezvous time
+#endif
 #define AVG_EDC_SIZE		      20                // averaging size for orw's metric EDC
 #define WITH_RETX 		        0                 // retransmit a beacon ack if we receive another beacon
 #define USE_BACKOFF 		      1                 // Before sending listen to the channel for a certain period
@@ -53,9 +90,58 @@
 #define RSSI_FILTER 		      0                 // Filter beacons with RSSI lower that a threshold
 #define RSSI_THRESHOLD 		    -90               // Minimum RSSI value for accepting a beacon
 #define WITH_SINK_DELAY 	    1                 // Add a delay to the beacon ack of nodes that are not a sink (sink is always the first to answer to beacons)
-#define DATA_SIZE 		        500               // Size of the packet queue
+#ifdef STAFFETTA_CONF_DATA_SIZE
+#define DATA_SIZE STAFFETTA_CONF_DATA_SIZE
+#else
+#define DATA_SIZE 		        160               // Size of the packet queue: 8 bytes of RAM per packet plus DEDUP_BUCKETS*2, 1.4 KB (the 3-byte entries of the 8-bit queue took 1.5 KB at 500)
+#endif
+#define DEDUP_BUCKETS		      64                // hash buckets used to find duplicates in the packet queue
+#define DEDUP_NONE		        0xffff            // end of a dedup bucket chain
+#ifdef STAFFETTA_CONF_MAX_HOPS
+#define MAX_HOPS STAFFETTA_CONF_MAX_HOPS
+#else
+#define MAX_HOPS		          32                // drop packets that made this many hops without reaching the sink (routing loops)
+#endif
+#ifdef STAFFETTA_CONF_MAX_QUEUE_AGE
+#define MAX_QUEUE_AGE STAFFETTA_CONF_MAX_QUEUE_AGE
+#else
+#define MAX_QUEUE_AGE		      0                 // drop packets that waited this many seconds in the queue (0: never)
+#endif
+#define LOOP_HISTORY		      16                // recently forwarded packets, to count the ones that come back
 #define WITH_AGGREGATE		    0                 // todo?
 
+#ifdef STAFFETTA_CONF_SINK_MAX_ORIGINS
+#define SINK_MAX_ORIGINS STAFFETTA_CONF_SINK_MAX_ORIGINS
+#else
+#define SINK_MAX_ORIGINS	    128               // origins tracked by the sink, any 16-bit id, 10 bytes each (power of two)
+#endif
+#define SINK_WINDOW		        16                // per-origin reception window, in sequence numbers
+#define SINK_REPORT_PERIOD	  (CLOCK_SECOND*30) // how often the sink reports its per-origin statistics
+#define SINK_REPORT_LINES	    8                 // max origins printed per report round (printing blocks the radio)
+#define SINK_UPLINK_QUEUE	    8                 // deliveries printed after their exchange, when no frame is pending (power of two)
+#ifdef STAFFETTA_CONF_SINK_DUTY_CYCLE
+#define SINK_DUTY_CYCLE STAFFETTA_CONF_SINK_DUTY_CYCLE
+#else
+#define SINK_DUTY_CYCLE		    0                 // the sink duty-cycles its radio (battery-powered gateways) instead of listening forever
+#endif
+#define SINK_WAKEUPS		      80                // wakeups of a duty-cycled sink every 10 seconds (same unit as num_wakeups)
+#ifdef STAFFETTA_CONF_SYNC_WAKEUP
+#define SYNC_WAKEUP STAFFETTA_CONF_SYNC_WAKEUP
+#else
+#define SYNC_WAKEUP		        0                 // align wakeups to slots of a network-wide time (rime timesynch, needs TIMESYNCH_CONF_ENABLED)
+#endif
+
+#if SINK_MAX_ORIGINS & (SINK_MAX_ORIGINS-1)
+#error "SINK_MAX_ORIGINS must be a power of two"
+#endif
+
+#if SYNC_WAKEUP
+#if !TIMESYNCH_CONF_ENABLED
+#error "SYNC_WAKEUP needs TIMESYNCH_CONF_ENABLED"
+#endif
+#include "net/rime/timesynch.h"
+#endif
+
 /*-------------------------- MACROS -------------------------------------------------*/
 
 #define MIN(a, b) ((a) < (b)? (a) : (b))
@@ -91,8 +177,8 @@ select_received = 7
 
 struct staffetta_hdr {
   uint8_t type;
-  uint8_t dst;
-  uint8_t data;
+  uint16_t dst;
+  uint16_t data;
   uint8_t hop;
   uint8_t seq;
   uint8_t gradient;
@@ -113,8 +199,15 @@ struct staffetta_hdr {
 #define TYPE_BEACON       	   1
 #define TYPE_BEACON_ACK   	   2
 #define TYPE_SELECT       	   3
+#define TYPE_MASK		         0x0f
+#define TYPE_FLAG_EXT_ADDR	   0x80             // frame carries the high bytes of SRC, DST and DATA
+#define TYPE_FLAG_SINK		     0x40             // beacon ack sent by a duty-cycled sink
+#define TYPE_FLAG_SYNC		     0x20             // frame carries the synchronized time of its sender
 
 #define STAFFETTA_PKT_LEN 	   7
+#define STAFFETTA_EXT_LEN	     3                // extra bytes of a frame with 16-bit addresses
+#define STAFFETTA_SYNC_LEN	     (SYNC_WAKEUP ? 3 : 0) // extra bytes of a TYPE_FLAG_SYNC frame
+#define STAFFETTA_MAX_PKT_LEN  (STAFFETTA_PKT_LEN+STAFFETTA_EXT_LEN+STAFFETTA_SYNC_LEN)
 #define FOOTER_LEN		         2
 
 #define PKT_LEN			           0
@@ -125,8 +218,31 @@ struct staffetta_hdr {
 #define PKT_TTL			           5
 #define PKT_DATA		           6
 #define PKT_GRADIENT		       7
-#define PKT_RSSI		           8
-#define PKT_CRC			           9 //last field + 2
+#define PKT_SRC_HI		         8 // only in TYPE_FLAG_EXT_ADDR frames
+#define PKT_DST_HI		         9 // only in TYPE_FLAG_EXT_ADDR frames
+#define PKT_DATA_HI		         10 // only in TYPE_FLAG_EXT_ADDR frames
+#define PKT_SYNC_LEVEL		       0  // TYPE_FLAG_SYNC frames, after the addresses: use PKT_SYNC()
+#define PKT_SYNC_TIME		       1  // and PKT_SYNC_TIME+1
+#define PKT_RSSI		           8 // short frames only, use PKT_RSSI_BYTE()
+#define PKT_CRC			           9 // short frames only, use PKT_CRC_BYTE()
+
+#define PKT_GET_TYPE(p)        ((p)[PKT_TYPE] & TYPE_MASK)
+#define PKT_IS_EXT(p)          ((p)[PKT_TYPE] & TYPE_FLAG_EXT_ADDR)
+#define PKT_TX_LEN(p)          ((p)[PKT_LEN] - FOOTER_LEN + 1) // bytes to write in the TXFIFO
+#define PKT_RSSI_BYTE(p)       ((p)[(p)[PKT_LEN] - 1])
+#define PKT_CRC_BYTE(p)        ((p)[(p)[PKT_LEN]])
+#define PKT_SYNC(p)            ((p) + (PKT_IS_EXT(p) ? PKT_DATA_HI+1 : PKT_GRADIENT+1))
+
+/*
+ * Addresses (node ids and the origin of the data) are 16 bits wide.
+ * A frame only carries the high bytes when one of its addresses does
+ * not fit in a byte, so networks with less than 255 nodes keep the
+ * original 10-byte frames. STAFFETTA_ADDR_NONE is the NACK destination
+ * and is sent as 0xff in short frames.
+ */
+#define STAFFETTA_ADDR_NONE    0xffff
+#define STAFFETTA_SHORT_NONE   0xff
+#define STAFFETTA_ADDR_IS_SHORT(a) ((a) < STAFFETTA_SHORT_NONE || (a) == STAFFETTA_ADDR_NONE)
 
 #define FOOTER1_CRC_OK         0x80
 #define FOOTER1_CORRELATION    0x7f
@@ -138,6 +254,28 @@ struct staffetta_hdr {
 #define STAFFETTA_RSSI_FIELD             packet[packet_len_tmp - 1]
 #define STAFFETTA_CRC_FIELD              packet[packet_len_tmp]
 
+/*------------------------- SINK --------------------------------------------------*/
+
+/*
+ * Per-origin reception state kept by the sink, in a hash table of
+ * SINK_MAX_ORIGINS entries indexed by the origin id. Origins do not
+ * need to be numbered 1..N, but a sink only tracks SINK_MAX_ORIGINS of
+ * them: the deliveries of the others are counted as unknown. 128
+ * origins take 1.3 KB on a Sky, a sink of a larger network needs more
+ * RAM (e.g. a gateway build with STAFFETTA_CONF_SINK_MAX_ORIGINS=1024).
+ * Bit i of window is set if sequence number last_seq-i was received.
+ * expected grows with last_seq (wraps included), so expected-received
+ * is the number of gaps and received*1000/expected the PDR in per mill.
+ */
+struct sink_origin {
+  uint16_t id;                    // 0: free entry
+  uint16_t window;
+  uint16_t received;
+  uint16_t expected;
+  uint8_t last_seq;
+  uint8_t reorder;
+};
+
 /*------------------------- TIME --------------------------------------------------*/
 
 #define PERIOD 			          RTIMER_ARCH_SECOND 		     // 1s
@@ -146,6 +284,68 @@ struct staffetta_hdr {
 #define ON_TIME 		          (RTIMER_ARCH_SECOND/300) 	 // 3ms
 #define OFF_TIME 		          (PERIOD-ON_TIME)		       // 995ms
 #define BACKOFF_TIME 		      (ON_TIME)			             // 5ms
+#define SINK_LISTEN_TIME	    (ON_TIME)			             // 3ms, listen window of a duty-cycled sink
+// Longest sleep of a duty-cycled sink (wakeups are randomized up to +25%) plus one listen window
+#define SINK_STROBE_TIME	    ((rtimer_clock_t)((10ul*RTIMER_ARCH_SECOND*5)/(SINK_WAKEUPS*4) + SINK_LISTEN_TIME))
+
+/*------------------------- ENERGY --------------------------------------------------*/
+
+// Current draw of the radio states (uA) and supply voltage (mV) used to turn
+// radio time into energy. Defaults are the CC2420 datasheet values at 0 dBm
+// on a Tmote Sky powered at 3 V.
+#ifdef STAFFETTA_CONF_CURRENT_RX
+#define CURRENT_RX STAFFETTA_CONF_CURRENT_RX
+#else
+#define CURRENT_RX		        18800             // receive / listen
+#endif
+#ifdef STAFFETTA_CONF_CURRENT_TX
+#define CURRENT_TX STAFFETTA_CONF_CURRENT_TX
+#else
+#define CURRENT_TX		        17400             // transmit at 0 dBm
+#endif
+#ifdef STAFFETTA_CONF_SUPPLY_VOLTAGE
+#define SUPPLY_VOLTAGE STAFFETTA_CONF_SUPPLY_VOLTAGE
+#else
+#define SUPPLY_VOLTAGE		    3000
+#endif
+
+// Protocol phases of the radio time, see phase_enter() in staffetta.c
+#define PHASE_BACKOFF		      0
+#define PHASE_STROBE		      1
+#define PHASE_STROBE_WAIT	    2
+#define PHASE_ACK		          3
+#define PHASE_SELECT		      4
+#define PHASE_FAST_FORWARD	  5
+#define NUM_PHASES		        6
+#define PHASE_NONE		        NUM_PHASES
+
+/*
+ * Synchronized wakeups (SYNC_WAKEUP). Time is cut in slots of SYNC_SLOT
+ * and nodes only wake up at the start of a slot, after an offset that
+ * grows with their gradient (nodes closer to the sink wake up later),
+ * plus a random jitter. A child is then already strobing when its
+ * parents wake up and listen. Beacons are only sent until SYNC_WINDOW
+ * in each slot, the radio is off for the rest of the slot.
+ */
+#define SYNC_SLOT		          (RTIMER_ARCH_SECOND/8)    // 125ms, must divide the 16-bit rtimer range
+#define SYNC_STEP		          (RTIMER_ARCH_SECOND/2000) // 0.5ms of offset per gradient unit
+#define SYNC_MAX_GRADIENT	    25
+#define SYNC_JITTER		        (RTIMER_ARCH_SECOND/1000) // 1ms
+#define SYNC_WINDOW		        (SYNC_MAX_GRADIENT*SYNC_STEP + SYNC_JITTER + BACKOFF_TIME + STROBE_WAIT_TIME)
+#define SYNC_TX_DELAY		      13                        // ticks from the timestamp write to its reception (SPI, turnaround, preamble)
+#define SYNC_LEVEL_NONE		    255                       // authority level of a node that is not synchronized
+#define SYNC_MIN_SLEEP		      (RTIMER_ARCH_SECOND/1000) // shorter waits for the slot busy-wait instead of sleeping
+
+// Sleep in LPM3 while 'cond' holds; checked with interrupts off, so a wakeup is never missed
+#ifdef STAFFETTA_CONF_SLEEP_WHILE
+#define STAFFETTA_SLEEP_WHILE(cond) STAFFETTA_CONF_SLEEP_WHILE(cond)
+#else
+#define STAFFETTA_SLEEP_WHILE(cond) do { \
+    dint(); \
+    if (!(cond)) { eint(); break; } \
+    _BIS_SR(GIE | SCG0 | SCG1 | CPUOFF); \
+  } while(1)
+#endif
 
 struct staffettamac_config {
   rtimer_clock_t on_time;
@@ -158,6 +358,7 @@ struct staffettamac_config {
 
 int staffetta_send_packet(void);
 uint32_t getWakeups(void);
+clock_time_t staffetta_wakeup_delay(clock_time_t delay);
 
 // OUR FUNCTIONS
 uint32_t get_duty_cycle(void);
@@ -0,0 +1,139 @@
+/**
+ * \addtogroup msgq
+ * @{
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Message queue library implementation
+ */
+
+#include <string.h>
+
+#include "lib/msgq.h"
+
+/* Keep the compiler from moving the copy of a message across the
+   counter update that passes it to the other side */
+#ifdef __GNUC__
+#define BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define BARRIER()
+#endif
+
+#define SLOT(q, ptr) (&(q)->data[(uint16_t)((ptr) & (q)->mask) * (q)->size])
+/*---------------------------------------------------------------------------*/
+void
+msgq_init(struct msgq *q, struct process *consumer)
+{
+  q->get_ptr = q->put_ptr;
+  q->consumer = consumer;
+  q->dropped = 0;
+}
+/*---------------------------------------------------------------------------*/
+void *
+msgq_reserve(struct msgq *q)
+{
+  if(msgq_len(q) > q->mask) {
+    q->dropped++;
+    return NULL;
+  }
+  return SLOT(q, q->put_ptr);
+}
+/*---------------------------------------------------------------------------*/
+void
+msgq_commit(struct msgq *q)
+{
+  int was_empty;
+
+  /* The consumer is polled when the queue was empty. Otherwise it
+     has not taken all the messages yet, and will see this one. */
+  was_empty = msgq_empty(q);
+  BARRIER();
+  q->put_ptr++;
+  if(was_empty && q->consumer != NULL) {
+    process_poll(q->consumer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+msgq_put(struct msgq *q, const void *msg)
+{
+  void *slot;
+
+  slot = msgq_reserve(q);
+  if(slot == NULL) {
+    return 0;
+  }
+  memcpy(slot, msg, q->size);
+  msgq_commit(q);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void *
+msgq_peek(struct msgq *q)
+{
+  if(msgq_empty(q)) {
+    return NULL;
+  }
+  BARRIER();
+  return SLOT(q, q->get_ptr);
+}
+/*---------------------------------------------------------------------------*/
+void
+msgq_remove(struct msgq *q)
+{
+  if(!msgq_empty(q)) {
+    BARRIER();
+    q->get_ptr++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+msgq_get(struct msgq *q, void *msg)
+{
+  void *slot;
+
+  slot = msgq_peek(q);
+  if(slot == NULL) {
+    return 0;
+  }
+  memcpy(msg, slot, q->size);
+  msgq_remove(q);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,210 @@
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup msgq Message queues
+ * @{
+ *
+ * A message queue passes fixed-size messages from one producer to one
+ * consumer, which can be an interrupt handler and a process, or two
+ * processes. The messages are copied into a static array: there is no
+ * allocation. When a message is added to an empty queue, the consuming
+ * process is polled, so that it does not have to check the queue on
+ * every event or with a timer.
+ *
+ * \code
+struct reading {
+  uint16_t value;
+  uint8_t channel;
+};
+MSGQ(readings, struct reading, 8);
+
+void
+adc_interrupt(void)
+{
+  struct reading r = { ADC12MEM0, 0 };
+  msgq_put(&readings, &r);
+}
+
+PROCESS_THREAD(reader_process, ev, data)
+{
+  static struct reading r;
+
+  PROCESS_BEGIN();
+  msgq_init(&readings, PROCESS_CURRENT());
+  while(1) {
+    PROCESS_MSGQ_WAIT(&readings);
+    while(msgq_get(&readings, &r)) {
+      handle(&r);
+    }
+  }
+  PROCESS_END();
+}
+ \endcode
+ *
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the message queue library
+ */
+
+#ifndef __MSGQ_H__
+#define __MSGQ_H__
+
+#include "contiki-conf.h"
+#include "sys/cc.h"
+#include "sys/process.h"
+
+/**
+ * \brief      Structure that holds the state of a message queue.
+ *
+ *             The queue is declared with MSGQ(), which also
+ *             declares the array that holds the messages.
+ *
+ */
+struct msgq {
+  uint8_t *data;
+  uint16_t size;
+  uint8_t mask;
+
+  /* Free-running counters, written by one side each. They are 8-bit
+     quantities to be read and written atomically. */
+  volatile uint8_t put_ptr, get_ptr;
+
+  struct process *consumer;
+  uint16_t dropped;
+};
+
+/**
+ * \brief      Declare a message queue
+ * \param name The name of the queue
+ * \param type The type of the messages
+ * \param num  The number of messages the queue holds: a power of two,
+ *             at most 128
+ *
+ */
+#define MSGQ(name, type, num)                                   \
+  static type CC_CONCAT(name,_msgq_data)[num];                  \
+  static struct msgq name = {                                   \
+    (uint8_t *)CC_CONCAT(name,_msgq_data), sizeof(type),        \
+    (num) - 1, 0, 0, NULL, 0 }
+
+/**
+ * \brief      Empty a message queue and set its consumer
+ * \param q    The queue
+ * \param consumer The process polled when a message arrives in the
+ *             empty queue, or NULL
+ *
+ */
+void msgq_init(struct msgq *q, struct process *consumer);
+
+/**
+ * \brief      Add a message to a queue
+ * \param q    The queue
+ * \param msg  The message, copied into the queue
+ * \return     1 if the message was added, 0 if the queue was full
+ *
+ *             This function can be called from an interrupt handler.
+ *             The messages that did not fit are counted in the
+ *             dropped field of the queue.
+ *
+ */
+int msgq_put(struct msgq *q, const void *msg);
+
+/**
+ * \brief      Get the place of the next message, to fill it in
+ *             place
+ * \return     A pointer to the message, or NULL if the queue is full
+ *
+ *             The message is added to the queue by msgq_commit().
+ *
+ */
+void *msgq_reserve(struct msgq *q);
+void msgq_commit(struct msgq *q);
+
+/**
+ * \brief      Take the oldest message of a queue
+ * \param q    The queue
+ * \param msg  Where the message is copied
+ * \return     1 if a message was taken, 0 if the queue was empty
+ *
+ */
+int msgq_get(struct msgq *q, void *msg);
+
+/**
+ * \brief      Get the oldest message of a queue, without taking it
+ * \return     A pointer to the message in the queue, or NULL if the
+ *             queue is empty
+ *
+ *             The message stays valid until it is removed with
+ *             msgq_remove().
+ *
+ */
+void *msgq_peek(struct msgq *q);
+void msgq_remove(struct msgq *q);
+
+/**
+ * \brief      Get the number of messages in a queue
+ *
+ */
+#define msgq_len(q) ((uint8_t)((q)->put_ptr - (q)->get_ptr))
+#define msgq_empty(q) ((q)->put_ptr == (q)->get_ptr)
+
+/**
+ * \brief      Wait until a message queue is not empty
+ * \param q    The queue
+ *
+ *             The current process becomes the consumer of the queue.
+ *             It does not wait if the queue holds a message already,
+ *             otherwise it is woken up by a poll when a message
+ *             arrives. The consumer is polled only when a message is
+ *             added to an empty queue: it takes all the messages
+ *             before it waits again.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_MSGQ_WAIT(q)                    \
+  do {                                          \
+    (q)->consumer = PROCESS_CURRENT();          \
+    PROCESS_WAIT_UNTIL(!msgq_empty(q));         \
+  } while(0)
+
+#endif /* __MSGQ_H__ */
+
+/** @} */
+/** @} */
@@ -89,7 +89,7 @@ timesynch_set_authority_level(int level)
 
   authority_level = level;
 
-  if(old_level != authority_level) {
+  if(old_level != authority_level && process_is_running(&timesynch_process)) {
     /* Restart the timesynch process to restart with a low
        transmission interval. */
     process_exit(&timesynch_process);
@@ -144,6 +144,16 @@ broadcast_recv(struct broadcast_conn *c, const rimeaddr_t *from)
     timesynch_set_authority_level(msg.authority_level + 1);
   }
 }
+/*---------------------------------------------------------------------------*/
+void
+timesynch_incoming(int level, rtimer_clock_t authoritative_time,
+                   rtimer_clock_t local_time)
+{
+  if(level < authority_level) {
+    adjust_offset(authoritative_time, local_time);
+    timesynch_set_authority_level(level + 1);
+  }
+}
 static const struct broadcast_callbacks broadcast_call = {broadcast_recv};
 static struct broadcast_conn broadcast;
 /*---------------------------------------------------------------------------*/
@@ -192,6 +202,7 @@ PROCESS_THREAD(timesynch_process, ev, data)
 void
 timesynch_init(void)
 {
+  process_set_priority(&timesynch_process, PROCESS_PRIORITY_HIGH);
   process_start(&timesynch_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -144,6 +144,22 @@ int timesynch_authority_level(void);
  */
 void timesynch_set_authority_level(int level);
 
+/**
+ * \brief      Synchronize to a timestamp received by other means
+ * \param level The authority level of the sender of the timestamp
+ * \param authoritative_time The time-synchronized time of the sender
+ * \param local_time The local rtimer time at which authoritative_time was valid
+ *
+ *             This function lets a MAC protocol that carries
+ *             timestamps in its own frames use the timesynch
+ *             module. As with the timesynch broadcasts, the node
+ *             synchronizes to a sender with a lower authority level
+ *             and takes a level one higher than the sender's. Such a
+ *             MAC does not need to call timesynch_init().
+ */
+void timesynch_incoming(int level, rtimer_clock_t authoritative_time,
+                        rtimer_clock_t local_time);
+
 #endif /* __TIMESYNCH_H__ */
 
 /** @} */
@@ -66,6 +66,7 @@
 #include "net/rime.h"
 #include "net/sicslowpan.h"
 #include "net/netstack.h"
+#include "sys/profile.h"
 
 #if UIP_CONF_IPV6
 
@@ -1363,6 +1364,7 @@ output(uip_lladdr_t *localdest)
 
   /* Number of bytes processed. */
   uint16_t processed_ip_out_len;
+  PROFILE_SCOPE(SICSLOWPAN_OUTPUT);
 
   /* init */
   uncomp_hdr_len = 0;
@@ -1594,6 +1596,7 @@ input(void)
   uint16_t frag_tag = 0;
   uint8_t first_fragment = 0, last_fragment = 0;
 #endif /*SICSLOWPAN_CONF_FRAG*/
+  PROFILE_SCOPE(SICSLOWPAN_INPUT);
 
   /* init */
   uncomp_hdr_len = 0;
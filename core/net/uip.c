@@ -74,6 +74,7 @@
 #include "net/uipopt.h"
 #include "net/uip_arp.h"
 #include "net/uip_arch.h"
+#include "sys/profile.h"
 
 #if !UIP_CONF_IPV6 /* If UIP_CONF_IPV6 is defined, we compile the
 		      uip6.c file instead of this one. Therefore
@@ -673,6 +674,7 @@ void
 uip_process(uint8_t flag)
 {
   register struct uip_conn *uip_connr = uip_conn;
+  PROFILE_SCOPE(UIP_PROCESS);
 
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
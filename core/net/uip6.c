@@ -75,6 +75,7 @@
 #include "net/uip-icmp6.h"
 #include "net/uip-nd6.h"
 #include "net/uip-ds6.h"
+#include "sys/profile.h"
 
 #include <string.h>
 
@@ -915,6 +916,7 @@ uip_process(uint8_t flag)
 #if UIP_TCP
   register struct uip_conn *uip_connr = uip_conn;
 #endif /* UIP_TCP */
+  PROFILE_SCOPE(UIP_PROCESS);
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -106,6 +106,23 @@ void clock_delay(unsigned int);
 int clock_fine_max(void);
 unsigned short clock_fine(void);
 
+/**
+ * Suppress the periodic clock interrupt for a number of ticks.
+ *
+ * This function is called by the idle loop of platforms that
+ * support it, with interrupts disabled, just before the CPU goes to
+ * sleep. The clock interrupt then wakes the CPU only after \a ticks
+ * clock ticks, typically idle_time_left(). clock_time() stays correct
+ * for the interrupt handlers that run in between.
+ *
+ */
+void clock_tickless_enter(clock_time_t ticks);
+
+/**
+ * Resume the periodic clock interrupt after the CPU has woken up.
+ */
+void clock_tickless_exit(void);
+
 CCIF unsigned long clock_seconds(void);
 
 void etimer_interrupt(void);
@@ -47,10 +47,30 @@
 #include "contiki.h"
 #include "lib/list.h"
 
+#include <stddef.h>
+
+/*
+ * Until ctimer_process has started, the ctimers that are set wait in
+ * ctimer_list. From then on a ctimer is only an etimer of
+ * ctimer_process: the timer event points to the etimer inside the
+ * ctimer, which is found without a search. The next field is not used
+ * for the list anymore and marks the ctimers that were stopped or have
+ * already fired.
+ *
+ * The timer event of an active ctimer whose etimer has expired is
+ * still in the event queue. Stopping or setting the ctimer again
+ * removes that event, so that there is at most one, and none once the
+ * ctimer is idle: the memory of a stopped ctimer can be reused before
+ * the event would have been delivered.
+ */
 LIST(ctimer_list);
 
 static char initialized;
 
+#define IDLE(c)          ((c)->next == (c))
+#define SET_IDLE(c)      ((c)->next = (c))
+#define SET_ACTIVE(c)    ((c)->next = NULL)
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -59,31 +79,42 @@ static char initialized;
 #define PRINTF(...)
 #endif
 
-/*---------------------------------------------------------------------------*/
 PROCESS(ctimer_process, "Ctimer process");
+/*---------------------------------------------------------------------------*/
+/* Remove the timer event that is queued for the ctimer, if any */
+static void
+cancel_event(struct ctimer *c)
+{
+  if(!IDLE(c) && etimer_expired(&c->etimer)) {
+    process_cancel_event(&ctimer_process, PROCESS_EVENT_TIMER, &c->etimer);
+  }
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(ctimer_process, ev, data)
 {
   struct ctimer *c;
   PROCESS_BEGIN();
 
-  for(c = list_head(ctimer_list); c != NULL; c = c->next) {
+  while((c = list_pop(ctimer_list)) != NULL) {
+    SET_ACTIVE(c);
     etimer_set(&c->etimer, c->etimer.timer.interval);
   }
   initialized = 1;
 
   while(1) {
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
-    for(c = list_head(ctimer_list); c != NULL; c = c->next) {
-      if(&c->etimer == data) {
-	list_remove(ctimer_list, c);
-	PROCESS_CONTEXT_BEGIN(c->p);
-	if(c->f != NULL) {
-	  c->f(c->ptr);
-	}
-	PROCESS_CONTEXT_END(c->p);
-	break;
-      }
+    c = (struct ctimer *)((char *)data - offsetof(struct ctimer, etimer));
+    /* The queued event is removed when the ctimer is stopped or set
+       again, so this is only a safeguard */
+    if(IDLE(c) || !etimer_expired(&c->etimer)) {
+      continue;
     }
+    SET_IDLE(c);
+    PROCESS_CONTEXT_BEGIN(c->p);
+    if(c->f != NULL) {
+      c->f(c->ptr);
+    }
+    PROCESS_CONTEXT_END(c->p);
   }
   PROCESS_END();
 }
@@ -105,53 +136,60 @@ ctimer_set(struct ctimer *c, clock_time_t t,
   c->f = f;
   c->ptr = ptr;
   if(initialized) {
+    cancel_event(c);
+    SET_ACTIVE(c);
     PROCESS_CONTEXT_BEGIN(&ctimer_process);
     etimer_set(&c->etimer, t);
     PROCESS_CONTEXT_END(&ctimer_process);
   } else {
     c->etimer.timer.interval = t;
+    list_remove(ctimer_list, c);
+    list_add(ctimer_list, c);
   }
-
-  list_remove(ctimer_list, c);
-  list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_reset(struct ctimer *c)
 {
   if(initialized) {
+    cancel_event(c);
+    SET_ACTIVE(c);
     PROCESS_CONTEXT_BEGIN(&ctimer_process);
     etimer_reset(&c->etimer);
     PROCESS_CONTEXT_END(&ctimer_process);
+  } else {
+    list_remove(ctimer_list, c);
+    list_add(ctimer_list, c);
   }
-
-  list_remove(ctimer_list, c);
-  list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_restart(struct ctimer *c)
 {
   if(initialized) {
+    cancel_event(c);
+    SET_ACTIVE(c);
     PROCESS_CONTEXT_BEGIN(&ctimer_process);
     etimer_restart(&c->etimer);
     PROCESS_CONTEXT_END(&ctimer_process);
+  } else {
+    list_remove(ctimer_list, c);
+    list_add(ctimer_list, c);
   }
-
-  list_remove(ctimer_list, c);
-  list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_stop(struct ctimer *c)
 {
   if(initialized) {
+    cancel_event(c);
     etimer_stop(&c->etimer);
+    SET_IDLE(c);
   } else {
+    list_remove(ctimer_list, c);
     c->etimer.next = NULL;
     c->etimer.p = PROCESS_NONE;
   }
-  list_remove(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
 int
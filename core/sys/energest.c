@@ -43,6 +43,22 @@
 
 #if ENERGEST_CONF_ON
 
+#if ENERGEST_CONF_PROCESS
+#include "sys/process.h"
+
+static void process_fold(rtimer_clock_t now);
+#endif
+
+/* Where interrupt handlers turn energest types on and off, they are
+   masked while a total is read: it takes several instructions */
+#ifdef ENERGEST_CONF_LOCK
+#define LOCK(s)   (s) = ENERGEST_CONF_LOCK()
+#define UNLOCK(s) ENERGEST_CONF_UNLOCK(s)
+#else
+#define LOCK(s)   (s) = 0
+#define UNLOCK(s) (void)(s)
+#endif
+
 int energest_total_count;
 energest_t energest_total_time[ENERGEST_TYPE_MAX];
 rtimer_clock_t energest_current_time[ENERGEST_TYPE_MAX];
@@ -67,9 +83,13 @@ energest_init(void)
 #endif
 }
 /*---------------------------------------------------------------------------*/
-unsigned long
-energest_type_time(int type)
+energest_time_t
+energest_type_time_wide(int type)
 {
+  energest_time_t t;
+  int s;
+
+  LOCK(s);
   /* Note: does not support ENERGEST_CONF_LEVELDEVICE_LEVELS! */
 #ifndef ENERGEST_CONF_LEVELDEVICE_LEVELS
   if(energest_current_mode[type]) {
@@ -79,7 +99,15 @@ energest_type_time(int type)
     energest_current_time[type] = now;
   }
 #endif /* ENERGEST_CONF_LEVELDEVICE_LEVELS */
-  return energest_total_time[type].current;
+  t = energest_total_time[type].current;
+  UNLOCK(s);
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+energest_type_time(int type)
+{
+  return (unsigned long)energest_type_time_wide(type);
 }
 /*---------------------------------------------------------------------------*/
 unsigned long
@@ -93,9 +121,13 @@ energest_leveldevice_leveltime(int powerlevel)
 }
 /*---------------------------------------------------------------------------*/
 void
-energest_type_set(int type, unsigned long val)
+energest_type_set(int type, energest_time_t val)
 {
+  int s;
+
+  LOCK(s);
   energest_total_time[type].current = val;
+  UNLOCK(s);
 }
 /*---------------------------------------------------------------------------*/
 /* Note: does not support ENERGEST_CONF_LEVELDEVICE_LEVELS! */
@@ -104,6 +136,10 @@ energest_flush(void)
 {
   rtimer_clock_t now;
   int i;
+#if ENERGEST_CONF_PROCESS
+  int s;
+#endif
+
   for(i = 0; i < ENERGEST_TYPE_MAX; i++) {
     if(energest_current_mode[i]) {
       now = RTIMER_NOW();
@@ -112,11 +148,62 @@ energest_flush(void)
       energest_current_time[i] = now;
     }
   }
+#if ENERGEST_CONF_PROCESS
+  LOCK(s);
+  process_fold(RTIMER_NOW());
+  UNLOCK(s);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+#if ENERGEST_CONF_PROCESS
+static struct process *running;
+static rtimer_clock_t running_since;
+
+/* Charge the time since running_since to the running process. It must
+   be done before the 16-bit rtimer wraps: energest_flush() does it too */
+static void
+process_fold(rtimer_clock_t now)
+{
+  if(running != NULL) {
+    running->cpu_time += (rtimer_clock_t)(now - running_since);
+  }
+  running_since = now;
+}
+/*---------------------------------------------------------------------------*/
+struct process *
+energest_process_switch(struct process *p)
+{
+  struct process *prev;
+  int s;
+
+  LOCK(s);
+  prev = running;
+  process_fold(RTIMER_NOW());
+  running = p;
+  UNLOCK(s);
+  return prev;
+}
+/*---------------------------------------------------------------------------*/
+energest_time_t
+energest_process_time(struct process *p)
+{
+  energest_time_t t;
+  int s;
+
+  LOCK(s);
+  if(p == running) {
+    process_fold(RTIMER_NOW());
+  }
+  t = p->cpu_time;
+  UNLOCK(s);
+  return t;
 }
 /*---------------------------------------------------------------------------*/
+#endif /* ENERGEST_CONF_PROCESS */
 #else /* ENERGEST_CONF_ON */
-void energest_type_set(int type, unsigned long val) {}
+void energest_type_set(int type, energest_time_t val) {}
 void energest_init(void) {}
 unsigned long energest_type_time(int type) { return 0; }
+energest_time_t energest_type_time_wide(int type) { return 0; }
 void energest_flush(void) {}
 #endif /* ENERGEST_CONF_ON */
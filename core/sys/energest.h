@@ -43,9 +43,21 @@
 
 #include "sys/rtimer.h"
 
+/*
+ * Accumulated time, in rtimer ticks. 64 bits do not wrap around in the
+ * lifetime of a node, where 32 bits of a 32768 Hz rtimer last 36 hours.
+ */
+#ifdef ENERGEST_CONF_TIME_T
+typedef ENERGEST_CONF_TIME_T energest_time_t;
+#elif ENERGEST_CONF_ON
+typedef unsigned long long energest_time_t;
+#else
+typedef unsigned long energest_time_t;
+#endif
+
 typedef struct {
   /*  unsigned long cumulative[2];*/
-  unsigned long current;
+  energest_time_t current;
 } energest_t;
 
 enum energest_type {
@@ -70,12 +82,28 @@ enum energest_type {
 
 void energest_init(void);
 unsigned long energest_type_time(int type);
+/* The full accumulated time. energest_type_time() returns its low 32
+   bits, enough for differences over less than a day. */
+energest_time_t energest_type_time_wide(int type);
 #ifdef ENERGEST_CONF_LEVELDEVICE_LEVELS
 unsigned long energest_leveldevice_leveltime(int powerlevel);
 #endif
-void energest_type_set(int type, unsigned long value);
+void energest_type_set(int type, energest_time_t value);
 void energest_flush(void);
 
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+/*
+ * CPU time of each process. call_process() charges the time spent in a
+ * process, including the interrupts that preempt it, to the process.
+ * A process that runs for longer than a wrap of the rtimer (2 s on the
+ * MSP430) needs energest_flush() to be called in between, as the
+ * MSP430 clock interrupt does every second.
+ */
+struct process;
+struct process *energest_process_switch(struct process *p);
+energest_time_t energest_process_time(struct process *p);
+#endif
+
 #if ENERGEST_CONF_ON
 /*extern int energest_total_count;*/
 extern energest_t energest_total_time[ENERGEST_TYPE_MAX];
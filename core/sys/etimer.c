@@ -50,38 +50,63 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+/*
+ * The pending event timers, sorted by expiration time: the next timer
+ * to expire is always first. Inserting a timer walks the list up to
+ * its position, the etimer process only looks at the timers that have
+ * expired and the next expiration time is the one of the first timer.
+ */
 static struct etimer *timerlist;
-static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
 /*---------------------------------------------------------------------------*/
+/* Time left before the timer expires, 0 if it has already expired.
+   Wraps are handled as in timer_expired(). */
+static clock_time_t
+time_left(struct etimer *t, clock_time_t now)
+{
+  clock_time_t elapsed = now - t->timer.start;
+
+  return elapsed >= t->timer.interval ? 0 : t->timer.interval - elapsed;
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a timer that is not on the list at its place. Timers that
+   expire at the same time stay in the order they were added. */
 static void
-update_time(void)
+insert_timer(struct etimer *timer)
 {
-  clock_time_t tdist;
-  clock_time_t now;
-  struct etimer *t;
+  struct etimer **tp;
+  clock_time_t now, left;
+
+  now = clock_time();
+  left = time_left(timer, now);
+  for(tp = &timerlist; *tp != NULL && time_left(*tp, now) <= left;
+      tp = &(*tp)->next);
+  timer->next = *tp;
+  *tp = timer;
+}
+/*---------------------------------------------------------------------------*/
+/* Unlink a timer from the list. Returns non-zero if it was on it. */
+static int
+remove_timer(struct etimer *timer)
+{
+  struct etimer **tp;
 
-  if (timerlist == NULL) {
-    next_expiration = 0;
-  } else {
-    now = clock_time();
-    t = timerlist;
-    /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
-    for(t = t->next; t != NULL; t = t->next) {
-      if(t->timer.start + t->timer.interval - now < tdist) {
-	tdist = t->timer.start + t->timer.interval - now;
-      }
+  for(tp = &timerlist; *tp != NULL; tp = &(*tp)->next) {
+    if(*tp == timer) {
+      *tp = timer->next;
+      timer->next = NULL;
+      return 1;
     }
-    next_expiration = now + tdist;
   }
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(etimer_process, ev, data)
 {
-  struct etimer *t, *u;
-	
+  struct etimer *t, **tp;
+  clock_time_t now;
+
   PROCESS_BEGIN();
 
   timerlist = NULL;
@@ -92,17 +117,12 @@ PROCESS_THREAD(etimer_process, ev, data)
     if(ev == PROCESS_EVENT_EXITED) {
       struct process *p = data;
 
-      while(timerlist != NULL && timerlist->p == p) {
-	timerlist = timerlist->next;
-      }
-
-      if(timerlist != NULL) {
-	t = timerlist;
-	while(t->next != NULL) {
-	  if(t->next->p == p) {
-	    t->next = t->next->next;
-	  } else
-	    t = t->next;
+      tp = &timerlist;
+      while(*tp != NULL) {
+	if((*tp)->p == p) {
+	  *tp = (*tp)->next;
+	} else {
+	  tp = &(*tp)->next;
 	}
       }
       continue;
@@ -110,33 +130,23 @@ PROCESS_THREAD(etimer_process, ev, data)
       continue;
     }
 
-  again:
-    
-    u = NULL;
-    
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(timer_expired(&t->timer)) {
-	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
-	  
-	  /* Reset the process ID of the event timer, to signal that the
-	     etimer has expired. This is later checked in the
-	     etimer_expired() function. */
-	  t->p = PROCESS_NONE;
-	  if(u != NULL) {
-	    u->next = t->next;
-	  } else {
-	    timerlist = t->next;
-	  }
-	  t->next = NULL;
-	  update_time();
-	  goto again;
-	} else {
-	  etimer_request_poll();
-	}
+    /* The list is sorted: stop at the first timer that has not
+       expired yet. */
+    now = clock_time();
+    while(timerlist != NULL && time_left(timerlist, now) == 0) {
+      t = timerlist;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK) {
+	/* The event queue is full, try again later. */
+	etimer_request_poll();
+	break;
       }
-      u = t;
+      /* Reset the process ID of the event timer, to signal that the
+	 etimer has expired. This is later checked in the
+	 etimer_expired() function. */
+      timerlist = t->next;
+      t->next = NULL;
+      t->p = PROCESS_NONE;
     }
-    
   }
   
   PROCESS_END();
@@ -151,27 +161,14 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
-  struct etimer *t;
-
   etimer_request_poll();
 
-  if(timer->p != PROCESS_NONE) {
-    /* Timer not on list. */
-    
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(t == timer) {
-	/* Timer already on list, bail out. */
-	update_time();
-	return;
-      }
-    }
+  /* A timer that is already on the list keeps its process, but moves
+     to the place of its new expiration time. */
+  if(timer->p == PROCESS_NONE || !remove_timer(timer)) {
+    timer->p = PROCESS_CURRENT();
   }
-
-  timer->p = PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
-
-  update_time();
+  insert_timer(timer);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -199,7 +196,9 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
-  update_time();
+  if(et->p != PROCESS_NONE && remove_timer(et)) {
+    insert_timer(et);
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -229,32 +228,13 @@ etimer_pending(void)
 clock_time_t
 etimer_next_expiration_time(void)
 {
-  return etimer_pending() ? next_expiration : 0;
+  return etimer_pending() ? etimer_expiration_time(timerlist) : 0;
 }
 /*---------------------------------------------------------------------------*/
 void
 etimer_stop(struct etimer *et)
 {
-  struct etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if(et == timerlist) {
-    timerlist = timerlist->next;
-    update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for(t = timerlist; t != NULL && t->next != et; t = t->next);
-
-    if(t != NULL) {
-      /* We've found the item before the event timer that we are about
-	 to remove. We point the items next pointer to the event after
-	 the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
-  }
+  remove_timer(et);
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
@@ -0,0 +1,94 @@
+/**
+ * \addtogroup idle
+ * @{
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Time until the next timer deadline
+ */
+
+#include "sys/idle.h"
+#include "sys/etimer.h"
+#include "sys/rtimer.h"
+#include "sys/process.h"
+
+#define MAX_TICKS ((clock_time_t)~(clock_time_t)0 / 2)
+
+/* Platforms where RTIMER_NOW() can not be read from the idle loop
+   give another way to read the rtimer clock */
+#ifdef IDLE_CONF_RTIMER_NOW
+#define NOW() IDLE_CONF_RTIMER_NOW()
+#else
+#define NOW() RTIMER_NOW()
+#endif
+
+/*---------------------------------------------------------------------------*/
+clock_time_t
+idle_time_left(void)
+{
+  clock_time_t left, ticks;
+  rtimer_clock_t t, now;
+
+  if(process_nevents() > 0) {
+    return 0;
+  }
+
+  left = IDLE_FOREVER;
+  if(etimer_pending()) {
+    left = etimer_next_expiration_time() - clock_time();
+    if((clock_time_t)(left - 1) > MAX_TICKS) {
+      return 0;
+    }
+  }
+
+  if(rtimer_next_time(&t)) {
+    now = NOW();
+    if(!RTIMER_CLOCK_LT(now, t)) {
+      return 0;
+    }
+    ticks = (unsigned long)(rtimer_clock_t)(t - now) * CLOCK_SECOND /
+      RTIMER_SECOND;
+    if(ticks < left) {
+      left = ticks;
+    }
+  }
+
+  return left;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
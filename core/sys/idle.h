@@ -0,0 +1,84 @@
+/**
+ * \addtogroup sys
+ * @{
+ */
+
+/**
+ * \defgroup idle Idle time
+ * @{
+ *
+ * The idle module tells the idle loop of a platform how long the
+ * system can sleep: until the earliest deadline of the pending event
+ * timers, callback timers and real-time tasks. Platforms use it to
+ * suppress the periodic clock interrupt while the system sleeps.
+ *
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the idle time module
+ */
+
+#ifndef __IDLE_H__
+#define __IDLE_H__
+
+#include "sys/clock.h"
+
+/**
+ * The value of idle_time_left() when no timer is pending.
+ */
+#define IDLE_FOREVER ((clock_time_t)~0)
+
+/**
+ * \brief      Get the time until the next timer deadline
+ * \return     The number of clock ticks until the earliest deadline of
+ *             the pending etimers, ctimers and rtimers, 0 if a timer
+ *             has expired or if there are events to process, and
+ *             IDLE_FOREVER if nothing is pending.
+ *
+ *             This function is called by the idle loop, with
+ *             interrupts disabled, before the CPU goes to sleep.
+ *             The time until an rtimer deadline is rounded down to
+ *             clock ticks.
+ *
+ */
+clock_time_t idle_time_left(void);
+
+#endif /* __IDLE_H__ */
+
+/** @} */
+/** @} */
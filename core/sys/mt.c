@@ -115,3 +115,23 @@ mt_stop(struct mt_thread *thread)
   mtarch_stop(&thread->thread);
 }
 /*--------------------------------------------------------------------------*/
+int
+mt_stack_usage(struct mt_thread *thread)
+{
+#ifdef MTARCH_STACK_CHECK
+  return mtarch_stack_usage(&thread->thread);
+#else /* MTARCH_STACK_CHECK */
+  return -1;
+#endif /* MTARCH_STACK_CHECK */
+}
+/*--------------------------------------------------------------------------*/
+int
+mt_stack_size(struct mt_thread *thread)
+{
+#ifdef MTARCH_STACK_CHECK
+  return mtarch_stack_size(&thread->thread);
+#else /* MTARCH_STACK_CHECK */
+  return -1;
+#endif /* MTARCH_STACK_CHECK */
+}
+/*--------------------------------------------------------------------------*/
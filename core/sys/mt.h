@@ -173,6 +173,19 @@ void mtarch_stop(struct mtarch_thread *thread);
 void mtarch_pstart(void);
 void mtarch_pstop(void);
 
+/*
+ * Architectures that watermark thread stacks define
+ * MTARCH_STACK_CHECK in mtarch.h and implement:
+ *
+ * int mtarch_stack_usage(struct mtarch_thread *thread);
+ * int mtarch_stack_size(struct mtarch_thread *thread);
+ *
+ * mtarch_start() fills the stack with a known pattern and
+ * mtarch_stack_usage() returns the number of bytes from the top of
+ * the stack down to the deepest location that no longer holds the
+ * pattern. Both return bytes.
+ */
+
 /** @} */
 
 
@@ -265,6 +278,29 @@ void mt_exit(void);
  */
 void mt_stop(struct mt_thread *thread);
 
+/**
+ * Get the peak stack usage of a thread.
+ *
+ * The stack is filled with a known pattern when the thread is
+ * started, so the result is the high-water mark since mt_start(),
+ * including the initial frame and any interrupt that ran on the
+ * thread stack. A result equal to mt_stack_size() means that the
+ * stack has most likely overflowed.
+ *
+ * \param thread A pointer to a started struct mt_thread.
+ *
+ * \return The number of bytes used, or -1 if the architecture does
+ * not watermark thread stacks.
+ *
+ */
+int mt_stack_usage(struct mt_thread *thread);
+
+/**
+ * Get the size of the stack of a thread in bytes, or -1 if unknown.
+ *
+ */
+int mt_stack_size(struct mt_thread *thread);
+
 /** @} */
 /** @} */
 #endif /* __MT_H__ */
@@ -0,0 +1,97 @@
+/**
+ * \addtogroup process-sem
+ * @{
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Process semaphores
+ */
+
+#include "sys/process-sem.h"
+
+/* Semaphores are signalled from interrupts: mask them while the count
+   changes. Without the lock, there is no interrupt-safe way to change
+   the count here, and the semaphores are for processes only (see
+   process-sem.h). */
+#ifdef PROCESS_CONF_POLL_LOCK
+#define LOCK(s)   (s) = PROCESS_CONF_POLL_LOCK()
+#define UNLOCK(s) PROCESS_CONF_POLL_UNLOCK(s)
+#else
+#define LOCK(s)   (s) = 0
+#define UNLOCK(s) (void)(s)
+#endif
+
+/*---------------------------------------------------------------------------*/
+void
+process_sem_init(struct process_sem *s, unsigned int count)
+{
+  s->count = count;
+  s->waiter = NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_sem_signal(struct process_sem *s)
+{
+  int i;
+
+  LOCK(i);
+  s->count++;
+  UNLOCK(i);
+  if(s->waiter != NULL) {
+    process_poll(s->waiter);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+process_sem_trywait(struct process_sem *s)
+{
+  int i, taken;
+
+  LOCK(i);
+  taken = s->count > 0;
+  if(taken) {
+    s->count--;
+  }
+  UNLOCK(i);
+  if(taken && s->waiter == PROCESS_CURRENT()) {
+    s->waiter = NULL;
+  }
+  return taken;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,116 @@
+/**
+ * \addtogroup process
+ * @{
+ */
+
+/**
+ * \defgroup process-sem Process semaphores
+ * @{
+ *
+ * Counting semaphores for processes. Unlike the protothread
+ * semaphores of pt-sem.h, a process that waits on a semaphore is
+ * polled when the semaphore is signalled, so it does not depend on
+ * other events to check the semaphore again. Each semaphore has at
+ * most one waiting process.
+ *
+ * Semaphores can be signalled from interrupt handlers on the
+ * platforms that define PROCESS_CONF_POLL_LOCK(), which guards the
+ * count. On the others, such as native, they must only be used from
+ * processes.
+ *
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for process semaphores
+ */
+
+#ifndef __PROCESS_SEM_H__
+#define __PROCESS_SEM_H__
+
+#include "sys/process.h"
+
+struct process_sem {
+  volatile unsigned int count;
+  struct process *waiter;
+};
+
+/**
+ * \brief      Initialize a semaphore
+ * \param s    The semaphore
+ * \param count The initial count
+ *
+ */
+void process_sem_init(struct process_sem *s, unsigned int count);
+
+/**
+ * \brief      Signal a semaphore
+ *
+ *             Increments the count and polls the waiting process,
+ *             if any. This function can be called from an interrupt
+ *             handler only if the platform defines
+ *             PROCESS_CONF_POLL_LOCK().
+ *
+ */
+void process_sem_signal(struct process_sem *s);
+
+/**
+ * \brief      Take a semaphore if its count is not zero
+ * \return     1 if the count was decremented, 0 if it was zero
+ *
+ */
+int process_sem_trywait(struct process_sem *s);
+
+/**
+ * \brief      Wait for a semaphore and take it
+ * \param s    The semaphore
+ *
+ *             The current process waits until the count of the
+ *             semaphore is not zero, then decrements it.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_SEM_WAIT(s)                             \
+  do {                                                  \
+    (s)->waiter = PROCESS_CURRENT();                    \
+    PROCESS_WAIT_UNTIL(process_sem_trywait(s));         \
+  } while(0)
+
+#endif /* __PROCESS_SEM_H__ */
+
+/** @} */
+/** @} */
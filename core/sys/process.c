@@ -66,15 +66,47 @@ struct event_data {
   struct process *p;
 };
 
-static process_num_events_t nevents, fevent;
-static struct event_data events[PROCESS_CONF_NUMEVENTS];
+/*
+ * One event queue per priority. Events to high priority processes are
+ * delivered first.
+ */
+struct event_queue {
+  process_num_events_t nevents, fevent, size;
+  struct event_data *events;
+};
+
+static struct event_data normal_events[PROCESS_CONF_NUMEVENTS];
+static struct event_data high_events[PROCESS_CONF_NUMEVENTS_HIGH];
+static struct event_queue queues[PROCESS_PRIORITIES] = {
+  { 0, 0, PROCESS_CONF_NUMEVENTS, normal_events },
+  { 0, 0, PROCESS_CONF_NUMEVENTS_HIGH, high_events },
+};
+static process_num_events_t nevents;
 
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
+unsigned short process_overflows[PROCESS_PRIORITIES];
 #endif
 
 static volatile unsigned char poll_requested;
 
+/*
+ * Processes that need to be polled are linked in poll_list, so that
+ * do_poll() does not walk all processes. process_poll() is called
+ * from interrupts: platforms make the list safe by defining
+ * PROCESS_CONF_POLL_LOCK() and PROCESS_CONF_POLL_UNLOCK(), the others
+ * look for the needspoll flag in all processes, as before. A process
+ * is in the list exactly when its needspoll flag is set.
+ */
+#ifdef PROCESS_CONF_POLL_LOCK
+#define POLL_LIST 1
+#define POLL_LOCK(s)   (s) = PROCESS_CONF_POLL_LOCK()
+#define POLL_UNLOCK(s) PROCESS_CONF_POLL_UNLOCK(s)
+static struct process *poll_list;
+#else
+#define POLL_LIST 0
+#endif
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
@@ -169,6 +201,9 @@ static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+  struct process *caller;
+#endif
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -181,7 +216,13 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", p->name, ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+    caller = energest_process_switch(p);
     ret = p->thread(&p->pt, ev, data);
+    energest_process_switch(caller);
+#else
+    ret = p->thread(&p->pt, ev, data);
+#endif
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -203,10 +244,19 @@ process_init(void)
 {
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  queues[PROCESS_PRIORITY_NORMAL].nevents = 0;
+  queues[PROCESS_PRIORITY_NORMAL].fevent = 0;
+  queues[PROCESS_PRIORITY_HIGH].nevents = 0;
+  queues[PROCESS_PRIORITY_HIGH].fevent = 0;
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  process_overflows[PROCESS_PRIORITY_NORMAL] = 0;
+  process_overflows[PROCESS_PRIORITY_HIGH] = 0;
 #endif /* PROCESS_CONF_STATS */
+#if POLL_LIST
+  poll_list = NULL;
+#endif
 
   process_current = process_list = NULL;
 }
@@ -219,7 +269,32 @@ static void
 do_poll(void)
 {
   struct process *p;
+#if POLL_LIST
+  struct process *list, *q;
+  int s;
 
+  poll_requested = 0;
+  /* Take the processes polled so far, in the order of the requests.
+     Polls requested meanwhile go to the next round. */
+  POLL_LOCK(s);
+  q = poll_list;
+  poll_list = NULL;
+  POLL_UNLOCK(s);
+  for(list = NULL; q != NULL; q = p) {
+    p = q->nextpoll;
+    q->nextpoll = list;
+    list = q;
+  }
+  while(list != NULL) {
+    p = list;
+    list = p->nextpoll;
+    p->needspoll = 0;
+    if(process_is_running(p)) {
+      p->state = PROCESS_STATE_RUNNING;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+#else
   poll_requested = 0;
   /* Call the processes that needs to be polled. */
   for(p = process_list; p != NULL; p = p->next) {
@@ -229,6 +304,7 @@ do_poll(void)
       call_process(p, PROCESS_EVENT_POLL, NULL);
     }
   }
+#endif
 }
 /*---------------------------------------------------------------------------*/
 /*
@@ -243,6 +319,7 @@ do_event(void)
   static process_data_t data;
   static struct process *receiver;
   static struct process *p;
+  struct event_queue *q;
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -253,17 +330,28 @@ do_event(void)
    */
 
   if(nevents > 0) {
+
+    /* Events to high priority processes first */
+    q = &queues[PROCESS_PRIORITY_HIGH];
+    if(q->nevents == 0) {
+      q = &queues[PROCESS_PRIORITY_NORMAL];
+    }
     
     /* There are events that we should deliver. */
-    ev = events[fevent].ev;
+    ev = q->events[q->fevent].ev;
     
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    data = q->events[q->fevent].data;
+    receiver = q->events[q->fevent].p;
 
     /* Since we have seen the new event, we move pointer upwards
        and decrese the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    q->fevent = (q->fevent + 1) % q->size;
+    --q->nevents;
     --nevents;
+    if(q == &queues[PROCESS_PRIORITY_NORMAL] &&
+       receiver != PROCESS_BROADCAST && receiver->spilled > 0) {
+      --receiver->spilled;
+    }
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
@@ -316,6 +404,7 @@ int
 process_post(struct process *p, process_event_t ev, process_data_t data)
 {
   static process_num_events_t snum;
+  struct event_queue *q;
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -326,7 +415,26 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": p->name, nevents);
   }
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
+  q = &queues[PROCESS_PRIORITY_NORMAL];
+  /* Once an event has spilled to the normal queue, the next ones
+     follow it there until it is delivered, so that they keep their
+     order */
+  if(p != PROCESS_BROADCAST && p->priority == PROCESS_PRIORITY_HIGH &&
+     p->spilled == 0) {
+    q = &queues[PROCESS_PRIORITY_HIGH];
+    if(q->nevents == q->size) {
+#if PROCESS_CONF_STATS
+      process_overflows[PROCESS_PRIORITY_HIGH]++;
+#endif /* PROCESS_CONF_STATS */
+      /* Better late than lost */
+      q = &queues[PROCESS_PRIORITY_NORMAL];
+    }
+  }
+
+  if(q->nevents == q->size) {
+#if PROCESS_CONF_STATS
+    process_overflows[PROCESS_PRIORITY_NORMAL]++;
+#endif /* PROCESS_CONF_STATS */
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, process_current->name);
@@ -337,11 +445,16 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
     return PROCESS_ERR_FULL;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
-  events[snum].ev = ev;
-  events[snum].data = data;
-  events[snum].p = p;
+  snum = (process_num_events_t)(q->fevent + q->nevents) % q->size;
+  q->events[snum].ev = ev;
+  q->events[snum].data = data;
+  q->events[snum].p = p;
+  ++q->nevents;
   ++nevents;
+  if(q == &queues[PROCESS_PRIORITY_NORMAL] && p != PROCESS_BROADCAST &&
+     p->priority == PROCESS_PRIORITY_HIGH) {
+    ++p->spilled;
+  }
 
 #if PROCESS_CONF_STATS
   if(nevents > process_maxevents) {
@@ -353,6 +466,35 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 }
 /*---------------------------------------------------------------------------*/
 void
+process_cancel_event(struct process *p, process_event_t ev,
+		     process_data_t data)
+{
+  struct event_queue *q;
+  struct event_data *e;
+  process_num_events_t i, n, to;
+
+  /* Close the gaps in place, so that the other events keep their
+     order */
+  for(q = queues; q < &queues[PROCESS_PRIORITIES]; q++) {
+    n = q->nevents;
+    to = q->fevent;
+    for(i = 0; i < n; i++) {
+      e = &q->events[(process_num_events_t)(q->fevent + i) % q->size];
+      if(e->p == p && e->ev == ev && e->data == data) {
+	--q->nevents;
+	--nevents;
+	if(q == &queues[PROCESS_PRIORITY_NORMAL] && p->spilled > 0) {
+	  --p->spilled;
+	}
+      } else {
+	q->events[to] = *e;
+	to = (to + 1) % q->size;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
 process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 {
   struct process *caller = process_current;
@@ -364,15 +506,50 @@ process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 void
 process_poll(struct process *p)
 {
+#if POLL_LIST
+  int s;
+#endif
+
   if(p != NULL) {
     if(p->state == PROCESS_STATE_RUNNING ||
        p->state == PROCESS_STATE_CALLED) {
+#if POLL_LIST
+      POLL_LOCK(s);
+      if(!p->needspoll) {
+	p->needspoll = 1;
+	p->nextpoll = poll_list;
+	poll_list = p;
+      }
+      POLL_UNLOCK(s);
+#else
       p->needspoll = 1;
+#endif
       poll_requested = 1;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+process_set_priority(struct process *p, unsigned char priority)
+{
+  struct event_queue *q;
+  process_num_events_t i;
+
+  p->priority = priority;
+
+  /* Events already in the normal queue are delivered before the next
+     ones */
+  p->spilled = 0;
+  if(priority == PROCESS_PRIORITY_HIGH) {
+    q = &queues[PROCESS_PRIORITY_NORMAL];
+    for(i = 0; i < q->nevents; i++) {
+      if(q->events[(process_num_events_t)(q->fevent + i) % q->size].p == p) {
+	++p->spilled;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
 {
@@ -56,6 +56,9 @@
 
 #include "sys/pt.h"
 #include "sys/cc.h"
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+#include "sys/energest.h"
+#endif
 
 typedef unsigned char process_event_t;
 typedef void *        process_data_t;
@@ -89,6 +92,24 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Size of the event queue of high priority processes */
+#ifndef PROCESS_CONF_NUMEVENTS_HIGH
+#define PROCESS_CONF_NUMEVENTS_HIGH 8
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH */
+
+/**
+ * \name Process priorities
+ *
+ * Events to high priority processes are delivered before the events
+ * to normal processes and broadcast events.
+ *
+ * @{
+ */
+#define PROCESS_PRIORITY_NORMAL 0
+#define PROCESS_PRIORITY_HIGH   1
+#define PROCESS_PRIORITIES      2
+/* @} */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -310,7 +331,13 @@ struct process {
   const char *name;
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
-  unsigned char state, needspoll;
+  unsigned char state, needspoll, priority;
+  struct process *nextpoll;
+  /* Events of a high priority process in the normal queue */
+  process_num_events_t spilled;
+#if ENERGEST_CONF_ON && ENERGEST_CONF_PROCESS
+  energest_time_t cpu_time;
+#endif
 };
 
 /**
@@ -365,6 +392,37 @@ CCIF int process_post(struct process *p, process_event_t ev, void* data);
 CCIF void process_post_synch(struct process *p,
 			     process_event_t ev, void* data);
 
+/**
+ * Remove events that are still in the event queue.
+ *
+ * Every queued event to the process p with the event number ev and
+ * the data pointer data is removed, as if it had never been
+ * posted. The other events keep their order. This is used when the
+ * data of an event is about to become invalid, e.g. by ctimer_stop().
+ *
+ * \param p A pointer to the receiving process' process structure.
+ *
+ * \param ev The event number.
+ *
+ * \param data The data pointer the event was posted with.
+ */
+void process_cancel_event(struct process *p, process_event_t ev,
+			  process_data_t data);
+
+/**
+ * Set the priority of a process.
+ *
+ * Events posted to a PROCESS_PRIORITY_HIGH process, such as a radio
+ * driver or a MAC protocol, go to a separate queue that is served
+ * first, so they are not delayed by the events of bulk work. Set it
+ * where the process is started.
+ *
+ * \param p A pointer to the process' process structure.
+ *
+ * \param priority PROCESS_PRIORITY_NORMAL or PROCESS_PRIORITY_HIGH.
+ */
+void process_set_priority(struct process *p, unsigned char priority);
+
 /**
  * \brief      Cause a process to exit
  * \param p    The process that is to be exited
@@ -507,6 +565,20 @@ CCIF int process_is_running(struct process *p);
  */
 int process_nevents(void);
 
+#if PROCESS_CONF_STATS
+/**
+ * Largest number of events that were waiting at the same time.
+ */
+extern process_num_events_t process_maxevents;
+/**
+ * Number of events posted to a full queue, per priority. Events that
+ * do not fit in the high priority queue go to the normal one, and so
+ * do the next events of that process until they are delivered, so
+ * that its events keep their order. The others are lost.
+ */
+extern unsigned short process_overflows[PROCESS_PRIORITIES];
+#endif /* PROCESS_CONF_STATS */
+
 /** @} */
 
 CCIF extern struct process *process_list;
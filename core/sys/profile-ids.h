@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Identifiers of the profiled code sections
+ *
+ *         The list is kept free of other Contiki headers so that the
+ *         host tools can include it to name the sections of a dump.
+ *         Applications add their own sections with
+ *         PROFILE_CONF_USER_IDS, e.g.
+ *
+ *         #define PROFILE_CONF_USER_IDS(X) X(APP_SENSE, "app_sense")
+ */
+
+#ifndef __PROFILE_IDS_H__
+#define __PROFILE_IDS_H__
+
+#ifdef PROFILE_CONF_USER_IDS
+#define PROFILE_USER_IDS(X) PROFILE_CONF_USER_IDS(X)
+#else
+#define PROFILE_USER_IDS(X)
+#endif
+
+#define PROFILE_IDS(X)                                  \
+  X(EPISODE,           "process_run")                   \
+  X(STAFFETTA_SEND,    "staffetta_send_packet")         \
+  X(STAFFETTA_SINK,    "staffetta_sink_ack")            \
+  X(UIP_PROCESS,       "uip_process")                   \
+  X(SICSLOWPAN_INPUT,  "sicslowpan_input")              \
+  X(SICSLOWPAN_OUTPUT, "sicslowpan_output")             \
+  X(COFFEE_READ,       "cfs_read")                      \
+  X(COFFEE_WRITE,      "cfs_write")                     \
+  PROFILE_USER_IDS(X)
+
+#define PROFILE_ID_ENUM(id, name) PROFILE_ID_##id,
+enum {
+  PROFILE_IDS(PROFILE_ID_ENUM)
+  PROFILE_ID_MAX
+};
+#undef PROFILE_ID_ENUM
+
+/* Version of the dump format written by profile_dump() */
+#define PROFILE_DUMP_VERSION 1
+
+#endif /* __PROFILE_IDS_H__ */
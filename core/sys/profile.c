@@ -40,157 +40,331 @@
 #include "sys/profile.h"
 #include "sys/clock.h"
 
+#if PROFILE_CONF_ON
+
 #include <stdio.h>
+#include <string.h>
+
+#if PROFILE_CONF_ACTIVE
+#include "sys/etimer.h"
+
+PROCESS(profile_process, "Profile");
+#endif /* PROFILE_CONF_ACTIVE */
+
+/* Markers are taken from interrupts: mask them while a marker is
+   stored */
+#ifdef PROFILE_CONF_LOCK
+#define LOCK(s)   (s) = PROFILE_CONF_LOCK()
+#define UNLOCK(s) PROFILE_CONF_UNLOCK(s)
+#else
+#define LOCK(s)   (s) = 0
+#define UNLOCK(s) (void)(s)
+#endif
 
-/* XXX: the profiling code is under development and may not work at
-   present. */
+#define RING_MASK (PROFILE_RING_SIZE - 1)
 
+/* Bytes of the dump header and of a section without its bins */
+#define HEADER_LEN  10
+#define SECTION_LEN 15
 
-TIMETABLE_NONSTATIC(profile_timetable);
+struct profile_marker {
+  rtimer_clock_t time;
+  uint8_t id;
+  uint8_t type;
+};
 
-TIMETABLE_NONSTATIC(profile_begin_timetable);
-TIMETABLE_NONSTATIC(profile_end_timetable);
-TIMETABLE_AGGREGATE(profile_aggregate, PROFILE_AGGREGATE_SIZE);
+static struct profile_marker ring[PROFILE_RING_SIZE];
+static volatile unsigned int ring_put;
+static unsigned int ring_get;
 
-static rtimer_clock_t episode_start_time;
-static unsigned int invalid_episode_overflow, invalid_episode_toolong,
-  max_queuelen;
+static struct profile_stats stats[PROFILE_ID_MAX];
+static rtimer_clock_t begin_time[PROFILE_ID_MAX];
+static uint8_t pending[PROFILE_ID_MAX];
+static unsigned short dropped, unpaired;
 
-/* The number of fine grained ticks per coarse grained ticks. We
-   currently (MSP430) have 2457600 ticks per second for the fine
-   grained timer, and 32678 / 8 ticks per second for the coarse. */
-#define XXX_HACK_FINE_TICKS_PER_COARSE_TICK (2457600/(32678/8))
+/* The time taken by a pair of markers, subtracted from every
+   duration */
+static rtimer_clock_t marker_time;
 
 /*---------------------------------------------------------------------------*/
 void
-profile_init(void)
+profile_record(uint8_t id, uint8_t type)
 {
-  timetable_init();
-  timetable_clear(&profile_begin_timetable);
-  timetable_clear(&profile_end_timetable);
+  struct profile_marker *m;
+  int s;
+
+  LOCK(s);
+  if(ring_put - ring_get >= PROFILE_RING_SIZE) {
+    dropped++;
+  } else {
+    m = &ring[ring_put & RING_MASK];
+    m->id = id;
+    m->type = type;
+    m->time = PROFILE_NOW();
+    ring_put++;
+  }
+  UNLOCK(s);
+}
+/*---------------------------------------------------------------------------*/
+#ifdef __GNUC__
+uint8_t
+profile_scope_begin(uint8_t id)
+{
+  profile_record(id, PROFILE_TYPE_BEGIN);
+  return id;
 }
 /*---------------------------------------------------------------------------*/
 void
-profile_episode_start(void)
+profile_scope_end(uint8_t *id)
 {
-  struct timetable_timestamp *e;
-  timetable_clear(&profile_begin_timetable);
-  timetable_clear(&profile_end_timetable);
-  episode_start_time = clock_time();
-  
-  e = timetable_entry(&profile_begin_timetable,
-		      PROFILE_TIMETABLE_SIZE - 1);
-  if(e != NULL) {
-    e->id = NULL;
+  profile_record(*id, PROFILE_TYPE_END);
+}
+#endif /* __GNUC__ */
+/*---------------------------------------------------------------------------*/
+static void
+add(struct profile_stats *st, rtimer_clock_t d)
+{
+  rtimer_clock_t v;
+  int bin;
+
+  if(st->count == 0 || d < st->min) {
+    st->min = d;
   }
-  e = timetable_entry(&profile_end_timetable,
-		      PROFILE_TIMETABLE_SIZE - 1);
-  if(e != NULL) {
-    e->id = NULL;
+  if(st->count == 0 || d > st->max) {
+    st->max = d;
+  }
+  st->count++;
+  st->sum += d;
+  for(bin = 0, v = d; v != 0 && bin < PROFILE_HIST_BINS - 1; v >>= 1) {
+    bin++;
+  }
+  if(st->hist[bin] != 0xffff) {
+    st->hist[bin]++;
   }
 }
 /*---------------------------------------------------------------------------*/
 void
-profile_episode_end(void)
+profile_aggregate(void)
 {
-  struct timetable_timestamp *e;
-  rtimer_clock_t episode_end_time = clock_time();
-
-/*   printf("timetable_episode_end start %u, end %u, max time %u\n", episode_start_time, episode_end_time, 65536/FINE_TICKS_PER_COARSE_TICK); */
-  e = timetable_entry(&profile_begin_timetable,
-		      PROFILE_TIMETABLE_SIZE - 1);
-  if(e != NULL && e->id != NULL) {
-    /* Invalid episode because of list overflow. */
-    invalid_episode_overflow++;
-    max_queuelen = PROFILE_TIMETABLE_SIZE;
-  } else if(episode_end_time - episode_start_time >
-	    65536/XXX_HACK_FINE_TICKS_PER_COARSE_TICK) {
-    /* Invalid episode because of timer overflow. */
-    invalid_episode_toolong++;
-  } else {
-    /* Compute aggregates. */
-    if(timetable_ptr(&profile_begin_timetable) > max_queuelen) {
-      max_queuelen = timetable_ptr(&profile_begin_timetable);
+  struct profile_marker *m;
+  rtimer_clock_t d;
+
+  while(ring_get != ring_put) {
+    m = &ring[ring_get & RING_MASK];
+    if(m->id < PROFILE_ID_MAX) {
+      if(m->type == PROFILE_TYPE_BEGIN) {
+        if(pending[m->id]) {
+          unpaired++;
+        }
+        pending[m->id] = 1;
+        begin_time[m->id] = m->time;
+      } else if(!pending[m->id]) {
+        unpaired++;
+      } else {
+        pending[m->id] = 0;
+        d = m->time - begin_time[m->id];
+        add(&stats[m->id], d > marker_time ? d - marker_time : 0);
+      }
     }
-    /*    timetable_aggregates_compute();*/
+    ring_get++;
   }
 }
 /*---------------------------------------------------------------------------*/
-/*
- *
- * Find a specific aggregate ID in the list of aggregates.
- *
- */
-static struct timetable_aggregate_entry *
-find_aggregate(struct timetable_aggregate *a,
-	       const char *id)
+const struct profile_stats *
+profile_stats(uint8_t id)
 {
-  int i;
-  for(i = 0; i < a->ptr; ++i) {
-    if(a->entries[i].id == id) {
-      return &a->entries[i];
-    }
-  }
-  if(i == a->size) {
+  if(id >= PROFILE_ID_MAX) {
     return NULL;
   }
-  a->entries[a->ptr].id = NULL;
-  return &a->entries[a->ptr++];
+  return &stats[id];
 }
 /*---------------------------------------------------------------------------*/
 void
-profile_aggregate_print_detailed(void)
+profile_reset(void)
+{
+  int s;
+
+  LOCK(s);
+  ring_get = ring_put;
+  UNLOCK(s);
+  memset(stats, 0, sizeof(stats));
+  memset(pending, 0, sizeof(pending));
+  dropped = unpaired = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put(uint8_t *p, unsigned long v, int bytes)
 {
+  while(bytes-- > 0) {
+    *p++ = v & 0xff;
+    v >>= 8;
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static int
+section_len(const struct profile_stats *st)
+{
+  int i, len;
+
+  len = SECTION_LEN;
+  for(i = 0; i < PROFILE_HIST_BINS; i++) {
+    if(st->hist[i] != 0) {
+      len += 2;
+    }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+dump_header(uint8_t *p)
+{
+  *p++ = PROFILE_DUMP_VERSION;
+  *p++ = PROFILE_HIST_BINS;
+  p = put(p, PROFILE_SECOND, 4);
+  p = put(p, dropped, 2);
+  return put(p, unpaired, 2);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+dump_section(uint8_t *p, uint8_t id)
+{
+  const struct profile_stats *st = &stats[id];
+  unsigned short bins;
   int i;
-  struct timetable_aggregate *a = &profile_aggregate;
-  
-  /*  printf("timetable_aggregate_print_detailed: a ptr %d\n", a->ptr);*/
-  for(i = 0; i < a->ptr; ++i) {
-    printf("-- %s: %lu / %u = %lu\n", a->entries[i].id,
-	   a->entries[i].time,
-	   a->entries[i].episodes,
-	   a->entries[i].time / a->entries[i].episodes);
+
+  bins = 0;
+  for(i = 0; i < PROFILE_HIST_BINS; i++) {
+    if(st->hist[i] != 0) {
+      bins |= 1 << i;
+    }
   }
-  
-  printf("Memory for entries: %d * %d = %d\n",
-	 (int)sizeof(struct timetable_aggregate), a->ptr,
-	 (int)sizeof(struct timetable_aggregate) * a->ptr);
+  *p++ = id;
+  p = put(p, st->count, 4);
+  p = put(p, st->min, 2);
+  p = put(p, st->max, 2);
+  p = put(p, st->sum, 4);
+  p = put(p, bins, 2);
+  for(i = 0; i < PROFILE_HIST_BINS; i++) {
+    if(st->hist[i] != 0) {
+      p = put(p, st->hist[i], 2);
+    }
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+int
+profile_dump(uint8_t *buf, int len)
+{
+  uint8_t *p;
+  int id;
+
+  if(len < HEADER_LEN) {
+    return 0;
+  }
+  p = dump_header(buf);
+  for(id = 0; id < PROFILE_ID_MAX; id++) {
+    if(stats[id].count != 0 && section_len(&stats[id]) <= len - (p - buf)) {
+      p = dump_section(p, id);
+    }
+  }
+  return p - buf;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_hex(const uint8_t *buf, const uint8_t *end)
+{
+  printf("P ");
+  while(buf < end) {
+    printf("%02x", *buf++);
+  }
+  printf("\n");
 }
 /*---------------------------------------------------------------------------*/
 void
-profile_aggregate_compute_detailed(void)
+profile_print(void)
 {
-  int i;
-  int last;
-  rtimer_clock_t t;
-  struct timetable_aggregate *a = &profile_aggregate;
-  struct timetable *timetable = &profile_timetable;
-  struct timetable_aggregate_entry *entry;
-
-  last = timetable_ptr(&profile_begin_timetable);
-  t = profile_begin_timetable.timestamps[0].time;
-  for(i = 0; i < last; ++i) {
-
-    entry = find_aggregate(a, profile_begin_timetable.timestamps[i].id);
-    if(entry == NULL) {
-      /* The list is full, skip this entry */
-      /*      printf("detailed_timetable_aggregate_compute: list full\n");*/
-    } else if(entry->id == NULL) {
-      /* The id was found in the list, so we add it. */
-      entry->id = timetable->timestamps[i - 1].id;
-      entry->time = (unsigned long)(timetable->timestamps[i].time - t -
-				    timetable_timestamp_time);
-      entry->episodes = 1;
-      /*      printf("New entry %s %lu\n", entry->id, entry->time);*/
-    } else {
-      entry->time += (unsigned long)(timetable->timestamps[i].time - t -
-				     timetable_timestamp_time);
-				     entry->episodes++;
+  /* The header, then a section per line to keep the lines short */
+  static uint8_t buf[SECTION_LEN + 2 * PROFILE_HIST_BINS];
+  int id;
+
+  print_hex(buf, dump_header(buf));
+  for(id = 0; id < PROFILE_ID_MAX; id++) {
+    if(stats[id].count != 0) {
+      print_hex(buf, dump_section(buf, id));
     }
-    t = timetable->timestamps[i].time;
-    /*    printf("a ptr %d\n", a->ptr);*/
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if PROFILE_CONF_ACTIVE
+/* Aggregate often enough for the ring not to fill, print seldom */
+PROCESS_THREAD(profile_process, ev, data)
+{
+  static struct etimer et;
+  static int seconds;
 
+  PROCESS_BEGIN();
+
+  etimer_set(&et, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_reset(&et);
+    profile_aggregate();
+    if(++seconds >= PROFILE_PRINT_PERIOD) {
+      seconds = 0;
+      profile_print();
+    }
   }
 
+  PROCESS_END();
+}
+#endif /* PROFILE_CONF_ACTIVE */
+/*---------------------------------------------------------------------------*/
+void
+profile_init(void)
+{
+  /* Measure the time taken by a pair of markers, as
+     timetable_init() does for timestamps */
+  marker_time = 0;
+  profile_reset();
+  profile_record(PROFILE_ID_EPISODE, PROFILE_TYPE_BEGIN);
+  profile_record(PROFILE_ID_EPISODE, PROFILE_TYPE_END);
+  profile_aggregate();
+  marker_time = stats[PROFILE_ID_EPISODE].min;
+  profile_reset();
+#if PROFILE_CONF_ACTIVE
+  process_start(&profile_process, NULL);
+#endif /* PROFILE_CONF_ACTIVE */
+}
+/*---------------------------------------------------------------------------*/
+void
+profile_episode_start(void)
+{
+  PROFILE_BEGIN(EPISODE);
+}
+/*---------------------------------------------------------------------------*/
+void
+profile_episode_end(void)
+{
+  PROFILE_END(EPISODE);
+  profile_aggregate();
+}
+/*---------------------------------------------------------------------------*/
+#else /* PROFILE_CONF_ON */
+/*---------------------------------------------------------------------------*/
+void
+profile_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+profile_episode_start(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+profile_episode_end(void)
+{
 }
 /*---------------------------------------------------------------------------*/
+#endif /* PROFILE_CONF_ON */
@@ -35,53 +35,168 @@
  *         Header file for the Contiki profiling system
  * \author
  *         Adam Dunkels <adam@sics.se>
+ *
+ *         Code sections are delimited by PROFILE_BEGIN() and
+ *         PROFILE_END() markers, or by a PROFILE_SCOPE() declaration,
+ *         placed after the other declarations of a block, that ends
+ *         the section wherever the block is left.
+ *         The identifiers of the sections are listed in
+ *         sys/profile-ids.h. A marker stores the identifier and a
+ *         timestamp in a ring buffer, which costs a few instructions
+ *         and can be done from interrupts. profile_aggregate() pairs
+ *         the markers and keeps the number of runs, the minimum,
+ *         average and maximum duration and a histogram of durations
+ *         per section. The markers compile to nothing unless
+ *         PROFILE_CONF_ON is set.
  */
 
 #ifndef __PROFILE_H__
 #define __PROFILE_H__
 
-/* XXX: the profiling code is under development and may not work at
-   present. */
+#include "contiki-conf.h"
+#include "sys/profile-ids.h"
+
+#ifndef PROFILE_CONF_ON
+#define PROFILE_CONF_ON 0
+#endif
+
+#if PROFILE_CONF_ON
+
+#include "sys/cc.h"
+#include "sys/rtimer.h"
 
-#define TIMETABLE_WITH_TYPE 1
-#include "sys/timetable.h"
+/* Timestamps are taken from the rtimer clock unless the platform
+   has a faster counter, such as a cycle counter. Durations are
+   computed modulo the width of rtimer_clock_t. */
+#ifdef PROFILE_CONF_NOW
+#define PROFILE_NOW() PROFILE_CONF_NOW()
+#define PROFILE_SECOND PROFILE_CONF_SECOND
+#else
+#define PROFILE_NOW() RTIMER_NOW()
+#define PROFILE_SECOND RTIMER_SECOND
+#endif
+
+/* Number of markers buffered between two calls to
+   profile_aggregate(), a power of two */
+#ifdef PROFILE_CONF_RING_SIZE
+#define PROFILE_RING_SIZE PROFILE_CONF_RING_SIZE
+#else
+#define PROFILE_RING_SIZE 64
+#endif
 
-#ifdef PROFILE_CONF_TIMETABLE_SIZE
-#define PROFILE_TIMETABLE_SIZE PROFILE_CONF_TIMETABLE_SIZE
+/* Bin n of the histogram counts the durations of n bits: 0, 1,
+   2-3, 4-7, ... The last bin counts all longer ones. */
+#ifdef PROFILE_CONF_HIST_BINS
+#define PROFILE_HIST_BINS PROFILE_CONF_HIST_BINS
 #else
-#define PROFILE_TIMETABLE_SIZE 128
+#define PROFILE_HIST_BINS 16
+#endif
+
+/* With PROFILE_CONF_ACTIVE, profile_process aggregates the markers
+   every second and prints the profile every PROFILE_PRINT_PERIOD
+   seconds. Code that does not return to the main loop for long, such
+   as a MAC that listens without end, then needs not do it itself. */
+#ifndef PROFILE_CONF_ACTIVE
+#define PROFILE_CONF_ACTIVE 0
 #endif
 
-#ifdef PROFILE_CONF_AGGREGATE_SIZE
-#define PROFILE_AGGREGATE_SIZE PROFILE_CONF_AGGREGATE_SIZE
+#ifdef PROFILE_CONF_PRINT_PERIOD
+#define PROFILE_PRINT_PERIOD PROFILE_CONF_PRINT_PERIOD
 #else
-#define PROFILE_AGGREGATE_SIZE 128
+#define PROFILE_PRINT_PERIOD 60
 #endif
 
-#define PROFILE_BEGIN(id) TIMETABLE_TIMESTAMP_TYPE(profile_timetable, id, 1)
-#define PROFILE_END(id) TIMETABLE_TIMESTAMP_TYPE(profile_timetable, id, 2)
+#if PROFILE_CONF_ACTIVE
+#include "sys/process.h"
+PROCESS_NAME(profile_process);
+#endif /* PROFILE_CONF_ACTIVE */
+
+#define PROFILE_TYPE_BEGIN 1
+#define PROFILE_TYPE_END   2
+
+struct profile_stats {
+  unsigned long count;
+  unsigned long sum;
+  rtimer_clock_t min, max;
+  unsigned short hist[PROFILE_HIST_BINS];
+};
+
+void profile_record(uint8_t id, uint8_t type);
+
+#define PROFILE_BEGIN(id) profile_record(PROFILE_ID_##id, PROFILE_TYPE_BEGIN)
+#define PROFILE_END(id) profile_record(PROFILE_ID_##id, PROFILE_TYPE_END)
+
+#ifdef __GNUC__
+uint8_t profile_scope_begin(uint8_t id);
+void profile_scope_end(uint8_t *id);
+#define PROFILE_SCOPE(id)                                               \
+  uint8_t CC_CONCAT(profile_scope_, __LINE__)                           \
+  __attribute__((cleanup(profile_scope_end), unused)) =                 \
+    profile_scope_begin(PROFILE_ID_##id)
+#else /* __GNUC__ */
+/* Without GCC's cleanup attribute, sections are delimited with
+   PROFILE_BEGIN() and PROFILE_END() */
+#define PROFILE_SCOPE(id)
+#endif /* __GNUC__ */
+
+/**
+ * \brief      Move the buffered markers into the statistics
+ *
+ *             Called from the main loop, not from interrupts. The
+ *             platform main loops call it at the end of every
+ *             episode of process_run().
+ */
+void profile_aggregate(void);
+
+/**
+ * \brief      Get the statistics of a code section
+ * \param id   The PROFILE_ID_ of the section
+ * \return     The statistics, with durations in PROFILE_SECOND units
+ *             and without the time taken by the markers
+ */
+const struct profile_stats *profile_stats(uint8_t id);
+
+/**
+ * \brief      Write the statistics in the binary dump format
+ * \param buf  The buffer
+ * \param len  The size of the buffer
+ * \return     The number of bytes written
+ *
+ *             The dump is a header (version, number of bins, ticks
+ *             per second, markers dropped because the ring was full,
+ *             unpaired markers) followed by a record per section that
+ *             has run (identifier, count, minimum, maximum, sum, a
+ *             bitmap of the non-empty bins and their counts). All
+ *             fields are little endian. Sections that do not fit in
+ *             the buffer are left out.
+ */
+int profile_dump(uint8_t *buf, int len);
+
+/**
+ * \brief      Print the dump as "P <hex>" lines, read by
+ *             tools/profile-report
+ *
+ *             Printing takes long: profile_process calls it with
+ *             PROFILE_CONF_ACTIVE, at a low rate.
+ */
+void profile_print(void);
 
-/*#define PROFILE_COND_BEGIN(cond, id) TIMETABLE_COND_TIMESTAMP(profile_begin_timetable, \
-								  cond, id)
-#define PROFILE_COND_END(cond, id) TIMETABLE_COND_TIMESTAMP(profile_end_timetable, \
-								  cond, id)
-*/
+void profile_reset(void);
 
-#define profile_begin_timetable_size PROFILE_TIMETABLE_SIZE
-TIMETABLE_DECLARE(profile_begin_timetable);
-#define profile_end_timetable_size PROFILE_TIMETABLE_SIZE
-TIMETABLE_DECLARE(profile_end_timetable);
+#else /* PROFILE_CONF_ON */
 
-#define profile_timetable_size PROFILE_TIMETABLE_SIZE
-TIMETABLE_DECLARE(profile_timetable);
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+#define PROFILE_SCOPE(id)
+
+#define profile_aggregate()
+#define profile_print()
+
+#endif /* PROFILE_CONF_ON */
 
 void profile_init(void);
 
 void profile_episode_start(void);
 void profile_episode_end(void);
 
-void profile_aggregate_print_detailed(void);
-void profile_aggregate_compute_detailed(void);
-
-
 #endif /* __PROFILE_H__ */
@@ -56,53 +56,172 @@
 #define PRINTF(...)
 #endif
 
-static struct rtimer *next_rtimer;
+/*
+ * Pending tasks, sorted by time and, for the same time, by priority.
+ * The hardware timer is always set for the first one. The queue length
+ * is bounded so that rtimer_set() and the timer interrupt take a
+ * bounded time.
+ */
+static struct rtimer *queue;
+static char running;
+
+#ifdef RTIMER_CONF_QUEUE_SIZE
+#define QUEUE_SIZE RTIMER_CONF_QUEUE_SIZE
+#else
+#define QUEUE_SIZE 8
+#endif
+
+/* The timer is never set closer to now than this many ticks: it could
+   pass before the timer is set, and only fire after a wrap. A task due
+   sooner runs that much late, never early. */
+#ifdef RTIMER_CONF_MIN_DELAY
+#define MIN_DELAY RTIMER_CONF_MIN_DELAY
+#else
+#define MIN_DELAY 4
+#endif
+
+/* Platforms where rtimer_run_next() runs in an interrupt mask it while
+   the queue is changed. The others run it from the main loop. */
+#ifdef RTIMER_ARCH_LOCK
+#define LOCK(s)   (s) = RTIMER_ARCH_LOCK()
+#define UNLOCK(s) RTIMER_ARCH_UNLOCK(s)
+#else
+#define LOCK(s)   (s) = 0
+#define UNLOCK(s) (void)(s)
+#endif
 
+#define BEFORE(a, b) (RTIMER_CLOCK_LT((a)->time, (b)->time) || \
+                      ((a)->time == (b)->time && (a)->priority > (b)->priority))
+#define DUE(t, now)  (!RTIMER_CLOCK_LT((now), (t)->time))
+
+/*---------------------------------------------------------------------------*/
+/* Set the timer for the first task */
+static void
+schedule_first(void)
+{
+  rtimer_clock_t now;
+
+  now = RTIMER_NOW();
+  if(RTIMER_CLOCK_LT(queue->time, now + MIN_DELAY)) {
+    rtimer_arch_schedule(now + MIN_DELAY);
+  } else {
+    rtimer_arch_schedule(queue->time);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 rtimer_init(void)
 {
+  queue = NULL;
+  running = 0;
   rtimer_arch_init();
 }
 /*---------------------------------------------------------------------------*/
 int
-rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
-	   rtimer_clock_t duration,
-	   rtimer_callback_t func, void *ptr)
+rtimer_set_priority(struct rtimer *rtimer, rtimer_clock_t time,
+                    unsigned char priority,
+                    rtimer_callback_t func, void *ptr)
 {
-  int first = 0;
+  struct rtimer **tp, **at, *first;
+  int n, s;
+
+  PRINTF("rtimer_set time %d priority %d\n", time, priority);
 
-  PRINTF("rtimer_set time %d\n", time);
+  LOCK(s);
+  first = queue;
 
-  if(next_rtimer == NULL) {
-    first = 1;
+  /* A task that is set again moves to its new place */
+  for(tp = &queue; *tp != NULL; tp = &(*tp)->next) {
+    if(*tp == rtimer) {
+      *tp = rtimer->next;
+      break;
+    }
   }
 
   rtimer->func = func;
   rtimer->ptr = ptr;
-
   rtimer->time = time;
-  next_rtimer = rtimer;
+  rtimer->priority = priority;
+
+  at = NULL;
+  n = 0;
+  for(tp = &queue; *tp != NULL; tp = &(*tp)->next) {
+    if(at == NULL && BEFORE(rtimer, *tp)) {
+      at = tp;
+    }
+    n++;
+  }
+  if(n >= QUEUE_SIZE) {
+    UNLOCK(s);
+    return RTIMER_ERR_FULL;
+  }
+  if(at == NULL) {
+    at = tp;
+  }
+  rtimer->next = *at;
+  *at = rtimer;
 
-  if(first == 1) {
-    rtimer_arch_schedule(time);
+  /* rtimer_run_next() sets the timer itself when it is done */
+  if((queue != first || queue == rtimer) && !running) {
+    schedule_first();
   }
+  UNLOCK(s);
   return RTIMER_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
+	   rtimer_clock_t duration,
+	   rtimer_callback_t func, void *ptr)
+{
+  return rtimer_set_priority(rtimer, time, RTIMER_PRIORITY_NORMAL, func, ptr);
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_run_next(void)
 {
-  struct rtimer *t;
-  if(next_rtimer == NULL) {
+  struct rtimer **tp, **best, *t;
+  rtimer_clock_t now;
+  int n;
+
+  if(queue == NULL) {
     return;
   }
-  t = next_rtimer;
-  next_rtimer = NULL;
-  t->func(t, t->ptr);
-  if(next_rtimer != NULL) {
-    rtimer_arch_schedule(next_rtimer->time);
+  running = 1;
+  /* Of the tasks that are due, the one with the highest priority runs
+     first */
+  for(n = 0; n < QUEUE_SIZE && queue != NULL; n++) {
+    now = RTIMER_NOW();
+    if(!DUE(queue, now)) {
+      break;
+    }
+    best = &queue;
+    for(tp = &queue->next; *tp != NULL && DUE(*tp, now); tp = &(*tp)->next) {
+      if((*tp)->priority > (*best)->priority) {
+        best = tp;
+      }
+    }
+    t = *best;
+    *best = t->next;
+    t->next = NULL;
+    t->func(t, t->ptr);
+  }
+  running = 0;
+  if(queue != NULL) {
+    schedule_first();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_next_time(rtimer_clock_t *t)
+{
+  struct rtimer *next;
+
+  next = queue;
+  if(next == NULL) {
+    return 0;
   }
-  return;
+  *t = next->time;
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
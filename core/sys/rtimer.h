@@ -84,6 +84,18 @@ struct rtimer {
   rtimer_clock_t time;
   rtimer_callback_t func;
   void *ptr;
+  struct rtimer *next;
+  unsigned char priority;
+};
+
+/**
+ * Priorities of real-time tasks. When several tasks are due at the
+ * same time, the one with the highest priority runs first.
+ */
+enum {
+  RTIMER_PRIORITY_LOW,
+  RTIMER_PRIORITY_NORMAL,
+  RTIMER_PRIORITY_HIGH,
 };
 
 enum {
@@ -104,12 +116,37 @@ enum {
  *             (false) if the task could not be scheduled.
  *
  *             This function schedules a real-time task at a specified
- *             time in the future.
+ *             time in the future, with RTIMER_PRIORITY_NORMAL.
+ *             Several tasks can be pending at the same time, up to
+ *             RTIMER_CONF_QUEUE_SIZE (8 by default). Setting a task
+ *             that is pending moves it to the new time.
  *
  */
 int rtimer_set(struct rtimer *task, rtimer_clock_t time,
 	       rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
 
+/**
+ * \brief      Post a real-time task with a priority.
+ * \param task A pointer to the task variable previously declared with RTIMER_TASK().
+ * \param time The time when the task is to be executed.
+ * \param priority RTIMER_PRIORITY_LOW, RTIMER_PRIORITY_NORMAL or RTIMER_PRIORITY_HIGH
+ * \param func A function to be called when the task is executed.
+ * \param ptr An opaque pointer that will be supplied as an argument to the callback function.
+ * \return     RTIMER_OK if the task could be scheduled, RTIMER_ERR_FULL
+ *             if too many tasks are pending.
+ *
+ *             As rtimer_set(). When several tasks are due, for
+ *             instance a MAC schedule and sensor sampling, the one
+ *             with the highest priority runs first. A task never runs
+ *             before its time. A time that has passed, or that is
+ *             closer than RTIMER_CONF_MIN_DELAY ticks (4 by default),
+ *             runs that many ticks from now.
+ *
+ */
+int rtimer_set_priority(struct rtimer *task, rtimer_clock_t time,
+                        unsigned char priority,
+                        rtimer_callback_t func, void *ptr);
+
 /**
  * \brief      Execute the next real-time task and schedule the next task, if any
  *
@@ -119,6 +156,17 @@ int rtimer_set(struct rtimer *task, rtimer_clock_t time,
  */
 void rtimer_run_next(void);
 
+/**
+ * \brief      Get the time of the next real-time task
+ * \param t    Set to the time of the next task, if any
+ * \return     Non-zero (true) if a task is pending, zero (false) otherwise
+ *
+ *             This function is used by the idle loop to find out
+ *             how long the system can sleep.
+ *
+ */
+int rtimer_next_time(rtimer_clock_t *t);
+
 /**
  * \brief      Get the current clock time
  * \return     The current time
@@ -0,0 +1,130 @@
+/**
+ * \addtogroup stack-check
+ * @{
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Implementation of the stack usage check
+ */
+
+#include "sys/stack-check.h"
+
+#if STACK_CHECK_CONF_ON
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef STACK_CHECK_CONF_FILL
+#define STACK_CHECK_CONF_FILL 0xa5
+#endif
+
+/* Bytes left unfilled below the frame of stack_check_init(), which
+   is in use while the stack is filled */
+#ifndef STACK_CHECK_CONF_MARGIN
+#define STACK_CHECK_CONF_MARGIN 32
+#endif
+
+#if defined(__MSP430__) && defined(__GNUC__)
+/* The stack starts at the top of RAM and grows down towards the heap,
+   which sbrk() in msp430.c grows from the end of .bss. */
+extern uint8_t __stack;
+void *sbrk(int incr);
+#define STACK_TOP(frame)     (&__stack)
+#define STACK_BOTTOM(top)    ((uint8_t *)sbrk(0))
+#else
+/* The bounds of the host stack are unknown: check a region of the
+   configured size below the caller of stack_check_init() */
+#ifndef STACK_CHECK_CONF_SIZE
+#define STACK_CHECK_CONF_SIZE 4096
+#endif
+#define STACK_TOP(frame)     ((uint8_t *)(uintptr_t)(frame))
+#define STACK_BOTTOM(top)    ((top) - STACK_CHECK_CONF_SIZE)
+#endif
+
+static uint8_t *top;
+static uint8_t *bottom;
+/*---------------------------------------------------------------------------*/
+void
+stack_check_init(void)
+{
+  uint8_t frame;
+  volatile uint8_t *p;
+  uint8_t *end;
+
+  top = STACK_TOP(&frame);
+  bottom = STACK_BOTTOM(top);
+  end = &frame - STACK_CHECK_CONF_MARGIN;
+
+  for(p = bottom; p < end; p++) {
+    *p = STACK_CHECK_CONF_FILL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+stack_check_usage(void)
+{
+  const volatile uint8_t *p;
+
+  p = bottom;
+#if defined(__MSP430__) && defined(__GNUC__)
+  /* Skip memory that the heap has taken since the stack was filled */
+  if(STACK_BOTTOM(top) > bottom) {
+    p = STACK_BOTTOM(top);
+  }
+#endif
+  while(p < top && *p == STACK_CHECK_CONF_FILL) {
+    p++;
+  }
+  return top - (const uint8_t *)p;
+}
+/*---------------------------------------------------------------------------*/
+int
+stack_check_size(void)
+{
+  return top - bottom;
+}
+/*---------------------------------------------------------------------------*/
+void
+stack_check_print(void)
+{
+  printf("S %d %d\n", stack_check_usage(), stack_check_size());
+}
+/*---------------------------------------------------------------------------*/
+#endif /* STACK_CHECK_CONF_ON */
+
+/** @} */
@@ -0,0 +1,114 @@
+/**
+ * \addtogroup sys
+ * @{
+ */
+
+/**
+ * \defgroup stack-check Stack usage check
+ * @{
+ *
+ * Measures the peak usage of the main stack. stack_check_init()
+ * fills the unused part of the stack with a known byte, and
+ * stack_check_usage() finds the deepest byte that has been
+ * overwritten since. The stacks of mt threads are watermarked by
+ * mt_start(), see mt_stack_usage().
+ *
+ */
+
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the stack usage check
+ */
+
+#ifndef __STACK_CHECK_H__
+#define __STACK_CHECK_H__
+
+#include "contiki-conf.h"
+
+#ifndef STACK_CHECK_CONF_ON
+#define STACK_CHECK_CONF_ON 0
+#endif
+
+#if STACK_CHECK_CONF_ON
+
+/**
+ * \brief      Fill the unused part of the main stack
+ *
+ *             Call early from main(), before the processes are
+ *             started. On the MSP430 the stack is filled from the
+ *             heap break up to the current stack pointer and usage is
+ *             counted from the top of RAM. Elsewhere the
+ *             STACK_CHECK_CONF_SIZE bytes below the caller are
+ *             filled and usage is counted from the caller's frame.
+ */
+void stack_check_init(void);
+
+/**
+ * \brief      Get the peak usage of the main stack
+ * \return     The number of bytes used since stack_check_init()
+ *
+ *             Equal to stack_check_size() when the stack has grown
+ *             past the checked region, which on the MSP430 means that
+ *             it has reached the heap or the static data.
+ */
+int stack_check_usage(void);
+
+/**
+ * \brief      Get the size of the checked stack in bytes
+ */
+int stack_check_size(void);
+
+/**
+ * \brief      Print the usage and size of the main stack
+ *
+ *             Prints a "S <used> <size>" line.
+ */
+void stack_check_print(void);
+
+#else /* STACK_CHECK_CONF_ON */
+
+#define stack_check_init()
+#define stack_check_usage() (-1)
+#define stack_check_size() (-1)
+#define stack_check_print()
+
+#endif /* STACK_CHECK_CONF_ON */
+
+#endif /* __STACK_CHECK_H__ */
+
+/** @} */
+/** @} */
@@ -1,6 +1,7 @@
 #include "rtimer-arch.h"
 #include <AT91SAM7S64.h>
 #include "rtimer-arch-interrupt.h"
+#include "interrupt-utils.h"
 
 #define DEBUG 1
 #if DEBUG
@@ -29,6 +30,18 @@ rtimer_arch_init(void)
   PRINTF("rtimer_arch_init: Done\n");
 }
 
+int
+rtimer_arch_lock(void)
+{
+  return disableIRQ();
+}
+
+void
+rtimer_arch_unlock(int s)
+{
+  restoreIRQ(s);
+}
+
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
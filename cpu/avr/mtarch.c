@@ -222,14 +222,20 @@ mtarch_stop(struct mtarch_thread *t)
 }
 /*--------------------------------------------------------------------------*/
 int
-mtarch_stack_usage(struct mt_thread *t)
+mtarch_stack_usage(struct mtarch_thread *t)
 {
-  uint8_t i;
+  int i;
   for(i = 0; i < MTARCH_STACKSIZE; ++i) {
-    if(t->thread.stack[i] != i) {
-      break;
+    if(t->stack[i] != (unsigned char)i) {
+      return MTARCH_STACKSIZE - i;
     }
   }
-  return MTARCH_STACKSIZE - i;
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+int
+mtarch_stack_size(struct mtarch_thread *t)
+{
+  return sizeof(t->stack);
 }
 /*--------------------------------------------------------------------------*/
@@ -50,10 +50,16 @@
 #define MTARCH_STACKSIZE 128
 #endif
 
+/* mtarch_start() fills the stack with its byte indices */
+#define MTARCH_STACK_CHECK 1
+
 struct mtarch_thread {
   unsigned char stack[MTARCH_STACKSIZE];  
   unsigned char *sp;
 };
 
+int mtarch_stack_usage(struct mtarch_thread *t);
+int mtarch_stack_size(struct mtarch_thread *t);
+
 #endif /* __MTARCH_H__ */
 	
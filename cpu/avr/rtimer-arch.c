@@ -194,6 +194,22 @@ rtimer_arch_init(void)
 #endif /* RTIMER_ARCH_PRESCALER */
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  int s;
+
+  s = SREG;
+  cli();
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  SREG = s;
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
@@ -89,6 +89,22 @@ rtimer_arch_init(void)
   PRINTF("done\n");
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  int s;
+
+  s = EA;
+  EA = 0;
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  EA = s;
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
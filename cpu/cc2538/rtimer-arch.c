@@ -62,6 +62,28 @@ rtimer_arch_init(void)
   return;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Mask the rtimer interrupt while the rtimer queue is changed
+ * \return The state to restore with rtimer_arch_unlock()
+ */
+int
+rtimer_arch_lock(void)
+{
+  /* The previous PRIMASK: non-zero if interrupts were disabled */
+  return cpu_cpsid();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Restore the state that rtimer_arch_lock() returned
+ */
+void
+rtimer_arch_unlock(int s)
+{
+  if(!s) {
+    cpu_cpsie();
+  }
+}
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Schedules an rtimer task to be triggered at time t
  * \param t The time when the task will need executed. This is an absolute
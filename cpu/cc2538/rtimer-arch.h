@@ -74,6 +74,12 @@ rtimer_clock_t rtimer_arch_now(void);
  */
 rtimer_clock_t rtimer_arch_next_trigger(void);
 
+/* Keep the rtimer interrupt out while the rtimer queue is changed */
+int rtimer_arch_lock(void);
+void rtimer_arch_unlock(int s);
+#define RTIMER_ARCH_LOCK()      rtimer_arch_lock()
+#define RTIMER_ARCH_UNLOCK(s)   rtimer_arch_unlock(s)
+
 #endif /* RTIMER_ARCH_H_ */
 
 /**
@@ -81,6 +81,22 @@ rtimer_arch_init(void)
   T1IE = 1;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  int s;
+
+  s = EA;
+  EA = 0;
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  EA = s;
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
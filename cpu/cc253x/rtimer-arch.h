@@ -57,4 +57,10 @@
 
 void rtimer_isr(void) __interrupt(T1_VECTOR);
 
+/* Keep the rtimer interrupt out while the rtimer queue is changed */
+int rtimer_arch_lock(void);
+void rtimer_arch_unlock(int s);
+#define RTIMER_ARCH_LOCK()      rtimer_arch_lock()
+#define RTIMER_ARCH_UNLOCK(s)   rtimer_arch_unlock(s)
+
 #endif /* __RTIMER_ARCH_H__ */
@@ -94,6 +94,22 @@ rtimer_arch_init(void)
 	enable_irq(CRM);
 }
 
+int
+rtimer_arch_lock(void)
+{
+  int s;
+
+  s = *INTENABLE;
+  disable_irq(CRM);
+  return s;
+}
+
+void
+rtimer_arch_unlock(int s)
+{
+  *INTENABLE = s;
+}
+
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
@@ -40,28 +40,99 @@
 #include "sys/clock.h"
 #include "sys/etimer.h"
 #include "rtimer-arch.h"
+#include "msp430def.h"
 
 #define INTERVAL (RTIMER_ARCH_SECOND / CLOCK_SECOND)
 
 #define MAX_TICKS (~((clock_time_t)0) / 2)
 
+/* Longest tickless sleep: TAR must not wrap around from one counted
+   tick to the next */
+#define MAX_SLEEP (0x8000 / INTERVAL - 1)
+
 static volatile unsigned long seconds;
 
 static volatile clock_time_t count = 0;
-/* last_tar is used for calculating clock_fine, last_ccr might be better? */
-static unsigned short last_tar = 0;
+/* TAR at the last counted tick, used for counting ticks and for
+   calculating clock_fine */
+static volatile unsigned short last_tar = 0;
+/* Set while the periodic interrupt is suppressed */
+static volatile char tickless;
+/*---------------------------------------------------------------------------*/
+static unsigned short
+read_tar(void)
+{
+  unsigned short t1, t2;
+  do {
+    t1 = TAR;
+    t2 = TAR;
+  } while(t1 != t2);
+  return t1;
+}
+/*---------------------------------------------------------------------------*/
+/* Count the ticks that have passed since the last one. Called with
+   interrupts disabled. */
+static void
+update_ticks(void)
+{
+  while((unsigned short)(read_tar() - last_tar) >= INTERVAL) {
+    last_tar += INTERVAL;
+    ++count;
+
+    /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
+       that the modulo operation below becomes a logical and and not
+       an expensive divide. Algorithm from Wikipedia:
+       http://en.wikipedia.org/wiki/Power_of_two */
+#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
+#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
+#error Change CLOCK_CONF_SECOND in contiki-conf.h.
+#endif
+    if(count % CLOCK_CONF_SECOND == 0) {
+      ++seconds;
+      energest_flush();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* During a tickless sleep, only interrupt handlers run: they see the
+   ticks that have passed as well */
+static void
+catch_up(void)
+{
+  int s;
+
+  if(tickless) {
+    s = splhigh();
+    update_ticks();
+    splx(s);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+poll_etimers(void)
+{
+  if(etimer_pending() &&
+     (etimer_next_expiration_time() - count - 1) > MAX_TICKS) {
+    etimer_request_poll();
+    return 1;
+  }
+  return 0;
+}
 /*---------------------------------------------------------------------------*/
 interrupt(TIMERA1_VECTOR) timera1 (void) {
   ENERGEST_ON(ENERGEST_TYPE_IRQ);
 
   if(TAIV == 2) {
-	  etimer_interrupt();
-	  if(etimer_pending() &&
-	     (etimer_next_expiration_time() - count - 1) > MAX_TICKS) {
-	    etimer_request_poll();
-	    LPM4_EXIT;
-	  }
-   }
+    etimer_interrupt();
+    if(tickless) {
+      /* The tickless sleep is over, the idle loop sets up the next one */
+      tickless = 0;
+      LPM4_EXIT;
+    }
+    if(poll_etimers()) {
+      LPM4_EXIT;
+    }
+  }
 
   ENERGEST_OFF(ENERGEST_TYPE_IRQ);
 }
@@ -71,35 +142,54 @@ void etimer_interrupt(void) {
  * Occurrs when timer state is toggled between STOP and CONT. */
 while(TACTL & MC1 && TACCR1 - TAR == 1);
 
-/* Make sure interrupt time is future */
-do {
-  /*      TACTL &= ~MC1;*/
-  TACCR1 += INTERVAL;
-  /*      TACTL |= MC1;*/
-  ++count;
-
-  /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
- that the modulo operation below becomes a logical and and not
- an expensive divide. Algorithm from Wikipedia:
- http://en.wikipedia.org/wiki/Power_of_two */
-#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
-#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
-#error Change CLOCK_CONF_SECOND in contiki-conf.h.
-#endif
-  if(count % CLOCK_CONF_SECOND == 0) {
-++seconds;
-	energest_flush();
-  }
-} while((TACCR1 - TAR) > INTERVAL);
+update_ticks();
 
-last_tar = TAR;
+/* The next tick is in the future */
+TACCR1 = last_tar + INTERVAL;
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_tickless_enter(clock_time_t ticks)
+{
+  clock_time_t now;
+
+  if(ticks > MAX_SLEEP) {
+    ticks = MAX_SLEEP;
+  }
+  /* The caller counted the ticks from the current clock_time(), ticks
+     that are still to be counted come off */
+  now = count;
+  update_ticks();
+  ticks -= count - now;
+  /* The next tick comes anyway */
+  if(ticks < 2 || ticks > MAX_TICKS) {
+    return;
+  }
+  TACCR1 = last_tar + ticks * INTERVAL;
+  TACCTL1 &= ~CCIFG;
+  tickless = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_tickless_exit(void)
+{
+  int s;
 
+  s = splhigh();
+  if(tickless) {
+    tickless = 0;
+    update_ticks();
+    TACCR1 = last_tar + INTERVAL;
+    poll_etimers();
+  }
+  splx(s);
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
 clock_time(void)
 {
   clock_time_t t1, t2;
+  catch_up();
   do {
     t1 = count;
     t2 = count;
@@ -112,6 +202,8 @@ clock_set(clock_time_t clock, clock_time_t fclock)
 {
   TAR = fclock;
   TACCR1 = fclock + INTERVAL;
+  last_tar = fclock;
+  tickless = 0;
   count = clock;
 }
 /*---------------------------------------------------------------------------*/
@@ -125,6 +217,7 @@ unsigned short
 clock_fine(void)
 {
   unsigned short t;
+  catch_up();
   /* Assign last_tar to local varible that can not be changed by interrupt */
   t = last_tar;
   /* perform calc based on t, TAR will not be changed during interrupt */
@@ -153,6 +246,8 @@ clock_init(void)
   TACTL |= MC1;
 
   count = 0;
+  last_tar = 0;
+  tickless = 0;
 
   /* Enable interrupts. */
   eint();
@@ -201,6 +296,7 @@ unsigned long
 clock_seconds(void)
 {
   unsigned long t1, t2;
+  catch_up();
   do {
     t1 = seconds;
     t2 = seconds;
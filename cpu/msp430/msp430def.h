@@ -71,6 +71,26 @@ spl_t   splhigh_(void);
 #define splhigh() splhigh_()
 #define splx(sr) __asm__ __volatile__("bis %0, r2" : : "r" (sr))
 
+/* process_poll() is called from interrupts: mask them while the
+   kernel's list of polled processes changes */
+#ifndef PROCESS_CONF_POLL_LOCK
+#define PROCESS_CONF_POLL_LOCK()      splhigh()
+#define PROCESS_CONF_POLL_UNLOCK(s)   splx(s)
+#endif
+
+/* Interrupt handlers turn energest types on and off: mask them while
+   a 64-bit total is read */
+#ifndef ENERGEST_CONF_LOCK
+#define ENERGEST_CONF_LOCK()          splhigh()
+#define ENERGEST_CONF_UNLOCK(s)       splx(s)
+#endif
+
+/* Profiling markers are stored from interrupts as well */
+#ifndef PROFILE_CONF_LOCK
+#define PROFILE_CONF_LOCK()           splhigh()
+#define PROFILE_CONF_UNLOCK(s)        splx(s)
+#endif
+
 /* Workaround for bug in msp430-gcc compiler */
 #if defined(__MSP430__) && defined(__GNUC__) && MSP430_MEMCPY_WORKAROUND
 #ifndef memcpy
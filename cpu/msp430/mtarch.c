@@ -162,16 +162,24 @@ mtarch_stop(struct mtarch_thread *thread)
 }
 /*--------------------------------------------------------------------------*/
 int
-mtarch_stack_usage(struct mt_thread *t)
+mtarch_stack_usage(struct mtarch_thread *t)
 {
   int i;
 
+  /* The stack grows downwards, so the first word that lost its index
+     is the deepest one ever written. */
   for(i = 0; i < MTARCH_STACKSIZE; ++i) {
-    if(t->thread.stack[i] != (unsigned short)i) {
-      return MTARCH_STACKSIZE - i;
+    if(t->stack[i] != (unsigned short)i) {
+      return (MTARCH_STACKSIZE - i) * sizeof(t->stack[0]);
     }
   }
 
-  return MTARCH_STACKSIZE;
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+int
+mtarch_stack_size(struct mtarch_thread *t)
+{
+  return sizeof(t->stack);
 }
 /*--------------------------------------------------------------------------*/
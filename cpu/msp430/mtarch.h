@@ -37,6 +37,9 @@
 #define MTARCH_STACKSIZE 128
 #endif /* MTARCH_STACKSIZE */
 
+/* mtarch_start() fills the stack with its word indices */
+#define MTARCH_STACK_CHECK 1
+
 struct mtarch_thread {
   unsigned short stack[MTARCH_STACKSIZE];
   unsigned short *sp;
@@ -44,8 +47,7 @@ struct mtarch_thread {
   void (* function)(void *);
 };
 
-struct mt_thread;
-
-int mtarch_stack_usage(struct mt_thread *t);
+int mtarch_stack_usage(struct mtarch_thread *t);
+int mtarch_stack_size(struct mtarch_thread *t);
 
 #endif /* __MTARCH_H__ */
@@ -42,6 +42,7 @@
 #define __RTIMER_ARCH_H__
 
 #include <legacymsp430.h>
+#include "msp430def.h"
 #include "sys/rtimer.h"
 
 #define RTIMER_ARCH_SECOND (32768U)
@@ -49,4 +50,8 @@
 #define rtimer_arch_now() (TAR)
 #define rtimer_arch_now_dco() (TBR)
 
+/* Keep the rtimer interrupt out while the rtimer queue is changed */
+#define RTIMER_ARCH_LOCK()      splhigh()
+#define RTIMER_ARCH_UNLOCK(s)   splx(s)
+
 #endif /* __RTIMER_ARCH_H__ */
@@ -38,6 +38,10 @@
 #define MTARCH_STACKSIZE 4096
 #endif /* MTARCH_STACKSIZE */
 
+#ifndef MTARCH_STACK_FILL
+#define MTARCH_STACK_FILL 0xa5
+#endif /* MTARCH_STACK_FILL */
+
 #if defined(_WIN32) || defined(__CYGWIN__)
 
 #define WIN32_LEAN_AND_MEAN
@@ -53,6 +57,7 @@ static void *main_fiber;
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <ucontext.h>
 
@@ -100,6 +105,9 @@ mtarch_start(struct mtarch_thread *thread,
 
   thread->mt_thread = malloc(sizeof(struct mtarch_t));
 
+  memset(((struct mtarch_t *)thread->mt_thread)->stack, MTARCH_STACK_FILL,
+	 sizeof(((struct mtarch_t *)thread->mt_thread)->stack));
+
   getcontext(&((struct mtarch_t *)thread->mt_thread)->context);
 
   ((struct mtarch_t *)thread->mt_thread)->context.uc_link = NULL;
@@ -183,3 +191,42 @@ mtarch_pstop(void)
 {
 }
 /*--------------------------------------------------------------------------*/
+int
+mtarch_stack_usage(struct mtarch_thread *thread)
+{
+#if defined(__linux)
+
+  const unsigned char *stack = 
+			(unsigned char *)((struct mtarch_t *)thread->mt_thread)->stack;
+  int i;
+
+  /* The stack grows downwards on all hosts we run on, so the first
+     byte that lost the fill value is the deepest one ever written. */
+  for(i = 0; i < MTARCH_STACKSIZE; ++i) {
+    if(stack[i] != MTARCH_STACK_FILL) {
+      return MTARCH_STACKSIZE - i;
+    }
+  }
+  return 0;
+
+#else /* __linux */
+
+  return -1;
+
+#endif /* __linux */
+}
+/*--------------------------------------------------------------------------*/
+int
+mtarch_stack_size(struct mtarch_thread *thread)
+{
+#if defined(__linux)
+
+  return MTARCH_STACKSIZE;
+
+#else /* __linux */
+
+  return -1;
+
+#endif /* __linux */
+}
+/*--------------------------------------------------------------------------*/
@@ -39,4 +39,10 @@ struct mtarch_thread {
   void *mt_thread;
 };
 
+/* mtarch_start() fills the ucontext stacks with MTARCH_STACK_FILL */
+#define MTARCH_STACK_CHECK 1
+
+int mtarch_stack_usage(struct mtarch_thread *thread);
+int mtarch_stack_size(struct mtarch_thread *thread);
+
 #endif /* __MTARCH_H__ */
@@ -88,6 +88,24 @@ pollhandler(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#ifdef FD_CALLBACK_READ
+/* Platforms with an fd callback main loop poll the driver when a
+   frame has arrived */
+static int
+tap_events(int fd)
+{
+  return FD_CALLBACK_READ;
+}
+static void
+tap_handle(int fd, int events)
+{
+  process_poll(&tapdev_process);
+}
+static const struct fd_callback tap_fd_callback = {
+  tap_events, tap_handle
+};
+#endif /* FD_CALLBACK_READ */
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(tapdev_process, ev, data)
 {
   PROCESS_POLLHANDLER(pollhandler());
@@ -101,9 +119,15 @@ PROCESS_THREAD(tapdev_process, ev, data)
   tcpip_set_outputfunc(tapdev_send);
 #endif
   process_poll(&tapdev_process);
+#ifdef FD_CALLBACK_READ
+  fd_set_callback(tapdev_fd(), &tap_fd_callback);
+#endif /* FD_CALLBACK_READ */
 
   PROCESS_WAIT_UNTIL(ev == PROCESS_EVENT_EXIT);
 
+#ifdef FD_CALLBACK_READ
+  fd_set_callback(tapdev_fd(), NULL);
+#endif /* FD_CALLBACK_READ */
   tapdev_exit();
 
   PROCESS_END();
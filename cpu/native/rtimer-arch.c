@@ -70,6 +70,36 @@ rtimer_arch_init(void)
 #endif /* !_WIN32 */
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+#ifndef _WIN32
+  sigset_t set, old;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGALRM);
+  sigprocmask(SIG_BLOCK, &set, &old);
+  return sigismember(&old, SIGALRM);
+#else /* !_WIN32 */
+  return 0;
+#endif /* !_WIN32 */
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+#ifndef _WIN32
+  sigset_t set;
+
+  /* Nested in a locked section or in the signal handler: stay blocked */
+  if(!s) {
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+  }
+#endif /* !_WIN32 */
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
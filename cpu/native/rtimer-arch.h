@@ -46,4 +46,11 @@
 
 #define rtimer_arch_now() clock_time()
 
+/* rtimer_run_next() runs in the SIGALRM handler: block the signal
+   while the rtimer queue is changed */
+int rtimer_arch_lock(void);
+void rtimer_arch_unlock(int s);
+#define RTIMER_ARCH_LOCK()      rtimer_arch_lock()
+#define RTIMER_ARCH_UNLOCK(s)   rtimer_arch_unlock(s)
+
 #endif /* __RTIMER_ARCH_H__ */
@@ -98,6 +98,24 @@ rtimer_arch_now(void)
   return TMR2;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  unsigned int status;
+
+  /* di returns the previous Status register, IE is bit 0 */
+  asm volatile("di %0" : "=r" (status));
+  return status & 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  if(s) {
+    asm volatile("ei");
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
 {
@@ -140,6 +140,24 @@ rtimer_arch_now(void)
   return t;
 }
 
+/*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  DECLARE_INTERRUPT_STATE;
+
+  DISABLE_INTERRUPTS();
+  return _emIsrState;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  DECLARE_INTERRUPT_STATE;
+
+  _emIsrState = s;
+  RESTORE_INTERRUPTS();
+}
 /*---------------------------------------------------------------------------*/
 void
 rtimer_arch_schedule(rtimer_clock_t t)
@@ -174,14 +174,20 @@ mtarch_pstart(void)
 }
 /*--------------------------------------------------------------------------*/
 int
-mtarch_stack_usage(struct mt_thread *t)
+mtarch_stack_usage(struct mtarch_thread *t)
 {
   int i;
   for(i = 0; i < MTARCH_STACKSIZE; ++i) {
-    if(t->thread.stack[i] != i) {
-      return MTARCH_STACKSIZE - i;
+    if(t->stack[i] != i) {
+      return (MTARCH_STACKSIZE - i) * sizeof(t->stack[0]);
     }
   }
-  return -1;
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+int
+mtarch_stack_size(struct mtarch_thread *t)
+{
+  return sizeof(t->stack);
 }
 /*--------------------------------------------------------------------------*/
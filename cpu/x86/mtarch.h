@@ -35,15 +35,17 @@
 #define MTARCH_STACKSIZE 1024
 #endif /* MTARCH_STACKSIZE */
 
+/* mtarch_start() fills the stack with its word indices */
+#define MTARCH_STACK_CHECK 1
+
 struct mtarch_thread {
   /* Note: stack must be aligned on 4-byte boundary. */
   unsigned long stack[MTARCH_STACKSIZE];
   unsigned long sp;
 };
 
-struct mt_thread;
-
-int mtarch_stack_usage(struct mt_thread *t);
+int mtarch_stack_usage(struct mtarch_thread *t);
+int mtarch_stack_size(struct mtarch_thread *t);
 
 #endif /* __MTARCH_H__ */
 	
@@ -32,6 +32,7 @@
  /* Below define allows importing saved output into Wireshark as "Raw IP" packet type */
 #define WIRESHARK_IMPORT_FORMAT 1
 #include "contiki.h"
+#include "sys/ctimer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -283,10 +284,18 @@ serial_input(FILE *inslip)
 unsigned char slip_buf[2048];
 int slip_end, slip_begin, slip_packet_end, slip_packet_count;
 static struct timer send_delay_timer;
+/* wakes the main loop up when the delay is over */
+static struct ctimer send_delay_ctimer;
 /* delay between slip packets */
 static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
+send_delay_over(void *ptr)
+{
+  /* The main loop asks again for the events of the slip fd */
+}
+/*---------------------------------------------------------------------------*/
+static void
 slip_send(int fd, unsigned char c)
 {
   if(slip_end >= sizeof(slip_buf)) {
@@ -346,6 +355,7 @@ slip_flushbuf(int fd)
         /* a delay between slip packets to avoid losing data */
         if(send_delay > 0) {
           timer_set(&send_delay_timer, send_delay);
+          ctimer_set(&send_delay_ctimer, send_delay, send_delay_over, NULL);
         }
       }
     }
@@ -460,30 +470,29 @@ stty_telos(int fd)
 }
 /*---------------------------------------------------------------------------*/
 static int
-set_fd(fd_set *rset, fd_set *wset)
+events(int fd)
 {
   /* Anything to flush? */
   if(!slip_empty() && (send_delay == 0 || timer_expired(&send_delay_timer))) {
-    FD_SET(slipfd, wset);
+    return FD_CALLBACK_READ | FD_CALLBACK_WRITE;
   }
 
-  FD_SET(slipfd, rset);	/* Read from slip ASAP! */
-  return 1;
+  return FD_CALLBACK_READ;	/* Read from slip ASAP! */
 }
 /*---------------------------------------------------------------------------*/
 static void
-handle_fd(fd_set *rset, fd_set *wset)
+handle_fd(int fd, int events)
 {
-  if(FD_ISSET(slipfd, rset)) {
+  if(events & FD_CALLBACK_READ) {
     serial_input(inslip);
   }
 
-  if(FD_ISSET(slipfd, wset)) {
+  if(events & FD_CALLBACK_WRITE) {
     slip_flushbuf(slipfd);
   }
 }
 /*---------------------------------------------------------------------------*/
-static const struct select_callback slip_callback = { set_fd, handle_fd };
+static const struct fd_callback slip_callback = { events, handle_fd };
 /*---------------------------------------------------------------------------*/
 void
 slip_init(void)
@@ -526,7 +535,7 @@ slip_init(void)
     }
   }
 
-  select_set_callback(slipfd, &slip_callback);
+  fd_set_callback(slipfd, &slip_callback);
 
   if(slip_config_host != NULL) {
     fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
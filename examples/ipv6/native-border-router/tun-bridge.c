@@ -72,10 +72,10 @@ extern uint16_t slip_config_basedelay;
 #ifndef __CYGWIN__
 static int tunfd;
 
-static int set_fd(fd_set *rset, fd_set *wset);
-static void handle_fd(fd_set *rset, fd_set *wset);
-static const struct select_callback tun_select_callback = {
-  set_fd,
+static int events(int fd);
+static void handle_fd(int fd, int events);
+static const struct fd_callback tun_fd_callback = {
+  events,
   handle_fd
 };
 #endif /* __CYGWIN__ */
@@ -209,7 +209,7 @@ tun_init()
   tunfd = tun_alloc(slip_config_tundev);
   if(tunfd == -1) err(1, "main: open");
 
-  select_set_callback(tunfd, &tun_select_callback);
+  fd_set_callback(tunfd, &tun_fd_callback);
 
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           "tun", slip_config_tundev);
@@ -261,19 +261,18 @@ const struct uip_fallback_interface rpl_interface = {
 };
 
 /*---------------------------------------------------------------------------*/
-/* tun and slip select callback                                              */
+/* tun and slip fd callback                                                  */
 /*---------------------------------------------------------------------------*/
 static int
-set_fd(fd_set *rset, fd_set *wset)
+events(int fd)
 {
-  FD_SET(tunfd, rset);
-  return 1;
+  return FD_CALLBACK_READ;
 }
 
 /*---------------------------------------------------------------------------*/
 
 static void
-handle_fd(fd_set *rset, fd_set *wset)
+handle_fd(int fd, int events)
 {
   /* Optional delay between outgoing packets */
   /* Base delay times number of 6lowpan fragments to be sent */
@@ -290,7 +289,7 @@ handle_fd(fd_set *rset, fd_set *wset)
   if(delaymsec==0) {
     int size;
 
-    if(FD_ISSET(tunfd, rset)) {
+    if(events & FD_CALLBACK_READ) {
       size = tun_input(&uip_buf[UIP_LLH_LEN], sizeof(uip_buf));
       /* printf("TUN data incoming read:%d\n", size); */
       uip_len = size;
@@ -41,6 +41,12 @@
 
 #define COOJA 1
 
+/* Contiki runs on a cooja_mt stack of COOJA_MTARCH_STACKSIZE words:
+   check the lower half of it */
+#ifndef STACK_CHECK_CONF_SIZE
+#define STACK_CHECK_CONF_SIZE (512 * sizeof(long))
+#endif /* STACK_CHECK_CONF_SIZE */
+
 #ifndef EEPROM_CONF_SIZE
 #define EEPROM_CONF_SIZE				1024
 #endif
@@ -187,6 +193,13 @@
 #define CC_CONF_VA_ARGS                1
 #define CC_CONF_INLINE inline
 
+/* Cooja motes are not interrupted while Contiki runs */
+#define PROCESS_CONF_POLL_LOCK()      0
+#define PROCESS_CONF_POLL_UNLOCK(s)   (void)(s)
+
+/* rtimer_arch_now() yields to Cooja, it can not be read from the tick */
+#define IDLE_CONF_RTIMER_NOW()        ((rtimer_clock_t)clock_time())
+
 #define CCIF
 #define CLIF
 
@@ -43,6 +43,8 @@
 
 #include "sys/clock.h"
 #include "sys/etimer.h"
+#include "sys/idle.h"
+#include "sys/stack-check.h"
 #include "sys/cooja_mt.h"
 #include "sys/autostart.h"
 
@@ -335,6 +337,7 @@ process_run_thread_loop(void *data)
     simProcessRunValue = 1;
     cooja_mt_yield();
 
+    stack_check_init();
     contiki_init();
 
     while(1)
@@ -443,8 +446,7 @@ Java_se_sics_cooja_corecomm_CLASSNAME_setMemory(JNIEnv *env, jobject obj, jint r
 JNIEXPORT void JNICALL
 Java_se_sics_cooja_corecomm_CLASSNAME_tick(JNIEnv *env, jobject obj)
 {
-  clock_time_t nextEtimer;
-  rtimer_clock_t nextRtimer;
+  clock_time_t left;
 
   simProcessRunValue = 0;
 
@@ -470,21 +472,14 @@ Java_se_sics_cooja_corecomm_CLASSNAME_tick(JNIEnv *env, jobject obj)
   doActionsAfterTick();
 
   /* Do we have any pending timers */
-  simEtimerPending = etimer_pending() || rtimer_arch_pending();
+  left = idle_time_left();
+  simEtimerPending = left != IDLE_FOREVER;
   if(!simEtimerPending) {
     return;
   }
 
   /* Save nearest expiration time */
-  nextEtimer = etimer_next_expiration_time() - (clock_time_t) simCurrentTime;
-  nextRtimer = rtimer_arch_next() - (rtimer_clock_t) simCurrentTime;
-  if(etimer_pending() && rtimer_arch_pending()) {
-    simNextExpirationTime = MIN(nextEtimer, nextRtimer);
-  } else if (etimer_pending()) {
-    simNextExpirationTime = nextEtimer;
-  } else if (rtimer_arch_pending()) {
-    simNextExpirationTime = nextRtimer;
-  }
+  simNextExpirationTime = left;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -258,6 +258,7 @@ PROCESS_THREAD(cooja_radio_process, ev, data)
 static int
 init(void)
 {
+  process_set_priority(&cooja_radio_process, PROCESS_PRIORITY_HIGH);
   process_start(&cooja_radio_process, NULL);
   return 1;
 }
@@ -43,4 +43,10 @@ int rtimer_arch_check(void);
 int rtimer_arch_pending(void);
 rtimer_clock_t rtimer_arch_next(void);
 
+/* rtimer_run_next() runs in the rtimer thread, which only gets control
+   when the Contiki thread yields to Cooja, never while the rtimer
+   queue is changed: there is nothing to mask */
+#define RTIMER_ARCH_LOCK()      0
+#define RTIMER_ARCH_UNLOCK(s)   (void)(s)
+
 #endif /* __RTIMER_ARCH_H__ */
@@ -213,9 +213,15 @@ cooja_mtarch_stack_usage(struct cooja_mt_thread *t)
   int i;
   for(i = 0; i < COOJA_MTARCH_STACKSIZE; ++i) {
     if(t->thread.stack[i] != i) {
-      return COOJA_MTARCH_STACKSIZE - i;
+      return (COOJA_MTARCH_STACKSIZE - i) * sizeof(t->thread.stack[0]);
     }
   }
-  return -1;
+  return 0;
+}
+/*--------------------------------------------------------------------------*/
+int
+cooja_mtarch_stack_size(struct cooja_mt_thread *t)
+{
+  return sizeof(t->thread.stack);
 }
 /*--------------------------------------------------------------------------*/
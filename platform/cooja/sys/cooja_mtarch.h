@@ -46,7 +46,12 @@ struct cooja_mtarch_thread {
 
 struct cooja_mt_thread;
 
+/* Peak usage and size of the stack of a thread in bytes: the stack
+   is filled with its word indices by cooja_mtarch_start(). The usage
+   is 0 if the whole stack is still untouched, as on the other
+   architectures. */
 int cooja_mtarch_stack_usage(struct cooja_mt_thread *t);
+int cooja_mtarch_stack_size(struct cooja_mt_thread *t);
 
 #endif /* __COOJA_MTARCH_H__ */
 	
@@ -266,7 +266,7 @@ main(void)
       eint();
     } else {
 #if ENERGEST_CONF_ON
-      static unsigned long irq_energest = 0;
+      static energest_time_t irq_energest = 0;
 #endif /* ENERGEST_CONF_ON */
 
 #if DCOSYNCH_CONF_ENABLED
@@ -295,7 +295,7 @@ main(void)
       /* We get the current processing time for interrupts that was
 	 done during the LPM and store it for next time around.  */
       dint();
-      irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
+      irq_energest = energest_type_time_wide(ENERGEST_TYPE_IRQ);
       eint();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
       ENERGEST_ON(ENERGEST_TYPE_CPU);
@@ -311,7 +311,7 @@ main(int argc, char **argv)
     if(process_nevents() != 0 || uart1_active()) {
       splx(s);                  /* Re-enable interrupts. */
     } else {
-      static unsigned long irq_energest = 0;
+      static energest_time_t irq_energest = 0;
 
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_OFF(ENERGEST_TYPE_CPU);
@@ -331,7 +331,7 @@ main(int argc, char **argv)
       /* We get the current processing time for interrupts that was
          done during the LPM and store it for next time around.  */
       dint();
-      irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
+      irq_energest = energest_type_time_wide(ENERGEST_TYPE_IRQ);
       eint();
       watchdog_start();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
@@ -178,7 +178,7 @@ main(void)
     if (process_nevents() != 0) {
       splx(s);			/* Re-enable interrupts. */
     } else {
-      static unsigned long irq_energest = 0;
+      static energest_time_t irq_energest = 0;
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_OFF(ENERGEST_TYPE_CPU);
       ENERGEST_ON(ENERGEST_TYPE_LPM);
@@ -200,7 +200,7 @@ main(void)
        * done during the LPM and store it for next time around. 
        */
       dint();
-      irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
+      irq_energest = energest_type_time_wide(ENERGEST_TYPE_IRQ);
       eint();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
       ENERGEST_ON(ENERGEST_TYPE_CPU);
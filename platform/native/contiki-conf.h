@@ -38,6 +38,18 @@
 #include <sys/select.h>
 #endif
 
+/* The main loop waits for the events that the callback of a file
+   descriptor returns, and calls its handler with those that occurred */
+#define FD_CALLBACK_READ  1
+#define FD_CALLBACK_WRITE 2
+
+struct fd_callback {
+  int  (* events)(int fd);
+  void (* handle)(int fd, int events);
+};
+int fd_set_callback(int fd, const struct fd_callback *callback);
+
+/* Deprecated: the file descriptor must be below FD_SETSIZE */
 struct select_callback {
   int  (* set_fd)(fd_set *fdr, fd_set *fdw);
   void (* handle_fd)(fd_set *fdr, fd_set *fdw);
@@ -50,6 +62,11 @@ int select_set_callback(int fd, const struct select_callback *callback);
 #define CC_CONF_VA_ARGS                1
 /*#define CC_CONF_INLINE                 inline*/
 
+/* Region of the host stack below main() checked by sys/stack-check */
+#ifndef STACK_CHECK_CONF_SIZE
+#define STACK_CHECK_CONF_SIZE 16384
+#endif /* STACK_CHECK_CONF_SIZE */
+
 #ifndef EEPROM_CONF_SIZE
 #define EEPROM_CONF_SIZE				1024
 #endif
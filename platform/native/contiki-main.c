@@ -31,17 +31,37 @@
  *
  */
 
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/select.h>
 
+/* Linux hosts wait for their file descriptors and timers with epoll
+   and a timerfd, others with pselect() */
+#ifdef NATIVE_CONF_EPOLL
+#define EPOLL NATIVE_CONF_EPOLL
+#elif defined(__linux__)
+#define EPOLL 1
+#else
+#define EPOLL 0
+#endif
+
+#if EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif /* EPOLL */
+
 #ifdef __CYGWIN__
 #include "net/wpcap-drv.h"
 #endif /* __CYGWIN__ */
 
 #include "contiki.h"
 #include "net/netstack.h"
+#include "sys/idle.h"
+#include "sys/stack-check.h"
 
 #include "ctk/ctk.h"
 #include "ctk/ctk-curses.h"
@@ -60,73 +80,382 @@
 
 #include "net/rime.h"
 
-#ifdef SELECT_CONF_MAX
-#define SELECT_MAX SELECT_CONF_MAX
-#else
-#define SELECT_MAX 8
-#endif
-
-static const struct select_callback *select_callback[SELECT_MAX];
-static int select_max = 0;
-
 SENSORS(&pir_sensor, &vib_sensor, &button_sensor);
 
 static uint8_t serial_id[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
 static uint16_t node_id = 0x0102;
+
+struct fd_entry {
+  const struct fd_callback *callback;
+  /* For the callbacks set with select_set_callback() */
+  const struct select_callback *select;
+  /* The events the main loop waits for */
+  int events;
+  /* epoll does not take regular files: they are always ready */
+  int always_ready;
+};
+
+static struct fd_entry *fd_entries;
+static int fd_entries_len;
+static int fd_max = -1;
+
+#if EPOLL
+#define MAX_EVENTS 32
+static int epoll_fd = -1, timer_fd = -1;
+static int timer_armed;
+static clock_time_t timer_deadline;
+#endif /* EPOLL */
 /*---------------------------------------------------------------------------*/
 int
-select_set_callback(int fd, const struct select_callback *callback)
+fd_set_callback(int fd, const struct fd_callback *callback)
 {
-  int i;
-  if(fd >= 0 && fd < SELECT_MAX) {
-    /* Check that the callback functions are set */
-    if(callback != NULL &&
-       (callback->set_fd == NULL || callback->handle_fd == NULL)) {
-      callback = NULL;
+  struct fd_entry *e;
+  int len;
+
+  if(fd < 0) {
+    return 0;
+  }
+  if(callback != NULL &&
+     (callback->events == NULL || callback->handle == NULL)) {
+    callback = NULL;
+  }
+  if(fd >= fd_entries_len) {
+    if(callback == NULL) {
+      return 1;
+    }
+    len = fd_entries_len > 0 ? fd_entries_len : 16;
+    while(len <= fd) {
+      len *= 2;
     }
+    e = realloc(fd_entries, len * sizeof(struct fd_entry));
+    if(e == NULL) {
+      return 0;
+    }
+    memset(&e[fd_entries_len], 0,
+           (len - fd_entries_len) * sizeof(struct fd_entry));
+    fd_entries = e;
+    fd_entries_len = len;
+  }
 
-    select_callback[fd] = callback;
+  e = &fd_entries[fd];
+  if(callback != e->callback) {
+#if EPOLL
+    if(e->events != 0 && !e->always_ready) {
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif /* EPOLL */
+    e->events = 0;
+    e->always_ready = 0;
+  }
+  e->callback = callback;
 
-    /* Update fd max */
-    if(callback != NULL) {
-      if(fd > select_max) {
-        select_max = fd;
-      }
-    } else {
-      select_max = 0;
-      for(i = SELECT_MAX - 1; i > 0; i--) {
-        if(select_callback[i] != NULL) {
-          select_max = i;
-          break;
-        }
-      }
+  if(callback != NULL) {
+    if(fd > fd_max) {
+      fd_max = fd;
+    }
+  } else {
+    e->select = NULL;
+    while(fd_max >= 0 && fd_entries[fd_max].callback == NULL) {
+      fd_max--;
     }
-    return 1;
   }
-  return 0;
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
+/* select_set_callback() callbacks set and test fd_sets, which only
+   hold descriptors below FD_SETSIZE */
 static int
-stdin_set_fd(fd_set *rset, fd_set *wset)
+select_events(int fd)
+{
+  fd_set fdr, fdw;
+  int events = 0;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  if(fd_entries[fd].select->set_fd(&fdr, &fdw)) {
+    if(FD_ISSET(fd, &fdr)) {
+      events |= FD_CALLBACK_READ;
+    }
+    if(FD_ISSET(fd, &fdw)) {
+      events |= FD_CALLBACK_WRITE;
+    }
+  }
+  return events;
+}
+static void
+select_handle(int fd, int events)
 {
-  FD_SET(STDIN_FILENO, rset);
+  fd_set fdr, fdw;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  if(events & FD_CALLBACK_READ) {
+    FD_SET(fd, &fdr);
+  }
+  if(events & FD_CALLBACK_WRITE) {
+    FD_SET(fd, &fdw);
+  }
+  fd_entries[fd].select->handle_fd(&fdr, &fdw);
+}
+static const struct fd_callback select_adapter = {
+  select_events, select_handle
+};
+/*---------------------------------------------------------------------------*/
+int
+select_set_callback(int fd, const struct select_callback *callback)
+{
+  if(fd < 0 || fd >= FD_SETSIZE) {
+    return 0;
+  }
+  if(callback != NULL &&
+     (callback->set_fd == NULL || callback->handle_fd == NULL)) {
+    callback = NULL;
+  }
+  if(callback == NULL) {
+    return fd_set_callback(fd, NULL);
+  }
+  if(!fd_set_callback(fd, &select_adapter)) {
+    return 0;
+  }
+  fd_entries[fd].select = callback;
   return 1;
 }
+/*---------------------------------------------------------------------------*/
+static int
+stdin_events(int fd)
+{
+  return FD_CALLBACK_READ;
+}
 static void
-stdin_handle_fd(fd_set *rset, fd_set *wset)
+stdin_handle(int fd, int events)
 {
   char c;
-  if(FD_ISSET(STDIN_FILENO, rset)) {
-    if(read(STDIN_FILENO, &c, 1) > 0) {
-      serial_line_input_byte(c);
-    }
+  int n;
+
+  n = read(STDIN_FILENO, &c, 1);
+  if(n > 0) {
+    serial_line_input_byte(c);
+  } else if(n == 0) {
+    /* End of file: stop waiting for input */
+    fd_set_callback(STDIN_FILENO, NULL);
   }
 }
-const static struct select_callback stdin_fd = {
-  stdin_set_fd, stdin_handle_fd
+static const struct fd_callback stdin_fd = {
+  stdin_events, stdin_handle
 };
 /*---------------------------------------------------------------------------*/
 static void
+dispatch(int fd, int events)
+{
+  if(fd <= fd_max && fd_entries[fd].callback != NULL) {
+    fd_entries[fd].callback->handle(fd, events);
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if EPOLL
+static void
+wait_init(void)
+{
+  struct epoll_event ev;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(epoll_fd < 0 || timer_fd < 0) {
+    perror("epoll");
+    exit(1);
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    exit(1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Register the events the callbacks wait for, when they have changed.
+   Return 1 if a regular file is waited for. */
+static int
+update_events(void)
+{
+  struct epoll_event ev;
+  struct fd_entry *e;
+  int fd, events, op, ready = 0;
+
+  for(fd = 0; fd <= fd_max; fd++) {
+    e = &fd_entries[fd];
+    if(e->callback == NULL) {
+      continue;
+    }
+    events = e->callback->events(fd);
+    if(events != e->events && !e->always_ready) {
+      if(events == 0) {
+        op = EPOLL_CTL_DEL;
+      } else if(e->events == 0) {
+        op = EPOLL_CTL_ADD;
+      } else {
+        op = EPOLL_CTL_MOD;
+      }
+      memset(&ev, 0, sizeof(ev));
+      ev.events = ((events & FD_CALLBACK_READ) ? EPOLLIN : 0) |
+        ((events & FD_CALLBACK_WRITE) ? EPOLLOUT : 0);
+      ev.data.fd = fd;
+      if(epoll_ctl(epoll_fd, op, fd, &ev) < 0) {
+        if(errno == EPERM) {
+          e->always_ready = 1;
+        } else {
+          perror("epoll_ctl");
+          events = e->events;
+        }
+      }
+    }
+    e->events = events;
+    if(e->always_ready && events != 0) {
+      ready = 1;
+    }
+  }
+  return ready;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_timer(clock_time_t left)
+{
+  struct itimerspec its;
+  clock_time_t deadline;
+
+  memset(&its, 0, sizeof(its));
+  if(left == IDLE_FOREVER) {
+    if(!timer_armed) {
+      return;
+    }
+    timer_armed = 0;
+  } else {
+    deadline = clock_time() + left;
+    if(timer_armed && deadline == timer_deadline) {
+      return;
+    }
+    timer_armed = 1;
+    timer_deadline = deadline;
+    its.it_value.tv_sec = left / CLOCK_SECOND;
+    its.it_value.tv_nsec = (left % CLOCK_SECOND) * 1000000000ULL / CLOCK_SECOND;
+  }
+  if(timerfd_settime(timer_fd, 0, &its, NULL) < 0) {
+    perror("timerfd_settime");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_events(clock_time_t left, const sigset_t *mask)
+{
+  struct epoll_event ev[MAX_EVENTS];
+  uint64_t expirations;
+  int i, n, fd, events, timeout;
+
+  timeout = -1;
+  if(update_events() || left == 0) {
+    timeout = 0;
+  } else {
+    set_timer(left);
+  }
+
+  n = epoll_pwait(epoll_fd, ev, MAX_EVENTS, timeout, mask);
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("epoll_wait");
+    }
+    n = 0;
+  }
+  for(i = 0; i < n; i++) {
+    fd = ev[i].data.fd;
+    if(fd == timer_fd) {
+      if(read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+        timer_armed = 0;
+      }
+      continue;
+    }
+    events = 0;
+    if(ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      events |= FD_CALLBACK_READ;
+    }
+    if(ev[i].events & EPOLLOUT) {
+      events |= FD_CALLBACK_WRITE;
+    }
+    if(fd <= fd_max) {
+      dispatch(fd, events & fd_entries[fd].events);
+    }
+  }
+
+  for(fd = 0; fd <= fd_max; fd++) {
+    if(fd_entries[fd].always_ready && fd_entries[fd].events != 0) {
+      dispatch(fd, fd_entries[fd].events);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+#else /* EPOLL */
+static void
+wait_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_events(clock_time_t left, const sigset_t *mask)
+{
+  fd_set fdr, fdw;
+  struct timespec ts, *timeout;
+  int fd, maxfd, events, n;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  maxfd = -1;
+  for(fd = 0; fd <= fd_max && fd < FD_SETSIZE; fd++) {
+    if(fd_entries[fd].callback == NULL) {
+      continue;
+    }
+    events = fd_entries[fd].callback->events(fd);
+    fd_entries[fd].events = events;
+    if(events & FD_CALLBACK_READ) {
+      FD_SET(fd, &fdr);
+    }
+    if(events & FD_CALLBACK_WRITE) {
+      FD_SET(fd, &fdw);
+    }
+    if(events != 0) {
+      maxfd = fd;
+    }
+  }
+
+  if(left == IDLE_FOREVER) {
+    timeout = NULL;
+  } else {
+    ts.tv_sec = left / CLOCK_SECOND;
+    ts.tv_nsec = (left % CLOCK_SECOND) * 1000000000ULL / CLOCK_SECOND;
+    timeout = &ts;
+  }
+
+  n = pselect(maxfd + 1, &fdr, &fdw, NULL, timeout, mask);
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("select");
+    }
+    return;
+  }
+  for(fd = 0; fd <= maxfd; fd++) {
+    events = 0;
+    if(FD_ISSET(fd, &fdr)) {
+      events |= FD_CALLBACK_READ;
+    }
+    if(FD_ISSET(fd, &fdw)) {
+      events |= FD_CALLBACK_WRITE;
+    }
+    if(events != 0) {
+      dispatch(fd, events);
+    }
+  }
+}
+#endif /* EPOLL */
+/*---------------------------------------------------------------------------*/
+static void
 set_rime_addr(void)
 {
   rimeaddr_t addr;
@@ -161,6 +490,10 @@ char **contiki_argv;
 int
 main(int argc, char **argv)
 {
+  sigset_t rtimer_signal;
+
+  stack_check_init();
+
 #if UIP_CONF_IPV6
 #if UIP_CONF_IPV6_RPL
   printf(CONTIKI_VERSION_STRING " started with IPV6, RPL\n");
@@ -190,6 +523,7 @@ main(int argc, char **argv)
   process_init();
   process_start(&etimer_process, NULL);
   ctimer_init();
+  rtimer_init();
 
 #if WITH_GUI
   process_start(&ctk_process, NULL);
@@ -234,40 +568,26 @@ main(int argc, char **argv)
   /* Make standard output unbuffered. */
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 
-  select_set_callback(STDIN_FILENO, &stdin_fd);
+  fd_set_callback(STDIN_FILENO, &stdin_fd);
+  wait_init();
+  sigemptyset(&rtimer_signal);
+  sigaddset(&rtimer_signal, SIGALRM);
   while(1) {
-    fd_set fdr;
-    fd_set fdw;
-    int maxfd;
-    int i;
     int retval;
-    struct timeval tv;
+    clock_time_t left;
+    sigset_t mask;
 
     retval = process_run();
 
-    tv.tv_sec = 0;
-    tv.tv_usec = retval ? 1 : 1000;
-
-    FD_ZERO(&fdr);
-    FD_ZERO(&fdw);
-    maxfd = 0;
-    for(i = 0; i <= select_max; i++) {
-      if(select_callback[i] != NULL && select_callback[i]->set_fd(&fdr, &fdw)) {
-        maxfd = i;
-      }
-    }
+    /* Hold the rtimer signal until the wait starts, so that a process
+       it polls in between does not wait for the next wakeup */
+    sigprocmask(SIG_BLOCK, &rtimer_signal, &mask);
 
-    retval = select(maxfd + 1, &fdr, &fdw, NULL, &tv);
-    if(retval < 0) {
-      perror("select");
-    } else if(retval > 0) {
-      /* timeout => retval == 0 */
-      for(i = 0; i <= maxfd; i++) {
-        if(select_callback[i] != NULL) {
-          select_callback[i]->handle_fd(&fdr, &fdw);
-        }
-      }
-    }
+    /* Sleep until the next timer deadline, or until a file descriptor
+       or an rtimer signal needs attention */
+    left = retval ? 0 : idle_time_left();
+    wait_events(left, &mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
 
     etimer_request_poll();
 
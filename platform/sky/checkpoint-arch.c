@@ -307,6 +307,7 @@ thread_metrics(void)
   PRINTF_COMMAND("M:RTIMER_NOW:%u\n", RTIMER_NOW()); /* TODO extract */
   PRINTF_COMMAND("M:ENERGY_TX:%lu\n", thread_metric_tx());
   PRINTF_COMMAND("M:ENERGY_RX:%lu\n", thread_metric_rx());
+  PRINTF_COMMAND("M:STACK:%d\n", mt_stack_usage(&checkpoint_thread));
   PRINTF_COMMAND("M:RTIMER_NOW2:%u\n", RTIMER_NOW());
   nr_metrics++;
   PRINTF_COMMAND("METRICS:DONE %u\n", nr_metrics);
@@ -19,6 +19,8 @@
 //#define TX_POWER 23
 
 #define ENERGEST_CONF_ON 1
+/* CPU time per process, listed by the shell's ps command */
+#define ENERGEST_CONF_PROCESS 1
 
 #define HAVE_STDINT_H
 #define MSP430_MEMCPY_WORKAROUND 1
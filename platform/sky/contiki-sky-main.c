@@ -46,6 +46,16 @@
 
 #include "node-id.h"
 #include "sys/autostart.h"
+#include "sys/idle.h"
+#include "sys/profile.h"
+#include "sys/stack-check.h"
+
+/* Suppress the periodic clock interrupt while the CPU sleeps */
+#ifdef CLOCK_CONF_TICKLESS
+#define TICKLESS CLOCK_CONF_TICKLESS
+#else
+#define TICKLESS 1
+#endif
 
 #if TINYOS_ID
   // they will be changed before the upload
@@ -75,6 +85,7 @@ main(int argc, char **argv)
    * Initalize hardware.
    */
   msp430_cpu_init();
+  stack_check_init();
   clock_init();
 
   gpio_init();
@@ -128,6 +139,10 @@ main(int argc, char **argv)
   energest_init();
   ENERGEST_ON(ENERGEST_TYPE_CPU);
 
+#if PROFILE_CONF_ON
+  profile_init();
+#endif /* PROFILE_CONF_ON */
+
   //MARCO
   //watchdog_start();
   watchdog_init();
@@ -140,11 +155,17 @@ main(int argc, char **argv)
    */
   while(1) {
     int r;
+#if PROFILE_CONF_ON
+    profile_episode_start();
+#endif /* PROFILE_CONF_ON */
     do {
       /* Reset watchdog. */
       watchdog_periodic();
       r = process_run();
     } while(r > 0);
+#if PROFILE_CONF_ON
+    profile_episode_end();
+#endif /* PROFILE_CONF_ON */
 
     /*
      * Idle processing.
@@ -154,7 +175,7 @@ main(int argc, char **argv)
     if(process_nevents() != 0 || uart1_active()) {
       splx(s);			/* Re-enable interrupts. */
     } else {
-      static unsigned long irq_energest = 0;
+      static energest_time_t irq_energest = 0;
 
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_OFF(ENERGEST_TYPE_CPU);
@@ -164,6 +185,9 @@ main(int argc, char **argv)
 	 were awake. */
       energest_type_set(ENERGEST_TYPE_IRQ, irq_energest);
       watchdog_stop();
+#if TICKLESS
+      clock_tickless_enter(idle_time_left());
+#endif
       _BIS_SR(GIE | SCG0 | SCG1 | CPUOFF); /* LPM3 sleep. This
 					      statement will block
 					      until the CPU is
@@ -173,8 +197,11 @@ main(int argc, char **argv)
       /* We get the current processing time for interrupts that was
 	 done during the LPM and store it for next time around.  */
       dint();
-      irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
+      irq_energest = energest_type_time_wide(ENERGEST_TYPE_IRQ);
       eint();
+#if TICKLESS
+      clock_tickless_exit();
+#endif
       watchdog_start();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
       ENERGEST_ON(ENERGEST_TYPE_CPU);
@@ -444,7 +444,7 @@ main(int argc, char **argv)
     if(process_nevents() != 0 || uart0_active()) {
       splx(s);			/* Re-enable interrupts. */
     } else {
-      static unsigned long irq_energest = 0;
+      static energest_time_t irq_energest = 0;
 
 #if DCOSYNCH_CONF_ENABLED
       /* before going down to sleep possibly do some management */
@@ -472,7 +472,7 @@ main(int argc, char **argv)
       /* We get the current processing time for interrupts that was
 	 done during the LPM and store it for next time around.  */
       dint();
-      irq_energest = energest_type_time(ENERGEST_TYPE_IRQ);
+      irq_energest = energest_type_time_wide(ENERGEST_TYPE_IRQ);
       eint();
       watchdog_start();
       ENERGEST_OFF(ENERGEST_TYPE_LPM);
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Host test of the message queues and the process semaphores
+ *
+ *         Runs lib/msgq and sys/process-sem with the real process
+ *         scheduler: the queue is filled and emptied across the wrap
+ *         of its 8-bit counters, and the consumer and waiter processes
+ *         must be woken up by their poll alone.
+ */
+
+#include <stdio.h>
+
+#include "sys/process.h"
+#include "sys/process-sem.h"
+#include "lib/msgq.h"
+
+static int failed;
+
+#define CHECK(cond) do {                                        \
+    if(!(cond)) {                                               \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failed = 1;                                               \
+    }                                                           \
+  } while(0)
+
+MSGQ(numbers, uint16_t, 4);
+
+static int consumer_runs;
+static uint16_t consumer_next, consumer_taken;
+static struct process_sem sem;
+static int waiter_taken;
+/*---------------------------------------------------------------------------*/
+PROCESS(consumer_process, "Consumer");
+PROCESS_THREAD(consumer_process, ev, data)
+{
+  static uint16_t n;
+
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_MSGQ_WAIT(&numbers);
+    consumer_runs++;
+    while(msgq_get(&numbers, &n)) {
+      CHECK(n == consumer_next);
+      consumer_next++;
+      consumer_taken++;
+    }
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(waiter_process, "Waiter");
+PROCESS_THREAD(waiter_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_SEM_WAIT(&sem);
+    waiter_taken++;
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_all(void)
+{
+  while(process_run() > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_wrap(void)
+{
+  uint16_t put, get, n;
+  int i;
+
+  msgq_init(&numbers, NULL);
+  CHECK(msgq_empty(&numbers));
+  CHECK(!msgq_get(&numbers, &n));
+  CHECK(msgq_peek(&numbers) == NULL);
+
+  /* 300 rounds take the counters around their 8-bit wrap */
+  put = get = 0;
+  for(i = 0; i < 300; i++) {
+    while(msgq_put(&numbers, &put)) {
+      put++;
+    }
+    CHECK(msgq_len(&numbers) == 4);
+    CHECK(msgq_reserve(&numbers) == NULL);
+    CHECK(numbers.dropped == i * 2 + 2);
+
+    /* take a different number of messages every round */
+    while(msgq_len(&numbers) > i % 4 && msgq_get(&numbers, &n)) {
+      CHECK(n == get);
+      get++;
+    }
+  }
+  while(msgq_get(&numbers, &n)) {
+    CHECK(n == get);
+    get++;
+  }
+  CHECK(get == put);
+  CHECK(msgq_empty(&numbers));
+
+  printf("wrap: %u messages\n", put);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_wakeup(void)
+{
+  uint16_t n;
+  int i;
+
+  msgq_init(&numbers, NULL);
+  consumer_runs = 0;
+  consumer_next = consumer_taken = 0;
+  process_start(&consumer_process, NULL);
+  run_all();
+  CHECK(consumer_runs == 0);
+
+  /* One poll for a batch: the consumer takes every message at once */
+  n = 0;
+  for(i = 0; i < 3; i++, n++) {
+    msgq_put(&numbers, &n);
+  }
+  run_all();
+  CHECK(consumer_runs == 1);
+  CHECK(consumer_taken == 3);
+
+  /* Nothing wakes the consumer when nothing was added */
+  run_all();
+  CHECK(consumer_runs == 1);
+
+  /* Batches across the wrap of the counters */
+  for(i = 0; i < 200; i++) {
+    msgq_put(&numbers, &n);
+    n++;
+    msgq_put(&numbers, &n);
+    n++;
+    run_all();
+  }
+  CHECK(consumer_runs == 201);
+  CHECK(consumer_taken == n);
+  CHECK(msgq_empty(&numbers));
+  process_exit(&consumer_process);
+
+  printf("wakeup: %d batches\n", consumer_runs);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_sem(void)
+{
+  process_sem_init(&sem, 0);
+  CHECK(!process_sem_trywait(&sem));
+  process_sem_signal(&sem);
+  process_sem_signal(&sem);
+  CHECK(process_sem_trywait(&sem));
+  CHECK(process_sem_trywait(&sem));
+  CHECK(!process_sem_trywait(&sem));
+
+  /* The waiter blocks, then runs once per signal, on the poll alone */
+  waiter_taken = 0;
+  process_start(&waiter_process, NULL);
+  run_all();
+  CHECK(waiter_taken == 0);
+  process_sem_signal(&sem);
+  run_all();
+  CHECK(waiter_taken == 1);
+  run_all();
+  CHECK(waiter_taken == 1);
+  process_sem_signal(&sem);
+  process_sem_signal(&sem);
+  run_all();
+  CHECK(waiter_taken == 3);
+  CHECK(sem.count == 0);
+  process_exit(&waiter_process);
+
+  printf("sem: %d taken\n", waiter_taken);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  process_init();
+  test_wrap();
+  test_wakeup();
+  test_sem();
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Host test of the ctimer dispatch
+ *
+ *         Runs sys/ctimer with the real etimer and process modules
+ *         and a clock that the test advances. A ctimer is stopped
+ *         while its timer event is queued, its memory is reused for
+ *         another object, and the event must not reach it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sys/process.h"
+#include "sys/etimer.h"
+#include "sys/ctimer.h"
+
+static int failed;
+
+#define CHECK(cond) do {                                        \
+    if(!(cond)) {                                               \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failed = 1;                                               \
+    }                                                           \
+  } while(0)
+
+static clock_time_t now;
+
+/* A ctimer slot of a memb pool, reused for something else once freed */
+static union {
+  struct ctimer c;
+  unsigned char raw[sizeof(struct ctimer)];
+} slot;
+
+static int fired, garbage_called;
+/*---------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+callback(void *ptr)
+{
+  fired++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+garbage(void *ptr)
+{
+  garbage_called++;
+}
+/*---------------------------------------------------------------------------*/
+/* Holds the head of the event queue, so that the timer event that
+   etimer_process posts behind it stays queued for one process_run() */
+PROCESS(blocker_process, "Blocker");
+PROCESS_THREAD(blocker_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_all(void)
+{
+  while(process_run() > 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Expire the timers and let etimer_process post their events, which
+   stay in the queue */
+static void
+expire(clock_time_t t)
+{
+  now += t;
+  process_post(&blocker_process, PROCESS_EVENT_CONTINUE, NULL);
+  etimer_request_poll();
+  process_run();
+}
+/*---------------------------------------------------------------------------*/
+/* Fill the freed slot with an object that looks like an active ctimer
+   whose etimer has expired, with a callback of its own */
+static void
+reuse_slot(void)
+{
+  memset(slot.raw, 0xa5, sizeof(slot.raw));
+  slot.c.next = NULL;
+  slot.c.etimer.p = PROCESS_NONE;
+  slot.c.f = garbage;
+  slot.c.p = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_fire(void)
+{
+  fired = 0;
+  ctimer_set(&slot.c, 2, callback, NULL);
+  expire(1);
+  run_all();
+  CHECK(fired == 0);
+  CHECK(!ctimer_expired(&slot.c));
+  expire(1);
+  run_all();
+  CHECK(fired == 1);
+  CHECK(ctimer_expired(&slot.c));
+
+  printf("fire: %d\n", fired);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_stop_reuse(void)
+{
+  fired = garbage_called = 0;
+  ctimer_set(&slot.c, 1, callback, NULL);
+  expire(1);
+  CHECK(process_nevents() > 0);
+  ctimer_stop(&slot.c);
+  reuse_slot();
+  run_all();
+  CHECK(fired == 0);
+  CHECK(garbage_called == 0);
+  CHECK(process_nevents() == 0);
+
+  printf("stop and reuse: %d callbacks\n", fired + garbage_called);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_set_again_reuse(void)
+{
+  /* An event is queued, the ctimer fires again later: there must be
+     one callback, and no event left once it is idle */
+  fired = garbage_called = 0;
+  ctimer_set(&slot.c, 1, callback, NULL);
+  expire(1);
+  ctimer_set(&slot.c, 1, callback, NULL);
+  expire(1);
+  run_all();
+  CHECK(fired == 1);
+  reuse_slot();
+  run_all();
+  CHECK(fired == 1);
+  CHECK(garbage_called == 0);
+
+  printf("set again and reuse: %d callbacks\n", fired + garbage_called);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  process_init();
+  process_start(&etimer_process, NULL);
+  process_start(&blocker_process, NULL);
+  ctimer_init();
+  run_all();
+
+  test_fire();
+  test_stop_reuse();
+  test_set_again_reuse();
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Host test of the rtimer queue
+ *
+ *         Runs sys/rtimer with a clock that the test advances and a
+ *         timer that only records when it was set. A task must never
+ *         run before its time, whatever its priority, and a task that
+ *         is due too soon for the timer runs a few ticks late.
+ */
+
+#include <stdio.h>
+
+#include "sys/rtimer.h"
+
+static int failed;
+
+#define CHECK(cond) do {                                        \
+    if(!(cond)) {                                               \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failed = 1;                                               \
+    }                                                           \
+  } while(0)
+
+static clock_time_t now;
+static rtimer_clock_t scheduled;
+static int locked;
+
+static struct rtimer a, b;
+static int ran_a, ran_b, order;
+/*---------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_schedule(rtimer_clock_t t)
+{
+  scheduled = t;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_arch_lock(void)
+{
+  return locked++;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_arch_unlock(int s)
+{
+  locked = s;
+}
+/*---------------------------------------------------------------------------*/
+static void
+task_a(struct rtimer *t, void *ptr)
+{
+  ran_a = ++order;
+  CHECK(!RTIMER_CLOCK_LT(RTIMER_NOW(), t->time));
+}
+/*---------------------------------------------------------------------------*/
+static void
+task_b(struct rtimer *t, void *ptr)
+{
+  ran_b = ++order;
+  CHECK(!RTIMER_CLOCK_LT(RTIMER_NOW(), t->time));
+}
+/*---------------------------------------------------------------------------*/
+/* The timer interrupt, at time t */
+static void
+fire(rtimer_clock_t t)
+{
+  now = t;
+  rtimer_run_next();
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset(rtimer_clock_t t)
+{
+  rtimer_init();
+  now = t;
+  ran_a = ran_b = order = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_not_early(void)
+{
+  reset(100);
+  CHECK(rtimer_set(&a, 110, 0, task_a, NULL) == RTIMER_OK);
+  CHECK(scheduled == 110);
+  CHECK(locked == 0);
+
+  /* A timer that fires a little early runs nothing and is set again */
+  fire(104);
+  CHECK(ran_a == 0);
+  CHECK(scheduled == 110);
+
+  /* Nor does it a few ticks before, the task waits the minimum delay */
+  fire(107);
+  CHECK(ran_a == 0);
+  CHECK(scheduled == 111);
+  fire(111);
+  CHECK(ran_a == 1);
+
+  printf("not early: %d\n", ran_a);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_min_delay(void)
+{
+  /* Too close to now, and already passed: both run a little late */
+  reset(100);
+  rtimer_set(&a, 101, 0, task_a, NULL);
+  CHECK(scheduled == 104);
+  fire(104);
+  CHECK(ran_a == 1);
+
+  reset(200);
+  rtimer_set(&b, 190, 0, task_b, NULL);
+  CHECK(scheduled == 204);
+  fire(204);
+  CHECK(ran_b == 1);
+
+  /* The queue is not empty after a run and the next task is too close */
+  reset(300);
+  rtimer_set(&a, 310, 0, task_a, NULL);
+  rtimer_set(&b, 311, 0, task_b, NULL);
+  fire(310);
+  CHECK(ran_a == 1 && ran_b == 0);
+  CHECK(scheduled == 314);
+  fire(314);
+  CHECK(ran_b == 2);
+
+  printf("min delay: %d %d\n", ran_a, ran_b);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_priority(void)
+{
+  /* A high priority task that is not due yet waits for its time */
+  reset(100);
+  rtimer_set_priority(&a, 110, RTIMER_PRIORITY_NORMAL, task_a, NULL);
+  rtimer_set_priority(&b, 111, RTIMER_PRIORITY_HIGH, task_b, NULL);
+  fire(110);
+  CHECK(ran_a == 1);
+  CHECK(ran_b == 0);
+  fire(111);
+  CHECK(ran_b == 2);
+
+  /* Of the tasks that are due, the high priority one runs first */
+  reset(200);
+  rtimer_set_priority(&a, 210, RTIMER_PRIORITY_NORMAL, task_a, NULL);
+  rtimer_set_priority(&b, 212, RTIMER_PRIORITY_HIGH, task_b, NULL);
+  fire(212);
+  CHECK(ran_b == 1);
+  CHECK(ran_a == 2);
+
+  printf("priority: %d %d\n", ran_a, ran_b);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  test_not_early();
+  test_min_delay();
+  test_priority();
+  CHECK(locked == 0);
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
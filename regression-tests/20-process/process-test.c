@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) (Year), (Name of copyright holder)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Host test of the process event queues
+ *
+ *         Events to a high priority process are delivered before the
+ *         events to normal ones. When the high priority queue is
+ *         full, the events of that process go to the normal queue and
+ *         must still be delivered in the order they were posted.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sys/process.h"
+
+static int failed;
+
+#define CHECK(cond) do {                                        \
+    if(!(cond)) {                                               \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failed = 1;                                               \
+    }                                                           \
+  } while(0)
+
+#define MAX_LOG 64
+
+/* The events that were delivered, in order: process and number */
+static struct {
+  char who;
+  int n;
+} delivered[MAX_LOG];
+static int ndelivered;
+/*---------------------------------------------------------------------------*/
+static void
+log_event(char who, process_event_t ev, process_data_t data)
+{
+  if(ev == PROCESS_EVENT_CONTINUE && ndelivered < MAX_LOG) {
+    delivered[ndelivered].who = who;
+    delivered[ndelivered].n = (int)(intptr_t)data;
+    ndelivered++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(high_process, "High");
+PROCESS_THREAD(high_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    log_event('h', ev, data);
+    PROCESS_YIELD();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(normal_process, "Normal");
+PROCESS_THREAD(normal_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    log_event('n', ev, data);
+    PROCESS_YIELD();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+post(struct process *p, int n)
+{
+  CHECK(process_post(p, PROCESS_EVENT_CONTINUE,
+                     (process_data_t)(intptr_t)n) == PROCESS_ERR_OK);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_all(void)
+{
+  ndelivered = 0;
+  while(process_run() > 0);
+}
+/*---------------------------------------------------------------------------*/
+/* The events of one process were delivered in the order posted */
+static int
+in_order(char who)
+{
+  int i, last;
+
+  last = -1;
+  for(i = 0; i < ndelivered; i++) {
+    if(delivered[i].who == who) {
+      if(delivered[i].n <= last) {
+        return 0;
+      }
+      last = delivered[i].n;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_high_first(void)
+{
+  post(&normal_process, 0);
+  post(&normal_process, 1);
+  post(&high_process, 0);
+  run_all();
+  CHECK(ndelivered == 3);
+  CHECK(delivered[0].who == 'h');
+  CHECK(in_order('n'));
+
+  printf("high first: %c%c%c\n", delivered[0].who, delivered[1].who,
+         delivered[2].who);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_spill_order(void)
+{
+  int i, n, overflows;
+
+  /* Fill the high priority queue, spill, and post more once it has
+     room again */
+  overflows = process_overflows[PROCESS_PRIORITY_HIGH];
+  n = 0;
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS_HIGH + 2; i++) {
+    post(&high_process, n++);
+    post(&normal_process, i);
+  }
+  /* The second one follows the first without trying the full queue */
+  CHECK(process_overflows[PROCESS_PRIORITY_HIGH] == overflows + 1);
+
+  ndelivered = 0;
+  process_run();
+  post(&high_process, n++);
+  post(&high_process, n++);
+  while(process_run() > 0);
+  CHECK(ndelivered == 2 * (PROCESS_CONF_NUMEVENTS_HIGH + 2) + 2);
+  CHECK(in_order('h'));
+  CHECK(in_order('n'));
+
+  /* Once the spilled events are delivered, the high priority queue
+     is used again */
+  post(&normal_process, 0);
+  post(&high_process, 0);
+  run_all();
+  CHECK(delivered[0].who == 'h');
+
+  printf("spill order: %d events\n", ndelivered);
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_set_priority(void)
+{
+  /* Events queued before the priority is raised come first */
+  process_set_priority(&high_process, PROCESS_PRIORITY_NORMAL);
+  post(&high_process, 0);
+  post(&high_process, 1);
+  process_set_priority(&high_process, PROCESS_PRIORITY_HIGH);
+  post(&high_process, 2);
+  run_all();
+  CHECK(ndelivered == 3);
+  CHECK(in_order('h'));
+
+  printf("set priority: %d events\n", ndelivered);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  process_init();
+  process_set_priority(&high_process, PROCESS_PRIORITY_HIGH);
+  process_start(&high_process, NULL);
+  process_start(&normal_process, NULL);
+  run_all();
+
+  test_high_first();
+  test_spill_order();
+  test_set_priority();
+  return failed;
+}
+/*---------------------------------------------------------------------------*/
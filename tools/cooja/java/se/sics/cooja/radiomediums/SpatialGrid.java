@@ -0,0 +1,134 @@
+package se.sics.cooja.radiomediums;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.HashMap;
+
+import se.sics.cooja.interfaces.Position;
+import se.sics.cooja.interfaces.Radio;
+
+/**
+ * Uniform grid over the x/y plane, used by radio mediums to find the radios
+ * near a position without iterating over all registered radios.
+ *
+ * Each radio is stored in the cell containing its position. With a cell size
+ * equal to the largest radio range, all radios within range of a position are
+ * found in the 3x3 cells around it. The z coordinate is ignored: the returned
+ * radios are a superset of the radios within range, callers still have to
+ * check the distance.
+ *
+ * @see UDGM
+ */
+public class SpatialGrid {
+  private final double cellSize;
+
+  private HashMap<Long, ArrayList<Radio>> cells = new HashMap<Long, ArrayList<Radio>>();
+  private HashMap<Radio, Long> radioCells = new HashMap<Radio, Long>();
+
+  /**
+   * @param cellSize Cell side, normally the largest radio range
+   */
+  public SpatialGrid(double cellSize) {
+    this.cellSize = cellSize > 0 ? cellSize : 1;
+  }
+
+  public double getCellSize() {
+    return cellSize;
+  }
+
+  private int cell(double coordinate) {
+    return (int) Math.floor(coordinate / cellSize);
+  }
+
+  private static long key(int cx, int cy) {
+    return ((long) cx << 32) | (cy & 0xffffffffL);
+  }
+
+  private long key(Position pos) {
+    return key(cell(pos.getXCoordinate()), cell(pos.getYCoordinate()));
+  }
+
+  /**
+   * Adds radio to the cell of its current position.
+   *
+   * @param radio Radio
+   */
+  public void add(Radio radio) {
+    if (radioCells.containsKey(radio)) {
+      return;
+    }
+    long k = key(radio.getPosition());
+    ArrayList<Radio> radios = cells.get(k);
+    if (radios == null) {
+      radios = new ArrayList<Radio>();
+      cells.put(k, radios);
+    }
+    radios.add(radio);
+    radioCells.put(radio, k);
+  }
+
+  /**
+   * Removes radio from the grid.
+   *
+   * @param radio Radio
+   * @return True if the radio was in the grid
+   */
+  public boolean remove(Radio radio) {
+    Long k = radioCells.remove(radio);
+    if (k == null) {
+      return false;
+    }
+    ArrayList<Radio> radios = cells.get(k);
+    radios.remove(radio);
+    if (radios.isEmpty()) {
+      cells.remove(k);
+    }
+    return true;
+  }
+
+  /**
+   * Moves radio to the cell of its current position. The radios around both
+   * the old and the new cell, whose neighbourhood may have changed, are added
+   * to affected.
+   *
+   * @param radio Radio
+   * @param affected Radios near the old or new position, or null
+   */
+  public void move(Radio radio, Collection<Radio> affected) {
+    Long old = radioCells.get(radio);
+    if (old != null && affected != null) {
+      collectCells((int) (old >> 32), (int) (long) old, 1, affected);
+    }
+    if (old == null || old != key(radio.getPosition())) {
+      remove(radio);
+      add(radio);
+    }
+    if (affected != null) {
+      collect(radio.getPosition(), cellSize, affected);
+    }
+  }
+
+  /**
+   * Adds all radios in the cells overlapping the square of side 2*range
+   * centered at pos.
+   *
+   * @param pos Center
+   * @param range Range
+   * @param out Collection to add the radios to
+   */
+  public void collect(Position pos, double range, Collection<Radio> out) {
+    int ring = (int) Math.ceil(range / cellSize);
+    collectCells(cell(pos.getXCoordinate()), cell(pos.getYCoordinate()), ring, out);
+  }
+
+  private void collectCells(int cx, int cy, int ring, Collection<Radio> out) {
+    for (int x = cx - ring; x <= cx + ring; x++) {
+      for (int y = cy - ring; y <= cy + ring; y++) {
+        ArrayList<Radio> radios = cells.get(key(x, y));
+        if (radios != null) {
+          out.addAll(radios);
+        }
+      }
+    }
+  }
+}
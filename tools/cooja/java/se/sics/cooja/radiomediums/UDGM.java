@@ -31,7 +31,11 @@
 package se.sics.cooja.radiomediums;
 
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Collection;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.HashSet;
 import java.util.Observable;
 import java.util.Observer;
 import java.util.Random;
@@ -40,9 +44,7 @@ import org.apache.log4j.Logger;
 import org.jdom.Element;
 
 import se.sics.cooja.ClassDescription;
-import se.sics.cooja.Mote;
 import se.sics.cooja.RadioConnection;
-import se.sics.cooja.SimEventCentral.MoteCountListener;
 import se.sics.cooja.Simulation;
 import se.sics.cooja.interfaces.Position;
 import se.sics.cooja.interfaces.Radio;
@@ -70,11 +72,15 @@ import se.sics.cooja.plugins.skins.UDGMVisualizerSkin;
  * The received radio packet signal strength grows inversely with the distance to the
  * transmitter.
  *
+ * Radios within range of each other are found through a uniform grid
+ * (cell size: the largest range), updated when motes move. Only the
+ * neighbourhoods of moved radios are recomputed.
+ *
  * @see #SS_STRONG
  * @see #SS_WEAK
  * @see #SS_NOTHING
  *
- * @see DirectedGraphMedium
+ * @see SpatialGrid
  * @see UDGMVisualizerSkin
  * @author Fredrik Osterlind
  */
@@ -87,61 +93,26 @@ public class UDGM extends AbstractRadioMedium {
   public double TRANSMITTING_RANGE = 50; /* Transmission range. */
   public double INTERFERENCE_RANGE = 100; /* Interference range. Ignored if below transmission range. */
 
-  private DirectedGraphMedium dgrm; /* Used only for efficient destination lookup */
+  private SpatialGrid grid = null; /* Rebuilt when the ranges change */
+  private HashMap<Radio, Radio[]> neighbours = new HashMap<Radio, Radio[]>(); /* Radios within range, per source */
+  private HashMap<Radio, Observer> positionObservers = new HashMap<Radio, Observer>();
+  private HashMap<Radio, Long> registrationOrder = new HashMap<Radio, Long>();
+  private long registrations = 0;
+  private ArrayList<Radio> signalRadios = new ArrayList<Radio>(); /* Radios given a signal strength */
+
+  /* Neighbours are listed in registration order, as the destinations of the
+   * full O(n^2) analysis were: keeps random draws, and simulations, unchanged */
+  private final Comparator<Radio> registrationComparator = new Comparator<Radio>() {
+    public int compare(Radio a, Radio b) {
+      return registrationOrder.get(a).compareTo(registrationOrder.get(b));
+    }
+  };
 
   private Random random = null;
 
   public UDGM(Simulation simulation) {
     super(simulation);
     random = simulation.getRandomGenerator();
-    dgrm = new DirectedGraphMedium() {
-      protected void analyzeEdges() {
-        /* Create edges according to distances.
-         * XXX May be slow for mobile networks */
-        clearEdges();
-        for (Radio source: UDGM.this.getRegisteredRadios()) {
-          Position sourcePos = source.getPosition();
-          for (Radio dest: UDGM.this.getRegisteredRadios()) {
-            Position destPos = dest.getPosition();
-            /* Ignore ourselves */
-            if (source == dest) {
-              continue;
-            }
-            double distance = sourcePos.getDistanceTo(destPos);
-            if (distance < Math.max(TRANSMITTING_RANGE, INTERFERENCE_RANGE)) {
-              /* Add potential destination */
-              addEdge(
-                  new DirectedGraphMedium.Edge(source, 
-                      new DGRMDestinationRadio(dest)));
-            }
-          }
-        }
-        super.analyzeEdges();
-      }
-    };
-
-    /* Register as position observer.
-     * If any positions change, re-analyze potential receivers. */
-    final Observer positionObserver = new Observer() {
-      public void update(Observable o, Object arg) {
-        dgrm.requestEdgeAnalysis();
-      }
-    };
-    /* Re-analyze potential receivers if radios are added/removed. */
-    simulation.getEventCentral().addMoteCountListener(new MoteCountListener() {
-      public void moteWasAdded(Mote mote) {
-        mote.getInterfaces().getPosition().addObserver(positionObserver);
-        dgrm.requestEdgeAnalysis();
-      }
-      public void moteWasRemoved(Mote mote) {
-        mote.getInterfaces().getPosition().deleteObserver(positionObserver);
-        dgrm.requestEdgeAnalysis();
-      }
-    });
-    for (Mote mote: simulation.getMotes()) {
-      mote.getInterfaces().getPosition().addObserver(positionObserver);
-    }
-    dgrm.requestEdgeAnalysis();
 
     /* Register visualizer skin */
     Visualizer.registerVisualizerSkin(UDGMVisualizerSkin.class);
@@ -155,12 +126,121 @@ public class UDGM extends AbstractRadioMedium {
   
   public void setTxRange(double r) {
     TRANSMITTING_RANGE = r;
-    dgrm.requestEdgeAnalysis();
+    invalidateGrid();
   }
 
   public void setInterferenceRange(double r) {
     INTERFERENCE_RANGE = r;
-    dgrm.requestEdgeAnalysis();
+    invalidateGrid();
+  }
+
+  public void registerRadioInterface(final Radio radio, Simulation sim) {
+    if (radio == null) {
+      super.registerRadioInterface(radio, sim);
+      return;
+    }
+    synchronized (this) {
+      registrationOrder.put(radio, registrations++);
+      if (grid != null) {
+        HashSet<Radio> affected = new HashSet<Radio>();
+        grid.move(radio, affected);
+        invalidateNeighbours(affected);
+      }
+    }
+
+    /* Recompute the neighbourhood of moved radios */
+    Observer positionObserver = new Observer() {
+      public void update(Observable o, Object arg) {
+        radioMoved(radio);
+      }
+    };
+    positionObservers.put(radio, positionObserver);
+    radio.getPosition().addObserver(positionObserver);
+
+    radio.setCurrentSignalStrength(SS_NOTHING);
+    super.registerRadioInterface(radio, sim);
+  }
+
+  public void unregisterRadioInterface(Radio radio, Simulation sim) {
+    super.unregisterRadioInterface(radio, sim);
+
+    Observer positionObserver = positionObservers.remove(radio);
+    if (positionObserver != null) {
+      radio.getPosition().deleteObserver(positionObserver);
+    }
+    synchronized (this) {
+      if (grid != null) {
+        HashSet<Radio> affected = new HashSet<Radio>();
+        grid.move(radio, affected);
+        grid.remove(radio);
+        invalidateNeighbours(affected);
+      }
+      neighbours.remove(radio);
+      registrationOrder.remove(radio);
+    }
+  }
+
+  private synchronized void radioMoved(Radio radio) {
+    if (grid == null || !registrationOrder.containsKey(radio)) {
+      return;
+    }
+    HashSet<Radio> affected = new HashSet<Radio>();
+    grid.move(radio, affected);
+    invalidateNeighbours(affected);
+  }
+
+  private void invalidateNeighbours(Collection<Radio> radios) {
+    for (Radio r: radios) {
+      neighbours.remove(r);
+    }
+  }
+
+  private synchronized void invalidateGrid() {
+    grid = null;
+    neighbours.clear();
+  }
+
+  /**
+   * Returns all radios within the largest of the transmission and
+   * interference ranges of source. Does not consider output power, radio
+   * channels, success ratios etc.
+   *
+   * @param source Source radio
+   * @return Radios in range, in registration order
+   */
+  private synchronized Radio[] getNeighbours(Radio source) {
+    double range = Math.max(TRANSMITTING_RANGE, INTERFERENCE_RANGE);
+
+    /* The range fields are public: also catch direct changes */
+    if (grid == null || grid.getCellSize() != (range > 0 ? range : 1)) {
+      grid = new SpatialGrid(range);
+      neighbours.clear();
+      for (Radio radio: getRegisteredRadios()) {
+        grid.add(radio);
+      }
+    }
+
+    Radio[] cached = neighbours.get(source);
+    if (cached != null) {
+      return cached;
+    }
+    ArrayList<Radio> candidates = new ArrayList<Radio>();
+    grid.collect(source.getPosition(), range, candidates);
+    ArrayList<Radio> inRange = new ArrayList<Radio>();
+    Position sourcePos = source.getPosition();
+    for (Radio dest: candidates) {
+      /* Ignore ourselves */
+      if (dest == source) {
+        continue;
+      }
+      if (sourcePos.getDistanceTo(dest.getPosition()) < range) {
+        inRange.add(dest);
+      }
+    }
+    Radio[] arr = inRange.toArray(new Radio[0]);
+    Arrays.sort(arr, registrationComparator);
+    neighbours.put(source, arr);
+    return arr;
   }
 
   public RadioConnection createConnections(Radio sender) {
@@ -178,15 +258,11 @@ public class UDGM extends AbstractRadioMedium {
     * ((double) sender.getCurrentOutputPowerIndicator() / (double) sender.getOutputPowerIndicatorMax());
 
     /* Get all potential destination radios */
-    DestinationRadio[] potentialDestinations = dgrm.getPotentialDestinations(sender);
-    if (potentialDestinations == null) {
-      return newConnection;
-    }
+    Radio[] potentialDestinations = getNeighbours(sender);
 
     /* Loop through all potential destinations */
     Position senderPos = sender.getPosition();
-    for (DestinationRadio dest: potentialDestinations) {
-      Radio recv = dest.radio;
+    for (Radio recv: potentialDestinations) {
 
       /* Fail if radios are on different (but configured) channels */ 
       if (sender.getChannel() >= 0 &&
@@ -274,18 +350,22 @@ public class UDGM extends AbstractRadioMedium {
   public void updateSignalStrengths() {
     /* Override: uses distance as signal strength factor */
     
-    /* Reset signal strengths */
-    for (Radio radio : getRegisteredRadios()) {
+    /* Reset signal strengths. Only radios of the previous connections
+     * can have one: do not iterate over all registered radios */
+    for (Radio radio : signalRadios) {
       radio.setCurrentSignalStrength(SS_NOTHING);
     }
+    signalRadios.clear();
 
     /* Set signal strength to below strong on destinations */
     RadioConnection[] conns = getActiveConnections();
     for (RadioConnection conn : conns) {
+      signalRadios.add(conn.getSource());
       if (conn.getSource().getCurrentSignalStrength() < SS_STRONG) {
         conn.getSource().setCurrentSignalStrength(SS_STRONG);
       }
       for (Radio dstRadio : conn.getDestinations()) {
+        signalRadios.add(dstRadio);
         if (conn.getSource().getChannel() >= 0 &&
             dstRadio.getChannel() >= 0 &&
             conn.getSource().getChannel() != dstRadio.getChannel()) {
@@ -308,6 +388,7 @@ public class UDGM extends AbstractRadioMedium {
     /* Set signal strength to below weak on interfered */
     for (RadioConnection conn : conns) {
       for (Radio intfRadio : conn.getInterfered()) {
+        signalRadios.add(intfRadio);
         if (conn.getSource().getChannel() >= 0 &&
             intfRadio.getChannel() >= 0 &&
             conn.getSource().getChannel() != intfRadio.getChannel()) {
@@ -0,0 +1,347 @@
+/**
+ * \file
+ *         Latency report from the dumps of the Contiki profiler.
+ *
+ *         Nodes built with PROFILE_CONF_ON print their profile with
+ *         profile_print(): a "P <hex>" line with the dump header,
+ *         then one per code section, in the format written by
+ *         profile_dump(). The tool reads Cooja loglistener files
+ *         ("mm:ss.mmm<TAB>ID:n<TAB>message") or plain serial output,
+ *         keeps the last dump of every node (the statistics on the
+ *         node are cumulative) and prints per section the number of
+ *         runs, the minimum, average and maximum duration and the
+ *         50th, 90th and 99th percentiles, read from the histogram as
+ *         the upper end of their bin. With -n the sections are also
+ *         printed per node. Section names come from sys/profile-ids.h;
+ *         sections added with PROFILE_CONF_USER_IDS are printed by
+ *         number.
+ *
+ *         Usage: profile-report [-n] log...
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile-ids.h"
+
+#define MAX_NODES 65536
+#define MAX_IDS   256
+#define MAX_BINS  32
+
+#define PROFILE_NAME(id, name) name,
+static const char *names[] = {
+  PROFILE_IDS(PROFILE_NAME)
+};
+#undef PROFILE_NAME
+
+struct section {
+  unsigned long count, sum;
+  unsigned long min, max;
+  unsigned long hist[MAX_BINS];
+};
+
+struct dump {
+  int seen, bins;
+  unsigned long second, dropped, unpaired;
+  struct section sections[MAX_IDS];
+};
+
+static struct dump *dumps[MAX_NODES];
+static int per_node;
+static unsigned long bad_lines;
+
+/*---------------------------------------------------------------------------*/
+static void *
+xcalloc(size_t n, size_t size)
+{
+  void *p = calloc(n, size);
+  if(p == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+get(const unsigned char **p, int bytes)
+{
+  unsigned long v = 0;
+  int i;
+
+  for(i = 0; i < bytes; i++) {
+    v |= (unsigned long)(*p)[i] << (8 * i);
+  }
+  *p += bytes;
+  return v;
+}
+/*---------------------------------------------------------------------------*/
+static int
+unhex(const char *s, unsigned char *buf, int max)
+{
+  int n = 0;
+  unsigned int b;
+
+  while(s[0] != '\0' && s[0] != '\n' && s[0] != '\r') {
+    if(n == max || sscanf(s, "%2x", &b) != 1 || s[1] == '\0') {
+      return -1;
+    }
+    buf[n++] = b;
+    s += 2;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode(int node, const char *hex)
+{
+  unsigned char buf[256];
+  const unsigned char *p, *end;
+  struct dump *d;
+  struct section *s;
+  unsigned long bitmap;
+  int n, i, id;
+
+  n = unhex(hex, buf, sizeof(buf));
+  if(n <= 0) {
+    bad_lines++;
+    return;
+  }
+  p = buf;
+  end = buf + n;
+  d = dumps[node];
+  if(n == 10) {
+    /* header: a new dump of the node */
+    if(buf[0] != PROFILE_DUMP_VERSION || buf[1] == 0 || buf[1] > MAX_BINS) {
+      bad_lines++;
+      return;
+    }
+    if(d == NULL) {
+      d = dumps[node] = xcalloc(1, sizeof(*d));
+    }
+    memset(d, 0, sizeof(*d));
+    d->seen = 1;
+    p += 2;
+    d->bins = buf[1];
+    d->second = get(&p, 4);
+    d->dropped = get(&p, 2);
+    d->unpaired = get(&p, 2);
+    return;
+  }
+  if(d == NULL || n < 15) {
+    bad_lines++;
+    return;
+  }
+  id = *p++;
+  s = &d->sections[id];
+  memset(s, 0, sizeof(*s));
+  s->count = get(&p, 4);
+  s->min = get(&p, 2);
+  s->max = get(&p, 2);
+  s->sum = get(&p, 4);
+  bitmap = get(&p, 2);
+  for(i = 0; i < d->bins; i++) {
+    if(bitmap & (1UL << i)) {
+      if(end - p < 2) {
+        bad_lines++;
+        s->count = 0;
+        return;
+      }
+      s->hist[i] = get(&p, 2);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_log(const char *file)
+{
+  char line[1024];
+  char *msg, *tab;
+  FILE *f;
+  int node;
+
+  f = fopen(file, "r");
+  if(f == NULL) {
+    fprintf(stderr, "%s: %s\n", file, strerror(errno));
+    exit(1);
+  }
+  while(fgets(line, sizeof(line), f) != NULL) {
+    node = 0;
+    msg = line;
+    tab = strchr(line, '\t');
+    if(tab != NULL && strncmp(tab + 1, "ID:", 3) == 0) {
+      node = atoi(tab + 4);
+      msg = strchr(tab + 1, '\t');
+      if(msg == NULL || node < 0 || node >= MAX_NODES) {
+        continue;
+      }
+      msg++;
+    }
+    if(msg[0] == 'P' && msg[1] == ' ') {
+      decode(node, msg + 2);
+    }
+  }
+  fclose(f);
+}
+/*---------------------------------------------------------------------------*/
+static double
+to_us(const struct dump *d, double ticks)
+{
+  return ticks * 1e6 / d->second;
+}
+/*---------------------------------------------------------------------------*/
+/* Upper end of the histogram bin holding the given fraction of runs,
+   at most the maximum */
+static unsigned long
+percentile(const struct section *s, int bins, double fraction)
+{
+  unsigned long n = 0, target;
+  int i;
+
+  target = (unsigned long)(fraction * s->count + 0.5);
+  if(target == 0) {
+    target = 1;
+  }
+  for(i = 0; i < bins - 1; i++) {
+    n += s->hist[i];
+    if(n >= target) {
+      return i == 0 ? 0 : ((1UL << i) - 1 < s->max ? (1UL << i) - 1 : s->max);
+    }
+  }
+  return s->max;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_header(void)
+{
+  printf("%-24s %6s %10s %10s %10s %10s %10s %10s %10s\n",
+         "section", "nodes", "runs", "min(us)", "avg(us)", "max(us)",
+         "p50(us)", "p90(us)", "p99(us)");
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_section(const char *label, int id, int nodes, const struct dump *d,
+              const struct section *s)
+{
+  char name[32];
+
+  if(id < (int)(sizeof(names) / sizeof(names[0]))) {
+    snprintf(name, sizeof(name), "%s%s", label, names[id]);
+  } else {
+    snprintf(name, sizeof(name), "%sid %d", label, id);
+  }
+  printf("%-24s %6d %10lu %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+         name, nodes, s->count, to_us(d, s->min),
+         to_us(d, (double)s->sum / s->count), to_us(d, s->max),
+         to_us(d, percentile(s, d->bins, 0.5)),
+         to_us(d, percentile(s, d->bins, 0.9)),
+         to_us(d, percentile(s, d->bins, 0.99)));
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(void)
+{
+  struct dump *total, *d = NULL;
+  struct section *t, *s;
+  unsigned long dropped = 0, unpaired = 0;
+  static int nodes[MAX_IDS];
+  int node, id, i, num_nodes = 0;
+
+  total = xcalloc(1, sizeof(*total));
+  for(node = 0; node < MAX_NODES; node++) {
+    d = dumps[node];
+    if(d == NULL || !d->seen) {
+      continue;
+    }
+    if(num_nodes == 0) {
+      total->bins = d->bins;
+      total->second = d->second;
+    } else if(d->bins != total->bins || d->second != total->second) {
+      fprintf(stderr, "node %d: dump format differs from the other nodes, skipped\n",
+              node);
+      continue;
+    }
+    num_nodes++;
+    dropped += d->dropped;
+    unpaired += d->unpaired;
+    for(id = 0; id < MAX_IDS; id++) {
+      s = &d->sections[id];
+      t = &total->sections[id];
+      if(s->count == 0) {
+        continue;
+      }
+      if(nodes[id] == 0 || s->min < t->min) {
+        t->min = s->min;
+      }
+      if(s->max > t->max) {
+        t->max = s->max;
+      }
+      t->count += s->count;
+      t->sum += s->sum;
+      for(i = 0; i < d->bins; i++) {
+        t->hist[i] += s->hist[i];
+      }
+      nodes[id]++;
+    }
+  }
+  if(num_nodes == 0) {
+    printf("no profile dumps\n");
+    free(total);
+    return;
+  }
+  printf("nodes: %d, clock: %lu Hz, dropped markers: %lu, unpaired markers: %lu",
+         num_nodes, total->second, dropped, unpaired);
+  if(bad_lines > 0) {
+    printf(", bad lines: %lu", bad_lines);
+  }
+  printf("\n");
+  print_header();
+  for(id = 0; id < MAX_IDS; id++) {
+    if(nodes[id] > 0) {
+      print_section("", id, nodes[id], total, &total->sections[id]);
+    }
+  }
+  if(per_node) {
+    for(node = 0; node < MAX_NODES; node++) {
+      d = dumps[node];
+      if(d == NULL || !d->seen || d->bins != total->bins ||
+         d->second != total->second) {
+        continue;
+      }
+      printf("\nnode %d: dropped markers: %lu, unpaired markers: %lu\n",
+             node, d->dropped, d->unpaired);
+      for(id = 0; id < MAX_IDS; id++) {
+        if(d->sections[id].count > 0) {
+          print_section("  ", id, 1, d, &d->sections[id]);
+        }
+      }
+    }
+  }
+  free(total);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int i;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if(strcmp(argv[i], "-n") == 0) {
+      per_node = 1;
+    } else {
+      break;
+    }
+  }
+  if(i >= argc) {
+    fprintf(stderr, "Usage: profile-report [-n] log...\n");
+    fprintf(stderr, "       -n also print the sections of every node\n");
+    return 2;
+  }
+  for(; i < argc; i++) {
+    read_log(argv[i]);
+  }
+  report();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
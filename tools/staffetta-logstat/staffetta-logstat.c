@@ -0,0 +1,666 @@
+/**
+ * \file
+ *         Single-pass analyzer for Staffetta experiment logs.
+ *
+ *         Reads Cooja loglistener files ("mm:ss.mmm<TAB>ID:n<TAB>message")
+ *         through mmap and decodes the Staffetta report lines:
+ *           2 src wakeups        wakeup frequency after an ack from src
+ *           3 duty queue         periodic duty cycle (per mill) and queue size
+ *           4 node seq           packet 'seq' generated by 'node'
+ *           5 src dst            packet forwarded from src to dst
+ *           6 power duty         power (uW) and duty cycle (per mill)
+ *           9 total backoff ...  radio energy (uJ), in total and per phase
+ *           10 loops hops expired
+ *                                packets received again after forwarding them,
+ *                                dropped at the hop limit and for their age
+ *         and, on the node that printed "Sink active", the deliveries
+ *         "origin seq hops [count]". Per file it prints the PDR, the
+ *         delivery latency (from the "4" line of a packet to its first
+ *         delivery), the per-node power and duty cycle, the average
+ *         radio energy of each Staffetta phase, the loop and drop
+ *         counters summed over the nodes, the hop
+ *         distribution and the per-link forward counts. Files are
+ *         processed in parallel.
+ *
+ *         Usage: staffetta-logstat [-j jobs] [-t seconds] loglistener*.txt
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_FIELDS 8
+#define MAX_HOPS   256
+#define NUM_PHASES 7    /* fields of a "9" line: total and the six phases */
+
+static const char *phase_names[NUM_PHASES] = {
+  "total", "backoff", "strobe", "strobe wait", "ack", "select", "fast forward"
+};
+
+/* Sequence numbers are 8 bits, extend them to count wrapped ones apart */
+struct seq_ext {
+  unsigned long base;
+  unsigned char max;
+  unsigned char init;
+};
+
+struct node {
+  unsigned char seen, is_sink;
+  long power, duty, wakeups, queue;
+  unsigned long power_reports, duty_reports, energy_reports, forwards;
+  long energy[NUM_PHASES];
+  long loops, dropped_hops, dropped_expired;
+  struct seq_ext gen, del;
+};
+
+/* Open-addressing hash set of 64-bit keys, key 0 is never stored */
+struct set {
+  unsigned long long *keys;
+  double *times;        /* time the key was added */
+  size_t size, count;
+};
+
+struct latencies {
+  double *v;
+  size_t count, cap;
+};
+
+struct link {
+  unsigned long long key;
+  unsigned long count;
+};
+
+struct links {
+  struct link *slots;
+  size_t size, count;
+};
+
+struct result {
+  const char *file;
+  char *text;
+  size_t len, cap;
+  int error;
+};
+
+static double cutoff = -1;
+static char **files;
+static int num_files, next_file;
+static struct result *results;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+/*---------------------------------------------------------------------------*/
+static void *
+xcalloc(size_t n, size_t size)
+{
+  void *p = calloc(n, size);
+  if(p == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+hash64(unsigned long long k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  return (size_t)k;
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_add(struct set *s, unsigned long long key, double t)
+{
+  size_t i, j, old_size;
+  unsigned long long *old;
+  double *old_times;
+
+  if((s->count + 1) * 2 > s->size) {
+    old = s->keys;
+    old_times = s->times;
+    old_size = s->size;
+    s->size = old_size ? old_size * 2 : 1024;
+    s->keys = xcalloc(s->size, sizeof(*s->keys));
+    s->times = xcalloc(s->size, sizeof(*s->times));
+    for(i = 0; i < old_size; i++) {
+      if(old[i] != 0) {
+        for(j = hash64(old[i]) & (s->size - 1); s->keys[j] != 0;
+            j = (j + 1) & (s->size - 1));
+        s->keys[j] = old[i];
+        s->times[j] = old_times[i];
+      }
+    }
+    free(old);
+    free(old_times);
+  }
+  for(i = hash64(key) & (s->size - 1); s->keys[i] != 0;
+      i = (i + 1) & (s->size - 1)) {
+    if(s->keys[i] == key) {
+      return 0;
+    }
+  }
+  s->keys[i] = key;
+  s->times[i] = t;
+  s->count++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Time key was added to s, or -1 */
+static double
+set_time(const struct set *s, unsigned long long key)
+{
+  size_t i;
+
+  if(s->size == 0) {
+    return -1;
+  }
+  for(i = hash64(key) & (s->size - 1); s->keys[i] != 0;
+      i = (i + 1) & (s->size - 1)) {
+    if(s->keys[i] == key) {
+      return s->times[i];
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+latency_add(struct latencies *l, double v)
+{
+  if(l->count == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 1024;
+    l->v = realloc(l->v, l->cap * sizeof(*l->v));
+    if(l->v == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  l->v[l->count++] = v;
+}
+/*---------------------------------------------------------------------------*/
+static void
+links_add(struct links *l, unsigned long long key)
+{
+  size_t i, j, old_size;
+  struct link *old;
+
+  if((l->count + 1) * 2 > l->size) {
+    old = l->slots;
+    old_size = l->size;
+    l->size = old_size ? old_size * 2 : 256;
+    l->slots = xcalloc(l->size, sizeof(*l->slots));
+    for(i = 0; i < old_size; i++) {
+      if(old[i].key != 0) {
+        for(j = hash64(old[i].key) & (l->size - 1); l->slots[j].key != 0;
+            j = (j + 1) & (l->size - 1));
+        l->slots[j] = old[i];
+      }
+    }
+    free(old);
+  }
+  for(i = hash64(key) & (l->size - 1); l->slots[i].key != 0;
+      i = (i + 1) & (l->size - 1)) {
+    if(l->slots[i].key == key) {
+      l->slots[i].count++;
+      return;
+    }
+  }
+  l->slots[i].key = key;
+  l->slots[i].count = 1;
+  l->count++;
+}
+/*---------------------------------------------------------------------------*/
+static int
+double_cmp(const void *a, const void *b)
+{
+  const double *x = a, *y = b;
+  return *x < *y ? -1 : *x > *y;
+}
+/*---------------------------------------------------------------------------*/
+static int
+link_cmp(const void *a, const void *b)
+{
+  const struct link *x = a, *y = b;
+  return x->key < y->key ? -1 : x->key > y->key;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+seq_extend(struct seq_ext *e, unsigned seq)
+{
+  unsigned char s = seq & 0xff;
+
+  if(!e->init) {
+    e->init = 1;
+    e->max = s;
+  } else if((signed char)(s - e->max) > 0) {
+    if(s < e->max) {
+      e->base += 256;
+    }
+    e->max = s;
+  } else if(s > e->max && e->base >= 256) {
+    /* late packet from before the last wrap */
+    return e->base - 256 + s;
+  }
+  return e->base + s;
+}
+/*---------------------------------------------------------------------------*/
+static void
+out(struct result *r, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  for(;;) {
+    va_start(ap, fmt);
+    n = vsnprintf(r->text + r->len, r->cap - r->len, fmt, ap);
+    va_end(ap);
+    if(n >= 0 && r->len + n < r->cap) {
+      r->len += n;
+      return;
+    }
+    r->cap = r->cap ? r->cap * 2 + n : 4096;
+    r->text = realloc(r->text, r->cap);
+    if(r->text == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Parse "[hh:]mm:ss.mmm" into seconds */
+static double
+parse_time(const char *p, const char *end)
+{
+  double t = 0, frac = 0, scale = 0.1;
+  unsigned long v = 0;
+
+  for(; p < end; p++) {
+    if(*p >= '0' && *p <= '9') {
+      v = v * 10 + (*p - '0');
+    } else if(*p == ':') {
+      t = (t + v) * 60;
+      v = 0;
+    } else if(*p == '.') {
+      for(p++; p < end && *p >= '0' && *p <= '9'; p++, scale /= 10) {
+        frac += (*p - '0') * scale;
+      }
+      break;
+    }
+  }
+  return t + v + frac;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse up to MAX_FIELDS unsigned numbers. Return -1 if the message is not numeric */
+static int
+parse_fields(const char *p, const char *end, long *v)
+{
+  int n = 0;
+
+  while(p < end) {
+    while(p < end && (*p == ' ' || *p == '\r')) {
+      p++;
+    }
+    if(p == end) {
+      break;
+    }
+    if(*p < '0' || *p > '9' || n == MAX_FIELDS) {
+      return -1;
+    }
+    v[n] = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+      v[n] = v[n] * 10 + (*p - '0');
+    }
+    if(p < end && *p != ' ' && *p != '\r') {
+      return -1;
+    }
+    n++;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static struct node *
+get_node(struct node **nodes, long *num, long id)
+{
+  long n;
+
+  if(id >= *num) {
+    n = *num ? *num : 64;
+    while(n <= id) {
+      n *= 2;
+    }
+    *nodes = realloc(*nodes, n * sizeof(**nodes));
+    if(*nodes == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+    memset(*nodes + *num, 0, (n - *num) * sizeof(**nodes));
+    *num = n;
+  }
+  (*nodes)[id].seen = 1;
+  return &(*nodes)[id];
+}
+/*---------------------------------------------------------------------------*/
+static void
+analyze(struct result *r)
+{
+  int fd, nf;
+  struct stat st;
+  const char *buf, *p, *end, *eol, *tab1, *tab2;
+  struct node *nodes = NULL, *n;
+  long num_nodes = 0, id, v[MAX_FIELDS], i;
+  struct set generated = { NULL, NULL, 0, 0 }, delivered = { NULL, NULL, 0, 0 };
+  struct links links = { NULL, 0, 0 };
+  struct latencies latency = { NULL, 0, 0 };
+  unsigned long long key;
+  unsigned long hops[MAX_HOPS] = { 0 }, max_hops = 0, duplicates = 0;
+  unsigned long loops, dropped_hops, dropped_expired;
+  unsigned long power_nodes = 0, duty_nodes = 0, energy_nodes, lines = 0;
+  double sum = 0, sumsq = 0, duty_sum = 0, latency_sum = 0, mw, avg, var, t, t0;
+
+  fd = open(r->file, O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) < 0) {
+    out(r, "file: %s\nerror: %s\n\n", r->file, strerror(errno));
+    r->error = 1;
+    if(fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+  buf = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+  if(buf == MAP_FAILED) {
+    out(r, "file: %s\nerror: %s\n\n", r->file, strerror(errno));
+    r->error = 1;
+    close(fd);
+    return;
+  }
+  madvise((void *)buf, st.st_size, MADV_SEQUENTIAL);
+  end = buf + st.st_size;
+
+  for(p = buf; p < end; p = eol + 1) {
+    eol = memchr(p, '\n', end - p);
+    if(eol == NULL) {
+      eol = end;
+    }
+    lines++;
+    tab1 = memchr(p, '\t', eol - p);
+    if(tab1 == NULL || eol - tab1 < 5 || memcmp(tab1 + 1, "ID:", 3) != 0) {
+      continue;
+    }
+    t = parse_time(p, tab1);
+    if(cutoff >= 0 && t >= cutoff) {
+      break;
+    }
+    tab2 = memchr(tab1 + 1, '\t', eol - tab1 - 1);
+    if(tab2 == NULL) {
+      continue;
+    }
+    id = strtol(tab1 + 4, NULL, 10);
+    if(id < 0 || id > 65535) {
+      continue;
+    }
+    n = get_node(&nodes, &num_nodes, id);
+    nf = parse_fields(tab2 + 1, eol, v);
+    if(nf < 0) {
+      if(eol - tab2 > 11 && memcmp(tab2 + 1, "Sink active", 11) == 0) {
+        n->is_sink = 1;
+      }
+      continue;
+    }
+    if(n->is_sink) {
+      /* deliveries: origin seq hops [count]; 7 and 8 are sink reports */
+      if(nf == 3 || nf == 4) {
+        if(v[0] > 65535) {
+          continue;
+        }
+        key = ((unsigned long long)(v[0] + 1) << 32) |
+          seq_extend(&get_node(&nodes, &num_nodes, v[0])->del, v[1]);
+        if(set_add(&delivered, key, t)) {
+          t0 = set_time(&generated, key);
+          if(t0 >= 0 && t >= t0) {
+            latency_add(&latency, t - t0);
+            latency_sum += t - t0;
+          }
+          i = v[2] < MAX_HOPS ? v[2] : MAX_HOPS - 1;
+          hops[i]++;
+          if((unsigned long)i > max_hops) {
+            max_hops = i;
+          }
+        } else {
+          duplicates++;
+        }
+        n = &nodes[id];
+      }
+      continue;
+    }
+    if(nf < 2) {
+      continue;
+    }
+    switch(v[0]) {
+    case 2:
+      n->wakeups = v[2 < nf ? 2 : 1];
+      break;
+    case 3:
+      if(nf >= 3) {
+        n->duty = v[1];
+        n->queue = v[2];
+        n->duty_reports++;
+      }
+      break;
+    case 4:
+      if(nf >= 3 && v[1] <= 65535) {
+        set_add(&generated, ((unsigned long long)(v[1] + 1) << 32) |
+                seq_extend(&get_node(&nodes, &num_nodes, v[1])->gen, v[2]), t);
+        n = &nodes[id];
+      }
+      break;
+    case 5:
+      if(nf >= 3 && v[1] <= 65535 && v[2] <= 65535) {
+        links_add(&links, ((unsigned long long)(v[1] + 1) << 32) | v[2]);
+        n->forwards++;
+      }
+      break;
+    case 6:
+      if(nf >= 3) {
+        n->power = v[1];
+        n->duty = v[2];
+        n->power_reports++;
+        n->duty_reports++;
+      }
+      break;
+    case 9:
+      if(nf >= NUM_PHASES + 1) {
+        memcpy(n->energy, &v[1], sizeof(n->energy));
+        n->energy_reports++;
+      }
+      break;
+    case 10:
+      if(nf >= 4) {
+        n->loops = v[1];
+        n->dropped_hops = v[2];
+        n->dropped_expired = v[3];
+      }
+      break;
+    }
+  }
+  if(st.st_size) {
+    munmap((void *)buf, st.st_size);
+  }
+  close(fd);
+
+  out(r, "file: %s\n", r->file);
+  out(r, "lines: %lu\n", lines);
+  out(r, "generated: %lu\n", (unsigned long)generated.count);
+  out(r, "delivered: %lu\n", (unsigned long)delivered.count);
+  out(r, "duplicates: %lu\n", duplicates);
+  out(r, "pdr: %.4f\n", generated.count ?
+      (double)delivered.count / generated.count : 0.0);
+  if(latency.count > 0) {
+    qsort(latency.v, latency.count, sizeof(*latency.v), double_cmp);
+    out(r, "avg latency: %.3f\n", latency_sum / latency.count);
+    out(r, "p95 latency: %.3f\n", latency.v[(latency.count * 95 - 1) / 100]);
+  } else {
+    out(r, "avg latency: 0.000\np95 latency: 0.000\n");
+  }
+  for(id = 0; id < num_nodes; id++) {
+    if(nodes[id].power_reports > 0) {
+      mw = nodes[id].power / 1000.0;
+      sum += mw;
+      sumsq += mw * mw;
+      power_nodes++;
+    }
+    if(nodes[id].duty_reports > 0 && !nodes[id].is_sink) {
+      duty_sum += nodes[id].duty;
+      duty_nodes++;
+    }
+  }
+  avg = power_nodes ? sum / power_nodes : 0;
+  var = power_nodes ? sumsq / power_nodes - avg * avg : 0;
+  out(r, "avg power: %.3f\n", avg);
+  out(r, "var power: %.3f\n", var < 0 ? 0 : var);
+  out(r, "avg duty: %.1f\n", duty_nodes ? duty_sum / duty_nodes : 0.0);
+  for(i = 0; i < NUM_PHASES; i++) {
+    sum = 0;
+    energy_nodes = 0;
+    for(id = 0; id < num_nodes; id++) {
+      if(nodes[id].energy_reports > 0 && !nodes[id].is_sink) {
+        sum += nodes[id].energy[i] / 1000.0;
+        energy_nodes++;
+      }
+    }
+    out(r, "avg energy %s: %.3f\n", phase_names[i],
+        energy_nodes ? sum / energy_nodes : 0.0);
+  }
+  loops = dropped_hops = dropped_expired = 0;
+  for(id = 0; id < num_nodes; id++) {
+    loops += nodes[id].loops;
+    dropped_hops += nodes[id].dropped_hops;
+    dropped_expired += nodes[id].dropped_expired;
+  }
+  out(r, "loops: %lu\n", loops);
+  out(r, "dropped hops: %lu\n", dropped_hops);
+  out(r, "dropped expired: %lu\n", dropped_expired);
+  for(id = 0; id < num_nodes; id++) {
+    n = &nodes[id];
+    if(n->seen && (n->power_reports > 0 || n->forwards > 0 || n->is_sink)) {
+      out(r, "node %ld%s power %.3f duty %ld wakeups %ld queue %ld forwards %lu\n",
+          id, n->is_sink ? " sink" : "", n->power / 1000.0, n->duty,
+          n->wakeups, n->queue, n->forwards);
+    }
+  }
+  for(i = 0; i <= (long)max_hops; i++) {
+    if(hops[i] > 0) {
+      out(r, "hops %ld %lu\n", i, hops[i]);
+    }
+  }
+  if(links.count > 0) {
+    struct link *sorted = xcalloc(links.count, sizeof(*sorted));
+    size_t k, m = 0;
+    for(k = 0; k < links.size; k++) {
+      if(links.slots[k].key != 0) {
+        sorted[m++] = links.slots[k];
+      }
+    }
+    qsort(sorted, m, sizeof(*sorted), link_cmp);
+    for(k = 0; k < m; k++) {
+      out(r, "link %llu %llu %lu\n", (sorted[k].key >> 32) - 1,
+          sorted[k].key & 0xffffffffULL, sorted[k].count);
+    }
+    free(sorted);
+  }
+  out(r, "\n");
+
+  free(nodes);
+  free(generated.keys);
+  free(generated.times);
+  free(delivered.keys);
+  free(delivered.times);
+  free(latency.v);
+  free(links.slots);
+}
+/*---------------------------------------------------------------------------*/
+static void *
+worker(void *arg)
+{
+  int i;
+
+  for(;;) {
+    pthread_mutex_lock(&next_lock);
+    i = next_file++;
+    pthread_mutex_unlock(&next_lock);
+    if(i >= num_files) {
+      return NULL;
+    }
+    analyze(&results[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+usage(void)
+{
+  fprintf(stderr, "Usage: staffetta-logstat [-j jobs] [-t seconds] loglistener*.txt\n");
+  fprintf(stderr, "       -j number of files analyzed in parallel (default: cores)\n");
+  fprintf(stderr, "       -t ignore log lines after this many seconds\n");
+  return 2;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int i, c, jobs, error = 0;
+  pthread_t *threads;
+
+  jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while((c = getopt(argc, argv, "j:t:")) != -1) {
+    switch(c) {
+    case 'j':
+      jobs = atoi(optarg);
+      break;
+    case 't':
+      cutoff = atof(optarg);
+      break;
+    default:
+      return usage();
+    }
+  }
+  if(optind >= argc) {
+    return usage();
+  }
+  files = &argv[optind];
+  num_files = argc - optind;
+  results = xcalloc(num_files, sizeof(*results));
+  for(i = 0; i < num_files; i++) {
+    results[i].file = files[i];
+  }
+  if(jobs < 1) {
+    jobs = 1;
+  }
+  if(jobs > num_files) {
+    jobs = num_files;
+  }
+  threads = xcalloc(jobs, sizeof(*threads));
+  for(i = 0; i < jobs; i++) {
+    if(pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+      perror("pthread_create");
+      return 1;
+    }
+  }
+  for(i = 0; i < jobs; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  /* print in command line order, whatever order the files completed in */
+  for(i = 0; i < num_files; i++) {
+    fwrite(results[i].text, 1, results[i].len, stdout);
+    error |= results[i].error;
+    free(results[i].text);
+  }
+  free(results);
+  free(threads);
+  return error;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,891 @@
+/**
+ * \file
+ *         Live metrics daemon for Staffetta deployments.
+ *
+ *         Reads the serial output of many motes at once, from serial
+ *         ports, Cooja serial sockets (tools/cooja/apps/serial_socket),
+ *         log files or stdin, with nonblocking I/O in a single poll()
+ *         loop. It decodes the lines staffetta-logstat knows about:
+ *           2 src wakeups        wakeup frequency after an ack from src
+ *           3 duty queue         periodic duty cycle (per mill) and queue size
+ *           4 node seq           packet 'seq' generated by 'node'
+ *           5 src dst            packet forwarded from src to dst
+ *           6 power duty         power (uW) and duty cycle (per mill)
+ *           9 total backoff ...  radio energy (uJ), in total and per phase
+ *         the deliveries "origin seq hops [count]" of the node that
+ *         printed "Sink active", and the powertrace "P" lines. Per node
+ *         it keeps the last reports, a moving average of the duty cycle
+ *         and the packets generated, forwarded and delivered in the last
+ *         minute.
+ *
+ *         A snapshot of these aggregates is written to a file every few
+ *         seconds (-f, replaced atomically) and to every client of a
+ *         local socket (-u), e.g. "socat - UNIX-CONNECT:/tmp/staffetta".
+ *
+ *         Sources:
+ *           /dev/ttyUSB0[=id]    serial port, at the -b speed
+ *           host:port[=id]       TCP, e.g. a Cooja serial socket; ports
+ *                                60001 and up default to node port-60000
+ *           file[=id], -         log file or stdin, read once
+ *         Lines in the loglistener format ("time<TAB>ID:n<TAB>message")
+ *         carry their node id; other lines belong to the source's id,
+ *         to the address of a powertrace line or to the node of a "4"
+ *         line. Serial ports and sockets are reopened when they fail.
+ *         When only files were given, the daemon prints the final
+ *         snapshot and exits at their end.
+ */
+
+#define _GNU_SOURCE /* accept4() */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_FIELDS   8
+#define MAX_LINE     512
+#define MAX_CLIENTS  16
+#define NUM_PHASES   7    /* fields of a "9" line: total and the six phases */
+#define RATE_SLOT    10   /* seconds per rate slot */
+#define RATE_SLOTS   6    /* rates are over the last RATE_SLOT*RATE_SLOTS seconds */
+#define RETRY_TIME   2.0  /* seconds before reopening a failed port or socket */
+#define DUTY_WEIGHT  0.25 /* weight of a new report in the duty cycle average */
+#define COOJA_PORT   60000
+
+static const char *phase_names[NUM_PHASES] = {
+  "total", "backoff", "strobe", "strobe_wait", "ack", "select", "fast_forward"
+};
+
+enum source_kind { SOURCE_SERIAL, SOURCE_TCP, SOURCE_FILE };
+
+struct source {
+  const char *spec;
+  enum source_kind kind;
+  char *path, *host, *port;
+  long id;              /* node of lines without an ID, -1 if unknown */
+  int fd;
+  int done;             /* files only: reached the end */
+  double retry;         /* when to reopen a failed port or socket */
+  unsigned long lines, errors;
+  size_t len;
+  char buf[MAX_LINE];
+};
+
+/* Events counted over the last RATE_SLOTS slots */
+struct rate {
+  unsigned long count[RATE_SLOTS];
+  long slot;
+};
+
+struct node {
+  unsigned char seen, is_sink, has_duty, has_power, has_energy, has_pt;
+  double last;          /* host time of the last line */
+  unsigned long lines;
+  long duty, power, wakeups, queue;
+  double duty_avg;
+  long energy[NUM_PHASES];
+  unsigned long generated, forwards, delivered;
+  struct rate generated_rate, forward_rate, delivered_rate;
+  /* powertrace, radio on time over the last interval in per mill */
+  unsigned long pt_seqno;
+  long pt_radio, pt_tx, pt_listen;
+};
+
+struct client {
+  int fd;
+  char *buf;
+  size_t len, off;
+};
+
+static struct source *sources;
+static int num_sources;
+static struct node *nodes;
+static long num_nodes;
+static struct client clients[MAX_CLIENTS];
+static int listen_fd = -1;
+
+static speed_t baudrate = B115200;
+static const char *snapshot_file, *socket_path;
+static double snapshot_period = 5, stale_time = 300, start_time;
+static unsigned long unattributed;
+static volatile sig_atomic_t stop;
+/*---------------------------------------------------------------------------*/
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+xrealloc(void *p, size_t size)
+{
+  p = realloc(p, size);
+  if(p == NULL) {
+    perror("realloc");
+    exit(1);
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static struct node *
+get_node(long id)
+{
+  long n;
+
+  if(id >= num_nodes) {
+    n = num_nodes ? num_nodes : 64;
+    while(n <= id) {
+      n *= 2;
+    }
+    nodes = xrealloc(nodes, n * sizeof(*nodes));
+    memset(nodes + num_nodes, 0, (n - num_nodes) * sizeof(*nodes));
+    num_nodes = n;
+  }
+  nodes[id].seen = 1;
+  return &nodes[id];
+}
+/*---------------------------------------------------------------------------*/
+static void
+rate_advance(struct rate *r, double t)
+{
+  long slot = (long)(t / RATE_SLOT);
+
+  if(slot - r->slot >= RATE_SLOTS) {
+    memset(r->count, 0, sizeof(r->count));
+  } else {
+    while(r->slot < slot) {
+      r->count[++r->slot % RATE_SLOTS] = 0;
+    }
+  }
+  r->slot = slot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rate_add(struct rate *r, double t)
+{
+  rate_advance(r, t);
+  r->count[r->slot % RATE_SLOTS]++;
+}
+/*---------------------------------------------------------------------------*/
+/* Events per minute over the last RATE_SLOTS slots */
+static double
+rate_get(struct rate *r, double t)
+{
+  unsigned long sum = 0;
+  int i;
+
+  rate_advance(r, t);
+  for(i = 0; i < RATE_SLOTS; i++) {
+    sum += r->count[i];
+  }
+  return sum * 60.0 / (RATE_SLOT * RATE_SLOTS);
+}
+/*---------------------------------------------------------------------------*/
+/* Parse up to MAX_FIELDS unsigned numbers. Return -1 if the message is not numeric */
+static int
+parse_fields(const char *p, const char *end, long *v)
+{
+  int n = 0;
+
+  while(p < end) {
+    while(p < end && (*p == ' ' || *p == '\r')) {
+      p++;
+    }
+    if(p == end) {
+      break;
+    }
+    if(*p < '0' || *p > '9' || n == MAX_FIELDS) {
+      return -1;
+    }
+    v[n] = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+      v[n] = v[n] * 10 + (*p - '0');
+    }
+    if(p < end && *p != ' ' && *p != '\r') {
+      return -1;
+    }
+    n++;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * powertrace: "[str] clock P a.b seqno all_cpu all_lpm all_transmit
+ * all_listen all_idle_transmit all_idle_listen cpu lpm transmit listen
+ * idle_transmit idle_listen (...)". Return the node address a, or -1.
+ */
+static long
+parse_powertrace(const char *p, const char *end, long id, double t)
+{
+  unsigned long v[13];
+  const char *tok;
+  char *e;
+  long addr;
+  int i;
+  struct node *n;
+
+  for(; p + 3 <= end; p++) {
+    if(memcmp(p, " P ", 3) == 0) {
+      break;
+    }
+  }
+  if(p + 3 > end) {
+    return -1;
+  }
+  tok = p + 3;
+  addr = strtol(tok, &e, 10);
+  if(e == tok || *e != '.' || addr < 0 || addr > 255) {
+    return -1;
+  }
+  strtol(e + 1, &e, 10);
+  for(i = 0; i < 13 && e < end; i++) {
+    tok = e;
+    v[i] = strtoul(tok, &e, 10);
+    if(e == tok) {
+      break;
+    }
+  }
+  if(i < 13) {
+    return -1;
+  }
+  n = get_node(id >= 0 ? id : addr);
+  n->has_pt = 1;
+  n->pt_seqno = v[0];
+  /* v[0] is the seqno, v[1..6] the totals and v[7..12] the last interval */
+  if(v[7] + v[8] > 0) {
+    n->pt_radio = (long)((1000.0 * (v[9] + v[10])) / (v[7] + v[8]));
+    n->pt_tx = (long)((1000.0 * v[9]) / (v[7] + v[8]));
+    n->pt_listen = (long)((1000.0 * v[10]) / (v[7] + v[8]));
+  }
+  n->last = t;
+  n->lines++;
+  return addr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+process_line(struct source *s, const char *p, const char *end, double t)
+{
+  const char *tab1, *tab2;
+  struct node *n;
+  long id, v[MAX_FIELDS];
+  int nf;
+
+  id = s->id;
+  /* loglistener format: time<TAB>ID:n<TAB>message */
+  tab1 = memchr(p, '\t', end - p);
+  if(tab1 != NULL && end - tab1 > 4 && memcmp(tab1 + 1, "ID:", 3) == 0) {
+    tab2 = memchr(tab1 + 1, '\t', end - tab1 - 1);
+    if(tab2 != NULL) {
+      id = strtol(tab1 + 4, NULL, 10);
+      p = tab2 + 1;
+    }
+  }
+  if(id > 65535) {
+    return;
+  }
+  nf = parse_fields(p, end, v);
+  if(nf < 0) {
+    if(parse_powertrace(p, end, id, t) >= 0) {
+      return;
+    }
+    if(id >= 0 && end - p >= 11 && memcmp(p, "Sink active", 11) == 0) {
+      get_node(id)->is_sink = 1;
+    }
+    if(id >= 0) {
+      n = get_node(id);
+      n->last = t;
+      n->lines++;
+    }
+    return;
+  }
+  if(id < 0) {
+    /* only a "4 node seq" line tells where it comes from */
+    if(nf >= 3 && v[0] == 4 && v[1] <= 65535) {
+      id = v[1];
+    } else {
+      unattributed++;
+      return;
+    }
+  }
+  n = get_node(id);
+  n->last = t;
+  n->lines++;
+  if(n->is_sink) {
+    /* deliveries: origin seq hops [count]; 7 and 8 are sink reports */
+    if((nf == 3 || nf == 4) && v[0] <= 65535) {
+      n = get_node(v[0]);
+      n->delivered++;
+      rate_add(&n->delivered_rate, t);
+    }
+    return;
+  }
+  if(nf < 2) {
+    return;
+  }
+  switch(v[0]) {
+  case 2:
+    n->wakeups = v[2 < nf ? 2 : 1];
+    break;
+  case 3:
+    if(nf >= 3) {
+      n->duty = v[1];
+      n->queue = v[2];
+      n->duty_avg = n->has_duty ?
+        n->duty_avg + DUTY_WEIGHT * (v[1] - n->duty_avg) : v[1];
+      n->has_duty = 1;
+    }
+    break;
+  case 4:
+    if(nf >= 3 && v[1] <= 65535) {
+      n = get_node(v[1]);
+      n->generated++;
+      rate_add(&n->generated_rate, t);
+    }
+    break;
+  case 5:
+    if(nf >= 3) {
+      n->forwards++;
+      rate_add(&n->forward_rate, t);
+    }
+    break;
+  case 6:
+    if(nf >= 3) {
+      n->power = v[1];
+      n->has_power = 1;
+      n->duty = v[2];
+      n->duty_avg = n->has_duty ?
+        n->duty_avg + DUTY_WEIGHT * (v[2] - n->duty_avg) : v[2];
+      n->has_duty = 1;
+    }
+    break;
+  case 9:
+    if(nf >= NUM_PHASES + 1) {
+      memcpy(n->energy, &v[1], sizeof(n->energy));
+      n->has_energy = 1;
+    }
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_serial(struct source *s)
+{
+  struct termios tio;
+  int fd;
+
+  fd = open(s->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(fd < 0) {
+    return -1;
+  }
+  if(tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudrate);
+    cfsetospeed(&tio, baudrate);
+    tio.c_cflag |= CLOCAL | CREAD;
+    /* with O_NONBLOCK, read() then fails with EAGAIN instead of returning 0 */
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIFLUSH);
+  }
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+/* Start a nonblocking connect, poll() reports when it is done */
+static int
+open_tcp(struct source *s)
+{
+  struct addrinfo hints, *res, *ai;
+  int fd = -1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(s->host, s->port, &hints, &res) != 0) {
+    return -1;
+  }
+  for(ai = res; ai != NULL; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol);
+    if(fd < 0) {
+      continue;
+    }
+    if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || errno == EINPROGRESS) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+static void
+source_open(struct source *s, double t)
+{
+  switch(s->kind) {
+  case SOURCE_SERIAL:
+    s->fd = open_serial(s);
+    break;
+  case SOURCE_TCP:
+    s->fd = open_tcp(s);
+    break;
+  case SOURCE_FILE:
+    s->fd = strcmp(s->path, "-") == 0 ? dup(0) : open(s->path, O_RDONLY);
+    if(s->fd < 0) {
+      fprintf(stderr, "%s: %s\n", s->spec, strerror(errno));
+      s->done = 1;
+    } else {
+      fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) | O_NONBLOCK);
+    }
+    return;
+  }
+  if(s->fd < 0) {
+    s->retry = t + RETRY_TIME;
+  }
+  s->len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+source_close(struct source *s, double t)
+{
+  if(s->fd >= 0) {
+    close(s->fd);
+    s->fd = -1;
+  }
+  if(s->kind == SOURCE_FILE) {
+    s->done = 1;
+  } else {
+    s->errors++;
+    s->retry = t + RETRY_TIME;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+source_read(struct source *s, double t)
+{
+  char *p, *eol;
+  ssize_t r;
+
+  for(;;) {
+    r = read(s->fd, s->buf + s->len, sizeof(s->buf) - s->len);
+    if(r < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+    if(r <= 0) {
+      if(s->len > 0 && s->kind == SOURCE_FILE) {
+        process_line(s, s->buf, s->buf + s->len, t);
+        s->lines++;
+      }
+      source_close(s, t);
+      return;
+    }
+    s->len += r;
+    p = s->buf;
+    while((eol = memchr(p, '\n', s->buf + s->len - p)) != NULL) {
+      process_line(s, p, eol, t);
+      s->lines++;
+      p = eol + 1;
+    }
+    s->len -= p - s->buf;
+    if(s->len == sizeof(s->buf)) {
+      /* no newline in a full buffer: drop the line */
+      s->len = 0;
+    }
+    memmove(s->buf, p, s->len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_source(struct source *s, const char *spec)
+{
+  struct stat st;
+  char *eq, *colon;
+
+  memset(s, 0, sizeof(*s));
+  s->spec = spec;
+  s->fd = -1;
+  s->id = -1;
+  s->path = strdup(spec);
+  eq = strrchr(s->path, '=');
+  if(eq != NULL) {
+    *eq = '\0';
+    s->id = atol(eq + 1);
+  }
+  colon = strrchr(s->path, ':');
+  if(strcmp(s->path, "-") == 0) {
+    s->kind = SOURCE_FILE;
+  } else if(stat(s->path, &st) == 0) {
+    s->kind = S_ISCHR(st.st_mode) ? SOURCE_SERIAL : SOURCE_FILE;
+  } else if(colon != NULL && s->path[0] != '/') {
+    s->kind = SOURCE_TCP;
+    *colon = '\0';
+    s->host = s->path;
+    s->port = colon + 1;
+    if(s->id < 0 && atol(s->port) > COOJA_PORT) {
+      s->id = atol(s->port) - COOJA_PORT;
+    }
+  } else if(strncmp(s->path, "/dev/", 5) == 0) {
+    /* not plugged in yet */
+    s->kind = SOURCE_SERIAL;
+  } else {
+    fprintf(stderr, "%s: %s\n", spec, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+out(char **buf, size_t *len, size_t *cap, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  for(;;) {
+    va_start(ap, fmt);
+    n = vsnprintf(*buf + *len, *cap - *len, fmt, ap);
+    va_end(ap);
+    if(n < 0) {
+      return;
+    }
+    if(*len + n < *cap) {
+      *len += n;
+      return;
+    }
+    *cap = *cap * 2 + n + 1;
+    *buf = xrealloc(*buf, *cap);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static char *
+snapshot(double t, size_t *len)
+{
+  char *buf = NULL;
+  size_t cap = 0;
+  unsigned long generated = 0, delivered = 0, active = 0, seen = 0;
+  int i, connected = 0;
+  long id;
+  struct node *n;
+
+  *len = 0;
+  for(i = 0; i < num_sources; i++) {
+    connected += sources[i].fd >= 0;
+  }
+  for(id = 0; id < num_nodes; id++) {
+    if(nodes[id].seen) {
+      seen++;
+      active += t - nodes[id].last < stale_time;
+      generated += nodes[id].generated;
+      delivered += nodes[id].delivered;
+    }
+  }
+  out(&buf, len, &cap, "uptime %.1f\n", t - start_time);
+  out(&buf, len, &cap, "sources %d connected %d\n", num_sources, connected);
+  out(&buf, len, &cap, "nodes %lu active %lu\n", seen, active);
+  out(&buf, len, &cap, "generated %lu delivered %lu pdr %.4f\n", generated,
+      delivered, generated ? (double)delivered / generated : 0.0);
+  if(unattributed > 0) {
+    out(&buf, len, &cap, "unattributed %lu\n", unattributed);
+  }
+  for(i = 0; i < num_sources; i++) {
+    out(&buf, len, &cap, "source %s %s lines %lu errors %lu\n", sources[i].spec,
+        sources[i].fd >= 0 ? "up" : (sources[i].done ? "done" : "down"),
+        sources[i].lines, sources[i].errors);
+  }
+  for(id = 0; id < num_nodes; id++) {
+    n = &nodes[id];
+    if(!n->seen) {
+      continue;
+    }
+    out(&buf, len, &cap, "node %ld%s age %.1f lines %lu", id,
+        n->is_sink ? " sink" : "", n->lines ? t - n->last : -1.0, n->lines);
+    if(n->has_duty) {
+      out(&buf, len, &cap, " duty %ld duty_avg %.1f queue %ld wakeups %ld",
+          n->duty, n->duty_avg, n->queue, n->wakeups);
+    }
+    if(n->has_power) {
+      out(&buf, len, &cap, " power %.3f", n->power / 1000.0);
+    }
+    out(&buf, len, &cap, " generated %lu delivered %lu forwards %lu"
+        " generated_min %.1f delivered_min %.1f forwards_min %.1f",
+        n->generated, n->delivered, n->forwards,
+        rate_get(&n->generated_rate, t), rate_get(&n->delivered_rate, t),
+        rate_get(&n->forward_rate, t));
+    if(n->has_energy) {
+      for(i = 0; i < NUM_PHASES; i++) {
+        out(&buf, len, &cap, " energy_%s %.3f", phase_names[i],
+            n->energy[i] / 1000.0);
+      }
+    }
+    if(n->has_pt) {
+      out(&buf, len, &cap, " pt_seqno %lu pt_radio %ld pt_tx %ld pt_listen %ld",
+          n->pt_seqno, n->pt_radio, n->pt_tx, n->pt_listen);
+    }
+    out(&buf, len, &cap, "\n");
+  }
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_snapshot(double t)
+{
+  char *buf, tmp[4096];
+  size_t len;
+  FILE *f;
+
+  buf = snapshot(t, &len);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", snapshot_file);
+  f = fopen(tmp, "w");
+  if(f == NULL) {
+    perror(tmp);
+  } else {
+    fwrite(buf, 1, len, f);
+    if(fclose(f) != 0 || rename(tmp, snapshot_file) != 0) {
+      perror(snapshot_file);
+    }
+  }
+  free(buf);
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_socket(const char *path)
+{
+  struct sockaddr_un sa;
+  int fd;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(sa.sun_path)) {
+    fprintf(stderr, "%s: path too long\n", path);
+    return -1;
+  }
+  strcpy(sa.sun_path, path);
+  unlink(path);
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if(fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+     listen(fd, MAX_CLIENTS) < 0) {
+    perror(path);
+    return -1;
+  }
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+/* Every client gets one snapshot, written as the socket accepts it */
+static void
+accept_clients(double t)
+{
+  struct client *c;
+  int fd, i;
+
+  while((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+    for(i = 0; i < MAX_CLIENTS && clients[i].fd > 0; i++);
+    if(i == MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+    c = &clients[i];
+    c->fd = fd;
+    c->off = 0;
+    c->buf = snapshot(t, &c->len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+client_write(struct client *c)
+{
+  ssize_t r;
+
+  r = write(c->fd, c->buf + c->off, c->len - c->off);
+  if(r < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  if(r > 0) {
+    c->off += r;
+  }
+  if(r <= 0 || c->off == c->len) {
+    close(c->fd);
+    free(c->buf);
+    c->fd = 0;
+    c->buf = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_signal(int sig)
+{
+  stop = 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+usage(void)
+{
+  fprintf(stderr, "Usage: staffetta-monitor [-f file] [-i seconds] [-u socket] [-b speed]\n"
+          "                         [-a seconds] source...\n");
+  fprintf(stderr, "       -f write snapshots to this file\n");
+  fprintf(stderr, "       -i seconds between snapshots (default: 5)\n");
+  fprintf(stderr, "       -u serve snapshots on this local socket\n");
+  fprintf(stderr, "       -b serial speed (default: 115200)\n");
+  fprintf(stderr, "       -a seconds of silence before a node is not active (default: 300)\n");
+  fprintf(stderr, "       source: /dev/ttyX[=id], host:port[=id], file[=id] or -\n");
+  return 2;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  struct pollfd *pfds;
+  struct source **pfd_source;
+  double t, next_snapshot;
+  int i, c, np, timeout, live;
+
+  while((c = getopt(argc, argv, "f:i:u:b:a:")) != -1) {
+    switch(c) {
+    case 'f':
+      snapshot_file = optarg;
+      break;
+    case 'i':
+      snapshot_period = atof(optarg);
+      break;
+    case 'u':
+      socket_path = optarg;
+      break;
+    case 'b':
+      switch(atoi(optarg)) {
+      case 9600: baudrate = B9600; break;
+      case 19200: baudrate = B19200; break;
+      case 38400: baudrate = B38400; break;
+      case 57600: baudrate = B57600; break;
+      case 115200: baudrate = B115200; break;
+      case 230400: baudrate = B230400; break;
+      default:
+        fprintf(stderr, "unsupported speed %s\n", optarg);
+        return 2;
+      }
+      break;
+    case 'a':
+      stale_time = atof(optarg);
+      break;
+    default:
+      return usage();
+    }
+  }
+  if(optind >= argc || snapshot_period <= 0) {
+    return usage();
+  }
+  num_sources = argc - optind;
+  sources = calloc(num_sources, sizeof(*sources));
+  pfds = calloc(num_sources + MAX_CLIENTS + 1, sizeof(*pfds));
+  pfd_source = calloc(num_sources, sizeof(*pfd_source));
+  if(sources == NULL || pfds == NULL || pfd_source == NULL) {
+    perror("calloc");
+    return 1;
+  }
+  live = 0;
+  for(i = 0; i < num_sources; i++) {
+    if(parse_source(&sources[i], argv[optind + i]) < 0) {
+      return 1;
+    }
+    live |= sources[i].kind != SOURCE_FILE;
+  }
+  if(socket_path != NULL && (listen_fd = open_socket(socket_path)) < 0) {
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  start_time = now();
+  next_snapshot = start_time + snapshot_period;
+  for(i = 0; i < num_sources; i++) {
+    source_open(&sources[i], start_time);
+  }
+
+  while(!stop) {
+    t = now();
+    np = 0;
+    timeout = (int)((next_snapshot - t) * 1000);
+    for(i = 0; i < num_sources; i++) {
+      if(sources[i].fd < 0 && !sources[i].done && t >= sources[i].retry) {
+        source_open(&sources[i], t);
+      }
+      if(sources[i].fd >= 0) {
+        pfds[np].fd = sources[i].fd;
+        pfds[np].events = POLLIN;
+        pfd_source[np++] = &sources[i];
+      } else if(!sources[i].done && (sources[i].retry - t) * 1000 < timeout) {
+        timeout = (int)((sources[i].retry - t) * 1000);
+      }
+    }
+    if(!live) {
+      for(i = 0; i < num_sources && sources[i].done; i++);
+      if(i == num_sources) {
+        break;
+      }
+    }
+    c = np;
+    if(listen_fd >= 0) {
+      pfds[np].fd = listen_fd;
+      pfds[np++].events = POLLIN;
+      for(i = 0; i < MAX_CLIENTS; i++) {
+        if(clients[i].fd > 0) {
+          pfds[np].fd = clients[i].fd;
+          pfds[np++].events = POLLOUT;
+        }
+      }
+    }
+    if(poll(pfds, np, timeout < 0 ? 0 : timeout) < 0 && errno != EINTR) {
+      perror("poll");
+      return 1;
+    }
+    t = now();
+    for(i = 0; i < c; i++) {
+      if(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        source_read(pfd_source[i], t);
+      }
+    }
+    if(listen_fd >= 0) {
+      if(pfds[c].revents & POLLIN) {
+        accept_clients(t);
+      }
+      for(i = 0; i < MAX_CLIENTS; i++) {
+        if(clients[i].fd > 0 && clients[i].off < clients[i].len) {
+          client_write(&clients[i]);
+        }
+      }
+    }
+    if(t >= next_snapshot) {
+      if(snapshot_file != NULL) {
+        write_snapshot(t);
+      }
+      next_snapshot = t + snapshot_period;
+    }
+  }
+
+  t = now();
+  if(snapshot_file != NULL) {
+    write_snapshot(t);
+  } else if(!live || socket_path == NULL) {
+    char *buf;
+    size_t len;
+    buf = snapshot(t, &len);
+    fwrite(buf, 1, len, stdout);
+    free(buf);
+  }
+  if(socket_path != NULL) {
+    unlink(socket_path);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
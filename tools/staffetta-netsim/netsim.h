@@ -0,0 +1,20 @@
+/*
+ * Interface between the Staffetta network simulator and the node image.
+ * The simulator exports the netsim_* services (its executable is linked
+ * with -rdynamic), every node instance exports node_main().
+ */
+
+#ifndef __NETSIM_H__
+#define __NETSIM_H__
+
+/* Local virtual time of the running node, in rtimer ticks */
+unsigned long netsim_time(void);
+/* Suspend the running node for ticks rtimer ticks */
+void netsim_sleep(unsigned long ticks);
+/* Log a message of the running node, in the Cooja log format */
+int netsim_log(const char *fmt, ...);
+
+/* Entry point of a node instance, never returns */
+typedef void (*netsim_node_main_t)(unsigned short id, unsigned short seed);
+
+#endif /* __NETSIM_H__ */
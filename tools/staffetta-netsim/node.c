@@ -0,0 +1,188 @@
+/**
+ * \file
+ *         Node image of the Staffetta network simulator.
+ *
+ *         Built as a shared object holding everything that is global
+ *         state on a mote: staffetta.c, energest, node_id, the random
+ *         generator and the staffetta-test application loop. The
+ *         simulator loads one private copy of it per node, so every
+ *         node gets its own instance of all these globals while running
+ *         the unmodified protocol code.
+ */
+
+#include "netsim.h"
+
+/* Staffetta prints go through the simulator log, in the Cooja log format */
+#define printf netsim_log
+/* Sleeping for a slot offset runs the rtimer task at its time */
+void sleep_rtimer(void);
+#define STAFFETTA_CONF_SLEEP_WHILE(cond) do { while(cond) sleep_rtimer(); } while(0)
+#include "dev/staffetta.c"
+#undef printf
+
+#define TICKS_PER_CLOCK (RTIMER_ARCH_SECOND / CLOCK_SECOND)
+
+unsigned short node_id;
+
+static uint32_t seed;
+/*---------------------------------------------------------------------------*/
+/* Platform services used by staffetta.c */
+clock_time_t
+clock_time(void)
+{
+  return (clock_time_t)(netsim_time() / TICKS_PER_CLOCK);
+}
+unsigned long
+clock_seconds(void)
+{
+  return netsim_time() / RTIMER_ARCH_SECOND;
+}
+void
+ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr)
+{
+}
+void
+ctimer_stop(struct ctimer *c)
+{
+}
+void
+random_init(unsigned short s)
+{
+  seed = s;
+}
+unsigned short
+random_rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+/*---------------------------------------------------------------------------*/
+#if SYNC_WAKEUP
+/*
+ * core/net/rime/timesynch.c without its rime broadcasts, Staffetta
+ * carries the timestamps. All nodes share the simulator's time base, so
+ * every node starts with its own offset as if it had booted at another
+ * time.
+ */
+static int authority_level;
+static rtimer_clock_t offset;
+
+int
+timesynch_authority_level(void)
+{
+  return authority_level;
+}
+void
+timesynch_set_authority_level(int level)
+{
+  authority_level = level;
+}
+rtimer_clock_t
+timesynch_time(void)
+{
+  return RTIMER_NOW() + offset;
+}
+void
+timesynch_incoming(int level, rtimer_clock_t authoritative_time,
+                   rtimer_clock_t local_time)
+{
+  if(level < authority_level) {
+    offset = authoritative_time - local_time;
+    authority_level = level + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* One pending rtimer task, enough for the slot offsets */
+static struct rtimer *rtimer_pending;
+
+int
+rtimer_set(struct rtimer *task, rtimer_clock_t time,
+           rtimer_clock_t duration, rtimer_callback_t func, void *ptr)
+{
+  task->time = time;
+  task->func = func;
+  task->ptr = ptr;
+  rtimer_pending = task;
+  return RTIMER_OK;
+}
+void
+sleep_rtimer(void)
+{
+  struct rtimer *t = rtimer_pending;
+  rtimer_clock_t now;
+
+  if(t == NULL) {
+    return;
+  }
+  rtimer_pending = NULL;
+  now = RTIMER_NOW();
+  if(RTIMER_CLOCK_LT(now, t->time)) {
+    netsim_sleep((rtimer_clock_t)(t->time - now));
+  }
+  t->func(t, t->ptr);
+}
+#endif /* SYNC_WAKEUP */
+/*---------------------------------------------------------------------------*/
+void leds_on(unsigned char leds) {}
+void leds_off(unsigned char leds) {}
+void watchdog_stop(void) {}
+/*---------------------------------------------------------------------------*/
+/*
+ * The mote sleeps in LPM between its exchanges. energest adds up 16-bit
+ * rtimer intervals, so long sleeps are accounted for in slices.
+ */
+static void
+sleep_lpm(unsigned long ticks)
+{
+  unsigned long slice;
+
+  while(ticks > 0) {
+    slice = ticks < RTIMER_ARCH_SECOND ? ticks : RTIMER_ARCH_SECOND;
+    ENERGEST_OFF(ENERGEST_TYPE_CPU);
+    ENERGEST_ON(ENERGEST_TYPE_LPM);
+    netsim_sleep(slice);
+    ENERGEST_OFF(ENERGEST_TYPE_LPM);
+    ENERGEST_ON(ENERGEST_TYPE_CPU);
+    ticks -= slice;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * apps/staffetta-test, with its two processes folded into one loop: the
+ * periodic statistics are printed before the data exchange they fall in.
+ */
+void
+node_main(unsigned short id, unsigned short run_seed)
+{
+  uint32_t wakeups, Tw;
+  uint8_t round_stats;
+  unsigned long next_stats;
+
+  node_id = id;
+  random_init(node_id ^ run_seed);
+#if SYNC_WAKEUP
+  offset = (id ^ run_seed) * 7919;
+#endif
+  energest_init();
+  ENERGEST_ON(ENERGEST_TYPE_CPU);
+  process_init();
+  staffetta_init();
+
+  round_stats = PAKETS_PER_NODE;
+  next_stats = netsim_time() +
+    (CLOCK_SECOND * 55 + (random_rand() % (CLOCK_SECOND * 10))) * TICKS_PER_CLOCK;
+  while(1) {
+    wakeups = getWakeups();
+    Tw = ((CLOCK_SECOND * (10 * BUDGET_PRECISION)) / wakeups);
+    sleep_lpm(staffetta_wakeup_delay(((Tw * 3) / 4) + (random_rand() % (Tw / 2))) *
+              TICKS_PER_CLOCK);
+    if(netsim_time() >= next_stats) {
+      staffetta_print_stats();
+      staffetta_add_data(round_stats++);
+      next_stats += CLOCK_SECOND * 240 * TICKS_PER_CLOCK;
+    }
+    staffetta_send_packet();
+    while(process_run() > 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
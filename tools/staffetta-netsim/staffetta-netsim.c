@@ -0,0 +1,836 @@
+/**
+ * \file
+ *         Many Staffetta nodes in one Linux process.
+ *
+ *         Every node is a private copy of the node image (node.so:
+ *         staffetta.c, energest and the staffetta-test loop), loaded
+ *         from its own file so that all of its globals are per node.
+ *         Nodes run as coroutines on their own stacks and talk through a
+ *         virtual CC2420: a frame sent with STXON reaches the RXFIFO of
+ *         every node within the transmission range, and frames that
+ *         overlap at a receiver corrupt each other, also when they come
+ *         from the interference range (unit disk graph, as Cooja's UDGM).
+ *
+ *         Time advances in windows of LOOKAHEAD rtimer ticks, shorter
+ *         than the preamble of a frame: within a window the nodes are
+ *         independent and run in parallel on the worker threads, frames
+ *         sent in a window are delivered at its end, before their length
+ *         byte is due. Stretches where every node sleeps are skipped.
+ *         A run only depends on the topology and the seed, not on the
+ *         number of threads.
+ *
+ *         The log is written in the Cooja loglistener format, so that
+ *         staffetta-logstat and the scripts in data/ read it unchanged.
+ *
+ *           staffetta-netsim [-c scenario.csc | -n nodes] [-t seconds]
+ *                            [-j threads] [-s seed] [-o log]
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "netsim.h"
+#include "rtimer-arch.h"
+#include "dev/spi.h"
+#include "dev/cc2420_const.h"
+
+#define MAX_FRAMES      32  /* frames in flight per receiver */
+#define MAX_SENT        4   /* frames sent per node and window */
+#define MAX_LEN         128 /* CC2420 frame buffer */
+#define AIR_OVERHEAD    6   /* preamble, SFD and length byte */
+#define BYTE_TICKS(n)   (((unsigned long)(n) * RTIMER_ARCH_SECOND * 32) / 1000000)
+#define LOOKAHEAD       BYTE_TICKS(AIR_OVERHEAD)
+#define STACK_SIZE      (64 * 1024)
+#define FOOTER1_CRC_OK  0x80
+#define FOOTER1_CORR    0x40
+#define NEVER           ULONG_MAX
+#define MAX(a, b)       ((a) > (b) ? (a) : (b))
+
+struct frame {
+  unsigned long at;     /* arrival of the length byte */
+  unsigned long end;    /* arrival of the last byte */
+  uint8_t len;
+  uint8_t read;
+  uint8_t noise;        /* from the interference range: never received */
+  uint8_t buf[MAX_LEN];
+};
+
+struct node {
+  unsigned short id;
+  double x, y;
+  int *nbr, num_nbr;    /* in transmission range */
+  int *intf, num_intf;  /* in interference range only */
+
+  netsim_node_main_t main;
+  ucontext_t ctx;
+  ucontext_t *sched;
+
+  unsigned long now, wake;
+  int sleeping, dirty;
+
+  /* virtual CC2420 */
+  int radio_is_on;
+  struct frame frames[MAX_FRAMES];
+  int num_frames;
+  uint8_t txfifo[MAX_LEN];
+  int txfifo_len;
+  unsigned long tx_start, tx_end;
+  struct frame sent[MAX_SENT];
+  int num_sent;
+
+  char *log;
+  size_t log_len, log_size;
+  int mid_line;
+
+  unsigned long tx, rx, collisions, overflows;
+};
+
+struct worker {
+  pthread_t thread;
+  ucontext_t sched;
+  int *active, num_active;
+  int *heap, num_heap;    /* sleeping nodes, earliest wake first */
+  int *dirty, num_dirty;  /* nodes that sent or logged in this window */
+};
+
+static struct node *nodes;
+static int num_nodes;
+static struct worker *workers;
+static int num_workers = 1;
+static pthread_barrier_t barrier;
+static int *merged;
+
+static unsigned long window_end, duration;
+static unsigned short run_seed = 1;
+static int done;
+static FILE *out;
+
+static __thread struct node *self;
+static __thread struct worker *worker;
+/*---------------------------------------------------------------------------*/
+static void *
+xcalloc(size_t count, size_t size)
+{
+  void *p = calloc(count ? count : 1, size);
+
+  if(p == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static void
+mark_dirty(struct node *n)
+{
+  if(!n->dirty) {
+    n->dirty = 1;
+    worker->dirty[worker->num_dirty++] = n - nodes;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Services for the node image */
+static void
+yield(void)
+{
+  swapcontext(&self->ctx, self->sched);
+}
+/* Reading the timer or polling the radio costs a tick */
+static void
+tick(void)
+{
+  self->now++;
+  if(self->now >= window_end) {
+    yield();
+  }
+}
+unsigned short
+shim_rtimer_now(void)
+{
+  tick();
+  return (unsigned short)self->now;
+}
+unsigned long
+netsim_time(void)
+{
+  return self->now;
+}
+void
+netsim_sleep(unsigned long ticks)
+{
+  self->wake = self->now + ticks;
+  self->sleeping = 1;
+  yield();
+}
+int
+netsim_log(const char *fmt, ...)
+{
+  struct node *n = self;
+  unsigned long ms;
+  va_list ap;
+  int len;
+
+  if(n->log_size - n->log_len < 256) {
+    n->log_size = n->log_size ? n->log_size * 2 : 1024;
+    n->log = realloc(n->log, n->log_size);
+    if(n->log == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  if(!n->mid_line) {
+    ms = n->now * 1000 / RTIMER_ARCH_SECOND;
+    n->log_len += sprintf(n->log + n->log_len, "%02lu:%02lu.%03lu\tID:%u\t",
+                          ms / 60000, (ms / 1000) % 60, ms % 1000, n->id);
+  }
+  va_start(ap, fmt);
+  len = vsnprintf(n->log + n->log_len, n->log_size - n->log_len, fmt, ap);
+  va_end(ap);
+  if(len >= (int)(n->log_size - n->log_len)) {
+    len = n->log_size - n->log_len - 1;
+  }
+  n->log_len += len;
+  n->mid_line = n->log_len > 0 && n->log[n->log_len - 1] != '\n';
+  mark_dirty(n);
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Virtual CC2420 */
+static void
+drop_frames_until(struct node *n, unsigned long t)
+{
+  int i, j;
+
+  for(i = 0, j = 0; i < n->num_frames; i++) {
+    if(n->frames[i].at > t) {
+      n->frames[j++] = n->frames[i];
+    }
+  }
+  n->num_frames = j;
+}
+/*---------------------------------------------------------------------------*/
+static struct frame *
+head_frame(struct node *n)
+{
+  struct frame *f, *head = NULL;
+
+  for(f = n->frames; f < n->frames + n->num_frames; f++) {
+    if(!f->noise && (head == NULL || f->at < head->at)) {
+      head = f;
+    }
+  }
+  return head;
+}
+/*---------------------------------------------------------------------------*/
+static void
+transmit(struct node *n)
+{
+  struct frame *f;
+
+  if(n->txfifo_len < 1 || n->num_sent == MAX_SENT) {
+    return;
+  }
+  f = &n->sent[n->num_sent];
+  /* the receivers see the FCS replaced by the RSSI and the CRC byte */
+  f->len = n->txfifo[0] + 1;
+  if(f->len < 3 || f->len > MAX_LEN) {
+    return;
+  }
+  memset(f->buf, 0, f->len);
+  memcpy(f->buf, n->txfifo, n->txfifo_len < f->len ? n->txfifo_len : f->len);
+  f->buf[f->len - 1] = FOOTER1_CRC_OK | FOOTER1_CORR;
+  f->at = n->now + LOOKAHEAD;
+  f->end = n->now + BYTE_TICKS(f->len + AIR_OVERHEAD);
+  f->read = 0;
+  f->noise = 0;
+  n->num_sent++;
+  n->tx++;
+  mark_dirty(n);
+
+  /* half duplex: whatever was arriving meanwhile is lost */
+  n->tx_start = n->now;
+  n->now += BYTE_TICKS(n->txfifo_len + AIR_OVERHEAD);
+  n->tx_end = n->now;
+  drop_frames_until(n, n->tx_end);
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_strobe(unsigned char s)
+{
+  switch(s) {
+  case CC2420_SRXON:
+    /* whatever arrived while the radio was off is lost */
+    drop_frames_until(self, self->now - 1);
+    self->radio_is_on = 1;
+    break;
+  case CC2420_SRFOFF:
+    drop_frames_until(self, self->now);
+    self->radio_is_on = 0;
+    break;
+  case CC2420_SFLUSHRX:
+    drop_frames_until(self, self->now);
+    break;
+  case CC2420_SFLUSHTX:
+    self->txfifo_len = 0;
+    break;
+  case CC2420_STXON:
+    transmit(self);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+unsigned char
+shim_status(void)
+{
+  /* transmissions complete synchronously in transmit() */
+  return BV(CC2420_XOSC16M_STABLE);
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_write_fifo(const unsigned char *p, int c)
+{
+  if(c > MAX_LEN) {
+    c = MAX_LEN;
+  }
+  memcpy(self->txfifo, p, c);
+  self->txfifo_len = c;
+}
+/*---------------------------------------------------------------------------*/
+int
+shim_fifo_is_1(void)
+{
+  struct frame *f;
+
+  /* the sink polls the FIFO without reading the timer */
+  tick();
+  f = head_frame(self);
+  return self->radio_is_on && f != NULL && f->at + f->read <= self->now;
+}
+/*---------------------------------------------------------------------------*/
+unsigned char
+shim_read_fifo_byte(void)
+{
+  struct frame *f;
+  unsigned char b;
+
+  f = head_frame(self);
+  if(f == NULL || f->at + f->read > self->now) {
+    return 0;
+  }
+  b = f->buf[f->read++];
+  if(f->read == f->len) {
+    self->rx++;
+    *f = self->frames[--self->num_frames];
+  }
+  return b;
+}
+/*---------------------------------------------------------------------------*/
+/* Delivery at the end of a window */
+static void
+deliver(struct node *r, const struct frame *sent, int noise)
+{
+  struct frame *f;
+  int i, j;
+
+  /* asleep until it is over, or transmitting while it arrives */
+  if(r->sleeping && r->wake >= sent->end) {
+    return;
+  }
+  if(sent->at < r->tx_end && sent->end > r->tx_start) {
+    return;
+  }
+  for(i = 0, j = 0; i < r->num_frames; i++) {
+    if(!r->frames[i].noise || r->frames[i].end > r->now) {
+      r->frames[j++] = r->frames[i];
+    }
+  }
+  r->num_frames = j;
+  if(r->num_frames == MAX_FRAMES) {
+    r->overflows++;
+    return;
+  }
+  f = &r->frames[r->num_frames++];
+  *f = *sent;
+  f->noise = noise;
+  for(i = 0; i < r->num_frames - 1; i++) {
+    if(r->frames[i].at < f->end && f->at < r->frames[i].end) {
+      r->frames[i].buf[r->frames[i].len - 1] &= ~FOOTER1_CRC_OK;
+      f->buf[f->len - 1] &= ~FOOTER1_CRC_OK;
+      r->collisions++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sleeping nodes of a worker, a binary heap on the wake time */
+static void
+heap_push(struct worker *w, int i)
+{
+  int k = w->num_heap++, parent;
+
+  while(k > 0) {
+    parent = (k - 1) / 2;
+    if(nodes[w->heap[parent]].wake <= nodes[i].wake) {
+      break;
+    }
+    w->heap[k] = w->heap[parent];
+    k = parent;
+  }
+  w->heap[k] = i;
+}
+/*---------------------------------------------------------------------------*/
+static int
+heap_pop(struct worker *w)
+{
+  int top = w->heap[0], last = w->heap[--w->num_heap], k = 0, c;
+
+  while((c = 2 * k + 1) < w->num_heap) {
+    if(c + 1 < w->num_heap && nodes[w->heap[c + 1]].wake < nodes[w->heap[c]].wake) {
+      c++;
+    }
+    if(nodes[last].wake <= nodes[w->heap[c]].wake) {
+      break;
+    }
+    w->heap[k] = w->heap[c];
+    k = c;
+  }
+  w->heap[k] = last;
+  return top;
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_entry(int i)
+{
+  nodes[i].main(nodes[i].id, run_seed);
+  /* node_main() never returns; if it does, the node stays off */
+  while(1) {
+    netsim_sleep(NEVER - self->now);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_window(struct worker *w)
+{
+  struct node *n;
+  int k;
+
+  while(w->num_heap > 0 && nodes[w->heap[0]].wake < window_end) {
+    w->active[w->num_active++] = heap_pop(w);
+  }
+  for(k = 0; k < w->num_active;) {
+    n = &nodes[w->active[k]];
+    while(1) {
+      if(n->sleeping) {
+        if(n->wake >= window_end) {
+          break;
+        }
+        n->sleeping = 0;
+        n->now = n->wake;
+      } else if(n->now >= window_end) {
+        break;
+      }
+      self = n;
+      swapcontext(&w->sched, &n->ctx);
+    }
+    if(n->sleeping) {
+      w->active[k] = w->active[--w->num_active];
+      heap_push(w, n - nodes);
+    } else {
+      k++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+/*---------------------------------------------------------------------------*/
+/* Serial part of a window: deliver the frames, write the logs, move on */
+static void
+end_window(void)
+{
+  struct node *n;
+  unsigned long wake = NEVER;
+  int w, k, m, j, num_merged = 0, active = 0;
+
+  for(w = 0; w < num_workers; w++) {
+    memcpy(merged + num_merged, workers[w].dirty,
+           workers[w].num_dirty * sizeof(int));
+    num_merged += workers[w].num_dirty;
+    workers[w].num_dirty = 0;
+  }
+  qsort(merged, num_merged, sizeof(int), cmp_int);
+  for(k = 0; k < num_merged; k++) {
+    n = &nodes[merged[k]];
+    n->dirty = 0;
+    for(m = 0; m < n->num_sent; m++) {
+      for(j = 0; j < n->num_nbr; j++) {
+        deliver(&nodes[n->nbr[j]], &n->sent[m], 0);
+      }
+      for(j = 0; j < n->num_intf; j++) {
+        deliver(&nodes[n->intf[j]], &n->sent[m], 1);
+      }
+    }
+    n->num_sent = 0;
+    if(n->log_len > 0) {
+      fwrite(n->log, 1, n->log_len, out);
+      n->log_len = 0;
+    }
+  }
+
+  for(w = 0; w < num_workers; w++) {
+    active += workers[w].num_active;
+    if(workers[w].num_heap > 0 && nodes[workers[w].heap[0]].wake < wake) {
+      wake = nodes[workers[w].heap[0]].wake;
+    }
+  }
+  if(window_end >= duration || (active == 0 && wake == NEVER)) {
+    done = 1;
+    return;
+  }
+  if(active > 1) {
+    window_end += LOOKAHEAD;
+  } else if(active == 1) {
+    /*
+     * Nobody can hear a lone node (the always-on sink, mostly) before
+     * the next node wakes up: run it up to the window of that wakeup.
+     */
+    wake = wake < duration ? wake : duration;
+    window_end = MAX(window_end + LOOKAHEAD, wake - wake % LOOKAHEAD);
+  } else {
+    window_end = MAX(window_end, wake - wake % LOOKAHEAD) + LOOKAHEAD;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+worker_loop(void *arg)
+{
+  struct worker *w = arg;
+
+  worker = w;
+  while(1) {
+    run_window(w);
+    pthread_barrier_wait(&barrier);
+    if(w == workers) {
+      end_window();
+    }
+    pthread_barrier_wait(&barrier);
+    if(done) {
+      break;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Node instances */
+static void *
+read_image(const char *path, size_t *size)
+{
+  FILE *f;
+  void *image;
+  long len;
+
+  f = fopen(path, "rb");
+  if(f == NULL || fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) <= 0) {
+    perror(path);
+    exit(1);
+  }
+  rewind(f);
+  image = xcalloc(1, len);
+  if(fread(image, 1, len, f) != (size_t)len) {
+    perror(path);
+    exit(1);
+  }
+  fclose(f);
+  *size = len;
+  return image;
+}
+/*---------------------------------------------------------------------------*/
+static void
+load_node(struct node *n, const char *dir, const void *image, size_t size,
+          char *stack)
+{
+  char path[PATH_MAX];
+  void *handle;
+  FILE *f;
+
+  /*
+   * A file of its own per node: the dynamic loader shares an object
+   * opened twice under the same name or from the same file.
+   */
+  snprintf(path, sizeof(path), "%s/node-%d.so", dir, (int)(n - nodes));
+  f = fopen(path, "wb");
+  if(f == NULL || fwrite(image, 1, size, f) != size || fclose(f) != 0) {
+    perror(path);
+    exit(1);
+  }
+  handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  unlink(path);
+  if(handle == NULL) {
+    rmdir(dir);
+    fprintf(stderr, "%s\n", dlerror());
+    exit(1);
+  }
+  n->main = (netsim_node_main_t)dlsym(handle, "node_main");
+  if(n->main == NULL) {
+    fprintf(stderr, "node image without node_main\n");
+    exit(1);
+  }
+
+  getcontext(&n->ctx);
+  n->ctx.uc_stack.ss_sp = stack;
+  n->ctx.uc_stack.ss_size = STACK_SIZE;
+  n->ctx.uc_link = NULL;
+  makecontext(&n->ctx, (void (*)(void))node_entry, 1, (int)(n - nodes));
+}
+/*---------------------------------------------------------------------------*/
+/* Topology */
+static double
+xml_value(const char *p, const char *end, const char *tag, double def)
+{
+  char open[64];
+  const char *v;
+
+  snprintf(open, sizeof(open), "<%s>", tag);
+  v = strstr(p, open);
+  if(v == NULL || (end != NULL && v > end)) {
+    return def;
+  }
+  return atof(v + strlen(open));
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_csc(const char *path, double *range, double *intf_range)
+{
+  char *xml, *p, *end;
+  size_t size;
+  int cap = 0;
+
+  xml = read_image(path, &size);
+  xml = realloc(xml, size + 1);
+  xml[size] = '\0';
+  /* the plugins after the simulation refer to motes as <mote>n</mote> */
+  if((p = strstr(xml, "</simulation>")) != NULL) {
+    *p = '\0';
+  }
+  *range = xml_value(xml, NULL, "transmitting_range", *range);
+  *intf_range = xml_value(xml, NULL, "interference_range", *intf_range);
+  for(p = strstr(xml, "<mote>"); p != NULL; p = strstr(end, "<mote>")) {
+    end = strstr(p, "</mote>");
+    if(end == NULL) {
+      break;
+    }
+    if(num_nodes == cap) {
+      cap = cap ? cap * 2 : 64;
+      nodes = realloc(nodes, cap * sizeof(struct node));
+      if(nodes == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+    memset(&nodes[num_nodes], 0, sizeof(struct node));
+    nodes[num_nodes].x = xml_value(p, end, "x", 0);
+    nodes[num_nodes].y = xml_value(p, end, "y", 0);
+    nodes[num_nodes].id = xml_value(p, end, "id", num_nodes + 1);
+    num_nodes++;
+  }
+  free(xml);
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_grid(int count, double spacing)
+{
+  int i, side = (int)ceil(sqrt(count));
+
+  num_nodes = count;
+  nodes = xcalloc(count, sizeof(struct node));
+  for(i = 0; i < count; i++) {
+    nodes[i].id = i + 1;
+    nodes[i].x = (i / side) * spacing;
+    nodes[i].y = (i % side) * spacing;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+link_nodes(double range, double intf_range)
+{
+  struct node *a, *b;
+  int *nbr, *intf;
+  double d2;
+  int i, j;
+
+  nbr = xcalloc(num_nodes, sizeof(int));
+  intf = xcalloc(num_nodes, sizeof(int));
+  for(i = 0; i < num_nodes; i++) {
+    a = &nodes[i];
+    for(j = 0; j < num_nodes; j++) {
+      b = &nodes[j];
+      d2 = (a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y);
+      if(j == i) {
+        continue;
+      } else if(d2 <= range * range) {
+        nbr[a->num_nbr++] = j;
+      } else if(d2 <= intf_range * intf_range) {
+        intf[a->num_intf++] = j;
+      }
+    }
+    a->nbr = xcalloc(a->num_nbr, sizeof(int));
+    memcpy(a->nbr, nbr, a->num_nbr * sizeof(int));
+    a->intf = xcalloc(a->num_intf, sizeof(int));
+    memcpy(a->intf, intf, a->num_intf * sizeof(int));
+  }
+  free(nbr);
+  free(intf);
+}
+/*---------------------------------------------------------------------------*/
+static int
+usage(void)
+{
+  fprintf(stderr,
+          "usage: staffetta-netsim [-c scenario.csc | -n nodes] [-t seconds]\n"
+          "                        [-j threads] [-s seed] [-o log] [-m node.so]\n"
+          "  -c   node ids and positions, UDGM ranges from a Cooja scenario\n"
+          "  -n   grid of nodes, node 1 in a corner (default 9)\n"
+          "  -r   transmission range (default 50, or the scenario's)\n"
+          "  -d   grid spacing (default 0.8 * range)\n"
+          "  -t   simulated seconds (default 600)\n"
+          "  -j   worker threads (default 1)\n"
+          "  -s   seed (default 1)\n"
+          "  -o   log file (default stdout)\n"
+          "  -m   node image (default node.so next to the executable)\n");
+  return 2;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  const char *csc = NULL, *log = NULL;
+  char image_path[PATH_MAX], dir[PATH_MAX], *stacks;
+  double range = 50, intf_range = 100, spacing = 0, wall;
+  unsigned long seconds = 600, tx = 0, rx = 0, collisions = 0, overflows = 0;
+  struct timeval t0, t1;
+  void *image;
+  size_t size;
+  int c, i, count = 9;
+  ssize_t len;
+
+  image_path[0] = '\0';
+  while((c = getopt(argc, argv, "c:n:r:d:t:j:s:o:m:")) != -1) {
+    switch(c) {
+    case 'c': csc = optarg; break;
+    case 'n': count = atoi(optarg); break;
+    case 'r': range = atof(optarg); intf_range = 2 * range; break;
+    case 'd': spacing = atof(optarg); break;
+    case 't': seconds = strtoul(optarg, NULL, 10); break;
+    case 'j': num_workers = atoi(optarg); break;
+    case 's': run_seed = atoi(optarg); break;
+    case 'o': log = optarg; break;
+    case 'm': snprintf(image_path, sizeof(image_path), "%s", optarg); break;
+    default: return usage();
+    }
+  }
+  if(optind != argc || count < 1 || num_workers < 1) {
+    return usage();
+  }
+  if(image_path[0] == '\0') {
+    len = readlink("/proc/self/exe", image_path, sizeof(image_path) - 16);
+    image_path[len > 0 ? len : 0] = '\0';
+    strcpy(strrchr(image_path, '/') ? strrchr(image_path, '/') + 1 : image_path,
+           "node.so");
+  }
+  out = log ? fopen(log, "w") : stdout;
+  if(out == NULL) {
+    perror(log);
+    return 1;
+  }
+
+  if(csc != NULL) {
+    read_csc(csc, &range, &intf_range);
+  } else {
+    make_grid(count, spacing > 0 ? spacing : 0.8 * range);
+  }
+  if(num_nodes == 0) {
+    fprintf(stderr, "no nodes\n");
+    return 1;
+  }
+  link_nodes(range, intf_range);
+  if(num_workers > num_nodes) {
+    num_workers = num_nodes;
+  }
+
+  gettimeofday(&t0, NULL);
+  image = read_image(image_path, &size);
+  workers = xcalloc(num_workers, sizeof(struct worker));
+  for(i = 0; i < num_workers; i++) {
+    workers[i].active = xcalloc(num_nodes / num_workers + 1, sizeof(int));
+    workers[i].heap = xcalloc(num_nodes / num_workers + 1, sizeof(int));
+    workers[i].dirty = xcalloc(num_nodes / num_workers + 1, sizeof(int));
+  }
+  merged = xcalloc(num_nodes, sizeof(int));
+  /* one mapping for all stacks, every node image already takes several */
+  stacks = mmap(NULL, (size_t)num_nodes * STACK_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if(stacks == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  snprintf(dir, sizeof(dir), "%s/staffetta-netsim.XXXXXX",
+           getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+  if(mkdtemp(dir) == NULL) {
+    perror(dir);
+    return 1;
+  }
+  for(i = 0; i < num_nodes; i++) {
+    load_node(&nodes[i], dir, image, size, stacks + (size_t)i * STACK_SIZE);
+    /* every node boots at time 0 */
+    nodes[i].sleeping = 1;
+    nodes[i].sched = &workers[i % num_workers].sched;
+    heap_push(&workers[i % num_workers], i);
+  }
+  rmdir(dir);
+  free(image);
+  gettimeofday(&t1, NULL);
+  wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+  fprintf(stderr, "%d nodes loaded in %.1f s\n", num_nodes, wall);
+  t0 = t1;
+
+  duration = seconds * RTIMER_ARCH_SECOND;
+  window_end = LOOKAHEAD;
+  pthread_barrier_init(&barrier, NULL, num_workers);
+  for(i = 1; i < num_workers; i++) {
+    pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]);
+  }
+  worker_loop(&workers[0]);
+  for(i = 1; i < num_workers; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  gettimeofday(&t1, NULL);
+  fflush(out);
+
+  for(i = 0; i < num_nodes; i++) {
+    tx += nodes[i].tx;
+    rx += nodes[i].rx;
+    collisions += nodes[i].collisions;
+    overflows += nodes[i].overflows;
+  }
+  wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+  fprintf(stderr, "%d nodes, %d threads: %lu s simulated in %.1f s (%.1fx), "
+          "%lu frames sent, %lu received, %lu collisions, %lu overflows\n",
+          num_nodes, num_workers, seconds, wall, wall > 0 ? seconds / wall : 0,
+          tx, rx, collisions, overflows);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,560 @@
+/**
+ * \file
+ *         Deterministic host-side replay of the Staffetta state machine.
+ *
+ *         core/dev/staffetta.c is compiled for the host against a
+ *         scripted CC2420: frames arrive at given virtual times, the
+ *         rtimer advances one tick per read and every transmission is
+ *         recorded. A trace file drives the node and checks the RET_*
+ *         codes, the transmitted frames, the queue and the energest
+ *         accounting. With -b, exchanges are generated from a seed and
+ *         the run is summarized, to compare policies in seconds.
+ *
+ *         Trace commands (one per line, # starts a comment):
+ *           node <id>                    set node_id (before init)
+ *           init                         staffetta_init()
+ *           add <seq>                    staffetta_add_data(seq)
+ *           wait <ticks>                 advance the virtual time
+ *           rx <delay> <frame>           frame arrives <delay> ticks from now
+ *           reply <n> <delay> <frame>    frame arrives <delay> ticks after the
+ *                                        n-th transmission of the next send
+ *           send                         staffetta_send_packet()
+ *           expect ret <RET_*|number>
+ *           expect tx <count>            transmissions of the last send
+ *           expect txtype <n> <type>     type of the n-th transmission
+ *           expect txdst <n> <addr>      destination of the n-th transmission
+ *           expect txlen <n> <len>       length field of the n-th transmission
+ *           expect queue <size>
+ *           expect wakeups <n>
+ *           expect listen <ticks>        energest LISTEN time
+ *           expect transmit <ticks>      energest TRANSMIT time
+ *           expect phase <name> <ticks>  energest time of a Staffetta phase
+ *                                        (backoff, strobe, strobe_wait, ack,
+ *                                        select, fast_forward)
+ *         where <frame> is: <type> <src> <dst> <data> <seq> <ttl> <gradient> [badcrc]
+ *         and <type> is beacon, ack, select or a number.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+/* Staffetta prints go through the replay log, in the Cooja log format */
+static void replay_log(const char *fmt, ...);
+#define printf replay_log
+#include "dev/staffetta.c"
+#undef printf
+
+#define MAX_FRAMES      64
+#define MAX_TX          2048
+#define MAX_LINE        256
+#define AIR_OVERHEAD    6   /* preamble, SFD and length byte */
+#define BYTE_TICKS(n)   (((unsigned long)(n) * RTIMER_ARCH_SECOND * 32) / 1000000)
+
+struct replay_frame {
+  unsigned long at;     /* arrival of the length byte, or delay for replies */
+  int on_tx;            /* >0: scheduled after this transmission */
+  uint8_t len;
+  uint8_t read;
+  uint8_t buf[STAFFETTA_MAX_PKT_LEN + 3];
+};
+
+struct replay_tx {
+  unsigned long at;
+  uint8_t buf[STAFFETTA_MAX_PKT_LEN + 3];
+};
+
+unsigned short node_id;
+
+static unsigned long now;
+static int radio_is_on, verbose;
+
+static struct replay_frame frames[MAX_FRAMES];
+static int num_frames;
+
+static uint8_t txfifo[STAFFETTA_MAX_PKT_LEN + 3];
+static int txfifo_len;
+static struct replay_tx txlog[MAX_TX];
+static int num_tx;
+static unsigned long tx_air_ticks;
+
+static uint32_t replay_seed = 1;
+
+static const char *phase_names[NUM_PHASES] = {
+  "backoff", "strobe", "strobe_wait", "ack", "select", "fast_forward"
+};
+/*---------------------------------------------------------------------------*/
+/* Platform services used by staffetta.c */
+unsigned short
+shim_rtimer_now(void)
+{
+  now++;
+  return (unsigned short)now;
+}
+clock_time_t
+clock_time(void)
+{
+  return (clock_time_t)(now * CLOCK_SECOND / RTIMER_ARCH_SECOND);
+}
+unsigned long
+clock_seconds(void)
+{
+  return now / RTIMER_ARCH_SECOND;
+}
+void
+ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr)
+{
+}
+void
+ctimer_stop(struct ctimer *c)
+{
+}
+unsigned short
+random_rand(void)
+{
+  replay_seed = replay_seed * 1103515245 + 12345;
+  return (replay_seed >> 16) & 0x7fff;
+}
+void leds_on(unsigned char leds) {}
+void leds_off(unsigned char leds) {}
+void watchdog_stop(void) {}
+/*---------------------------------------------------------------------------*/
+static void
+replay_log(const char *fmt, ...)
+{
+  va_list ap;
+  unsigned long ms;
+
+  if(!verbose) {
+    return;
+  }
+  ms = now * 1000 / RTIMER_ARCH_SECOND;
+  fprintf(stdout, "%02lu:%02lu.%03lu\tID:%u\t", ms / 60000, (ms / 1000) % 60,
+          ms % 1000, node_id);
+  va_start(ap, fmt);
+  vfprintf(stdout, fmt, ap);
+  va_end(ap);
+}
+/*---------------------------------------------------------------------------*/
+/* Scripted radio */
+static void
+drop_frames_until(unsigned long t)
+{
+  int i, j;
+
+  for(i = 0, j = 0; i < num_frames; i++) {
+    if(frames[i].on_tx != 0 || frames[i].at > t) {
+      frames[j++] = frames[i];
+    }
+  }
+  num_frames = j;
+}
+/*---------------------------------------------------------------------------*/
+static struct replay_frame *
+head_frame(void)
+{
+  int i;
+  struct replay_frame *head = NULL;
+
+  for(i = 0; i < num_frames; i++) {
+    if(frames[i].on_tx == 0 && (head == NULL || frames[i].at < head->at)) {
+      head = &frames[i];
+    }
+  }
+  return head;
+}
+/*---------------------------------------------------------------------------*/
+static void
+transmit(void)
+{
+  int i;
+
+  if(txfifo_len == 0) {
+    return;
+  }
+  if(num_tx < MAX_TX) {
+    txlog[num_tx].at = now;
+    memcpy(txlog[num_tx].buf, txfifo, txfifo_len);
+  }
+  num_tx++;
+  now += BYTE_TICKS(txfifo_len + AIR_OVERHEAD);
+  tx_air_ticks += BYTE_TICKS(txfifo_len + AIR_OVERHEAD);
+
+  for(i = 0; i < num_frames; i++) {
+    if(frames[i].on_tx == num_tx) {
+      frames[i].on_tx = 0;
+      frames[i].at += now;
+    }
+  }
+  if(verbose) {
+    fprintf(stdout, "tx %lu type %u len %u\n", now, PKT_GET_TYPE(txfifo),
+            txfifo[PKT_LEN]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_strobe(unsigned char s)
+{
+  switch(s) {
+  case CC2420_SRXON:
+    /* whatever arrived while the radio was off is lost */
+    drop_frames_until(now - 1);
+    radio_is_on = 1;
+    break;
+  case CC2420_SRFOFF:
+    drop_frames_until(now);
+    radio_is_on = 0;
+    break;
+  case CC2420_SFLUSHRX:
+    drop_frames_until(now);
+    break;
+  case CC2420_SFLUSHTX:
+    txfifo_len = 0;
+    break;
+  case CC2420_STXON:
+    transmit();
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+unsigned char
+shim_status(void)
+{
+  /* transmissions complete synchronously in transmit() */
+  return BV(CC2420_XOSC16M_STABLE);
+}
+/*---------------------------------------------------------------------------*/
+void
+shim_write_fifo(const unsigned char *p, int c)
+{
+  if(c > (int)sizeof(txfifo)) {
+    c = sizeof(txfifo);
+  }
+  memcpy(txfifo, p, c);
+  txfifo_len = c;
+}
+/*---------------------------------------------------------------------------*/
+int
+shim_fifo_is_1(void)
+{
+  struct replay_frame *f;
+
+  f = head_frame();
+  return radio_is_on && f != NULL && f->at + f->read <= now;
+}
+/*---------------------------------------------------------------------------*/
+unsigned char
+shim_read_fifo_byte(void)
+{
+  struct replay_frame *f;
+  unsigned char b;
+
+  f = head_frame();
+  if(f == NULL || f->at + f->read > now) {
+    return 0;
+  }
+  b = f->buf[f->read++];
+  if(f->read == f->len) {
+    *f = frames[--num_frames];
+  }
+  return b;
+}
+/*---------------------------------------------------------------------------*/
+/* Trace parsing */
+static int
+parse_type(const char *s)
+{
+  if(strcmp(s, "beacon") == 0) {
+    return TYPE_BEACON;
+  } else if(strcmp(s, "ack") == 0) {
+    return TYPE_BEACON_ACK;
+  } else if(strcmp(s, "select") == 0) {
+    return TYPE_SELECT;
+  }
+  return atoi(s);
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_ret(const char *s)
+{
+  static const char *names[] = {
+    "", "RET_FAST_FORWARD", "RET_NO_RX", "RET_EMPTY_QUEUE", "RET_ERRORS",
+    "RET_WRONG_SELECT", "RET_FAIL_RX_BUFF", "RET_WRONG_TYPE",
+    "RET_WRONG_CRC", "RET_WRONG_GRADIENT", "RET_FAIL_HISTORY"
+  };
+  int i;
+
+  for(i = 1; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+    if(strcmp(s, names[i]) == 0) {
+      return i;
+    }
+  }
+  return atoi(s);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_frame(unsigned long at, int on_tx, int type, uint16_t src, uint16_t dst,
+          uint16_t origin, uint8_t seqno, uint8_t hops, uint8_t gradient,
+          int badcrc)
+{
+  struct replay_frame *f;
+
+  if(num_frames == MAX_FRAMES) {
+    fprintf(stderr, "too many pending frames\n");
+    exit(2);
+  }
+  f = &frames[num_frames++];
+  f->at = at;
+  f->on_tx = on_tx;
+  f->read = 0;
+  pkt_set_header(f->buf, type, src, dst, origin);
+  f->buf[PKT_SEQ] = seqno;
+  f->buf[PKT_TTL] = hops;
+  f->buf[PKT_GRADIENT] = gradient;
+  PKT_RSSI_BYTE(f->buf) = 0;
+  PKT_CRC_BYTE(f->buf) = badcrc ? 0x40 : (FOOTER1_CRC_OK | 0x40);
+  f->len = f->buf[PKT_LEN] + 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_frame(char **tok, int ntok, unsigned long at, int on_tx)
+{
+  if(ntok < 7) {
+    return 0;
+  }
+  add_frame(at, on_tx, parse_type(tok[0]), atoi(tok[1]), atoi(tok[2]),
+            atoi(tok[3]), atoi(tok[4]), atoi(tok[5]), atoi(tok[6]),
+            ntok > 7 && strcmp(tok[7], "badcrc") == 0);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check(const char *what, long expected, long got, const char *file, int line)
+{
+  if(expected != got) {
+    fprintf(stderr, "%s:%d: expected %s %ld, got %ld\n", file, line, what,
+            expected, got);
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+expect(char **tok, int ntok, int ret, const char *file, int line)
+{
+  int n;
+
+  if(ntok >= 2 && strcmp(tok[0], "ret") == 0) {
+    return check("ret", parse_ret(tok[1]), ret, file, line);
+  } else if(ntok >= 2 && strcmp(tok[0], "tx") == 0) {
+    return check("tx", atol(tok[1]), num_tx, file, line);
+  } else if(ntok >= 3 && strcmp(tok[0], "txtype") == 0) {
+    n = atoi(tok[1]);
+    if(n < 1 || n > num_tx || n > MAX_TX) {
+      return check("transmission", n, num_tx, file, line);
+    }
+    return check("txtype", parse_type(tok[2]),
+                 PKT_GET_TYPE(txlog[n - 1].buf), file, line);
+  } else if(ntok >= 3 && strcmp(tok[0], "txdst") == 0) {
+    n = atoi(tok[1]);
+    if(n < 1 || n > num_tx || n > MAX_TX) {
+      return check("transmission", n, num_tx, file, line);
+    }
+    return check("txdst", atol(tok[2]), PKT_GET_DST(txlog[n - 1].buf),
+                 file, line);
+  } else if(ntok >= 3 && strcmp(tok[0], "txlen") == 0) {
+    n = atoi(tok[1]);
+    if(n < 1 || n > num_tx || n > MAX_TX) {
+      return check("transmission", n, num_tx, file, line);
+    }
+    return check("txlen", atol(tok[2]), txlog[n - 1].buf[PKT_LEN], file, line);
+  } else if(ntok >= 2 && strcmp(tok[0], "queue") == 0) {
+    return check("queue", atol(tok[1]), q_size, file, line);
+  } else if(ntok >= 2 && strcmp(tok[0], "wakeups") == 0) {
+    return check("wakeups", atol(tok[1]), num_wakeups, file, line);
+  } else if(ntok >= 2 && strcmp(tok[0], "listen") == 0) {
+    return check("listen", atol(tok[1]),
+                 energest_type_time(ENERGEST_TYPE_LISTEN), file, line);
+  } else if(ntok >= 2 && strcmp(tok[0], "transmit") == 0) {
+    return check("transmit", atol(tok[1]),
+                 energest_type_time(ENERGEST_TYPE_TRANSMIT), file, line);
+  } else if(ntok >= 3 && strcmp(tok[0], "phase") == 0) {
+    for(n = 0; n < NUM_PHASES; n++) {
+      if(strcmp(tok[1], phase_names[n]) == 0) {
+        return check(tok[1], atol(tok[2]),
+                     (unsigned long)phase_time[n], file, line);
+      }
+    }
+  }
+  fprintf(stderr, "%s:%d: unknown expectation\n", file, line);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+send(void)
+{
+  num_tx = 0;
+  return staffetta_send_packet();
+}
+/*---------------------------------------------------------------------------*/
+static void
+start(void)
+{
+  energest_init();
+  /* staffetta computes its duty cycle over CPU+LPM time */
+  ENERGEST_ON(ENERGEST_TYPE_CPU);
+  process_init();
+  staffetta_init();
+}
+/*---------------------------------------------------------------------------*/
+static int
+run_trace(const char *file)
+{
+  FILE *f;
+  char buf[MAX_LINE], *tok[16], *p;
+  int ntok, line, failures, ret;
+
+  f = fopen(file, "r");
+  if(f == NULL) {
+    perror(file);
+    return 1;
+  }
+  failures = 0;
+  ret = 0;
+  for(line = 1; fgets(buf, sizeof(buf), f) != NULL; line++) {
+    if((p = strchr(buf, '#')) != NULL) {
+      *p = 0;
+    }
+    for(ntok = 0, p = strtok(buf, " \t\r\n"); p != NULL && ntok < 16;
+        p = strtok(NULL, " \t\r\n")) {
+      tok[ntok++] = p;
+    }
+    if(ntok == 0) {
+      continue;
+    }
+    if(strcmp(tok[0], "node") == 0 && ntok >= 2) {
+      node_id = atoi(tok[1]);
+    } else if(strcmp(tok[0], "init") == 0) {
+      start();
+    } else if(strcmp(tok[0], "add") == 0 && ntok >= 2) {
+      staffetta_add_data(atoi(tok[1]));
+    } else if(strcmp(tok[0], "wait") == 0 && ntok >= 2) {
+      now += atol(tok[1]);
+    } else if(strcmp(tok[0], "rx") == 0 && ntok >= 2 &&
+              parse_frame(&tok[2], ntok - 2, now + atol(tok[1]), 0)) {
+    } else if(strcmp(tok[0], "reply") == 0 && ntok >= 3 &&
+              parse_frame(&tok[3], ntok - 3, atol(tok[2]), atoi(tok[1]))) {
+    } else if(strcmp(tok[0], "send") == 0) {
+      ret = send();
+      if(verbose) {
+        fprintf(stdout, "ret %d\n", ret);
+      }
+    } else if(strcmp(tok[0], "expect") == 0 && ntok >= 2) {
+      failures += expect(&tok[1], ntok - 1, ret, file, line);
+    } else {
+      fprintf(stderr, "%s:%d: cannot parse '%s'\n", file, line, tok[0]);
+      failures++;
+    }
+  }
+  fclose(f);
+  fprintf(stderr, "%s: %s\n", file, failures ? "FAIL" : "OK");
+  return failures != 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Generated exchanges for benchmarking */
+static unsigned
+gen_rand(unsigned n)
+{
+  return random_rand() % n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_bench(unsigned long exchanges)
+{
+  unsigned long i, results[RET_FAIL_HISTORY + 1] = {0};
+  unsigned long air;
+  uint16_t neighbor;
+  uint8_t next_seq = 0;
+  clock_t host;
+  int r;
+
+  node_id = 5;
+  start();
+  host = clock();
+  for(i = 0; i < exchanges; i++) {
+    if(q_size < 2) {
+      staffetta_add_data(next_seq++);
+    }
+    neighbor = 2 + gen_rand(20);
+    if(gen_rand(100) < 20) {
+      /* a neighbor wakes up during our backoff and hands us a packet */
+      add_frame(now + 20 + gen_rand(BACKOFF_TIME / 2), 0, TYPE_BEACON,
+                neighbor, 0, neighbor, gen_rand(256), gen_rand(8),
+                gen_rand(num_wakeups + 5), gen_rand(100) < 2);
+      if(gen_rand(100) < 80) {
+        add_frame(5, 1, TYPE_SELECT, neighbor, node_id, 0, 0, 0, 0, 0);
+      }
+    } else if(gen_rand(100) < 90) {
+      /* a forwarder answers one of our strobes */
+      add_frame(5, 1 + gen_rand(200), TYPE_BEACON_ACK, neighbor, node_id,
+                read_data(), read_seq(), read_ttl(), 0, gen_rand(100) < 2);
+    }
+    r = send();
+    results[r <= RET_FAIL_HISTORY ? r : 0]++;
+    num_frames = 0;
+    /* sleep until the next wakeup */
+    now += (RTIMER_ARCH_SECOND * 10UL / getWakeups()) * (3 + gen_rand(3)) / 4;
+  }
+  host = clock() - host;
+  air = tx_air_ticks;
+
+  printf("exchanges %lu host_ms %lu us_per_exchange %.2f\n", exchanges,
+         (unsigned long)(host * 1000 / CLOCKS_PER_SEC),
+         exchanges ? (double)host * 1000000 / CLOCKS_PER_SEC / exchanges : 0);
+  for(r = 1; r <= RET_FAIL_HISTORY; r++) {
+    printf("ret %d %lu\n", r, results[r]);
+  }
+  printf("virtual_s %lu listen %lu tx_air %lu wakeups %lu avg_rendezvous %lu queue %u\n",
+         now / RTIMER_ARCH_SECOND, energest_type_time(ENERGEST_TYPE_LISTEN),
+         air, (unsigned long)num_wakeups, (unsigned long)avg_rendezvous,
+         q_size);
+}
+/*---------------------------------------------------------------------------*/
+static int
+usage(void)
+{
+  fprintf(stderr, "Usage: staffetta-replay [-v] trace\n");
+  fprintf(stderr, "       staffetta-replay [-v] [-s seed] -b exchanges\n");
+  return 2;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  int i;
+  unsigned long bench = 0;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if(strcmp(argv[i], "-v") == 0) {
+      verbose = 1;
+    } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      replay_seed = strtoul(argv[++i], NULL, 0);
+    } else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      bench = strtoul(argv[++i], NULL, 0);
+    } else {
+      return usage();
+    }
+  }
+  if(bench > 0) {
+    run_bench(bench);
+    return 0;
+  }
+  /* one trace per run, so that every trace starts from a fresh node */
+  if(i != argc - 1) {
+    return usage();
+  }
+  return run_trace(argv[i]);
+}
+/*---------------------------------------------------------------------------*/
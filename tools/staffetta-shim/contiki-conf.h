@@ -0,0 +1,32 @@
+/*
+ * Host configuration shared by the Staffetta replay harness and network
+ * simulator. Mirrors the Tmote Sky clocks so the state machine sees the
+ * same timing as on the mote.
+ */
+
+#ifndef __CONTIKI_CONF_H__
+#define __CONTIKI_CONF_H__
+
+#include <stdint.h>
+
+#define CC_CONF_REGISTER_ARGS          1
+#define CC_CONF_FUNCTION_POINTER_ARGS  1
+#define CC_CONF_VA_ARGS                1
+
+#define CCIF
+#define CLIF
+
+#define ENERGEST_CONF_ON 1
+#define WITH_FLOCKLAB_SINK 0
+
+/* The harness provides timesynch for synchronized wakeups */
+#ifdef STAFFETTA_CONF_SYNC_WAKEUP
+#define TIMESYNCH_CONF_ENABLED STAFFETTA_CONF_SYNC_WAKEUP
+#endif
+
+#define CLOCK_CONF_SECOND 128UL
+typedef unsigned long clock_time_t;
+
+#define BV(x) (1 << (x))
+
+#endif /* __CONTIKI_CONF_H__ */
@@ -0,0 +1,25 @@
+/*
+ * CC2420 SPI access for the Staffetta host harnesses. The FIFO, the
+ * command strobes and the status byte go to the virtual radio of
+ * staffetta-replay.c or staffetta-netsim.c instead of the SPI bus.
+ */
+
+#ifndef __SPI_H__
+#define __SPI_H__
+
+#include "contiki-conf.h"
+
+void shim_strobe(unsigned char s);
+unsigned char shim_status(void);
+void shim_write_fifo(const unsigned char *p, int c);
+unsigned char shim_read_fifo_byte(void);
+int shim_fifo_is_1(void);
+
+#define FASTSPI_STROBE(s)         shim_strobe(s)
+#define FASTSPI_UPD_STATUS(s)     do { (s) = shim_status(); } while(0)
+#define FASTSPI_WRITE_FIFO(p,c)   shim_write_fifo((const unsigned char *)(p), (c))
+#define FASTSPI_READ_FIFO_BYTE(b) do { (b) = shim_read_fifo_byte(); } while(0)
+
+#define FIFO_IS_1                 shim_fifo_is_1()
+
+#endif /* __SPI_H__ */
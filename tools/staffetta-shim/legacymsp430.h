@@ -0,0 +1 @@
+/* Empty on purpose: the host harnesses have no MSP430 registers. */
@@ -0,0 +1,18 @@
+/*
+ * Virtual rtimer for the Staffetta host harnesses. Every read of the
+ * timer costs one tick, which keeps the busy-wait loops of the state
+ * machine finite; the network simulator also switches to the next node
+ * when the local time leaves the current window.
+ */
+
+#ifndef __RTIMER_ARCH_H__
+#define __RTIMER_ARCH_H__
+
+#include "contiki-conf.h"
+
+#define RTIMER_ARCH_SECOND (32768U)
+
+unsigned short shim_rtimer_now(void);
+#define rtimer_arch_now() shim_rtimer_now()
+
+#endif /* __RTIMER_ARCH_H__ */
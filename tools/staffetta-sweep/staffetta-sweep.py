@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+#
+# Headless parameter sweep for the Staffetta Cooja scenarios.
+#
+# Reads a sweep file (see sweep.conf), builds one staffetta-test firmware per
+# combination of compile-time options, generates one .csc per run from a
+# scenario template, runs the simulations in parallel with Cooja -nogui and
+# collects the logs into a results table.
+#
+#   staffetta-sweep.py [-j jobs] [-o outdir] [--dry-run] sweep.conf
+#
+# Every run lives in its own directory under outdir/runs and a finished run
+# is never repeated, so an interrupted sweep is resumed by starting it again.
+
+import argparse
+import csv
+import itertools
+import os
+import shutil
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+CONTIKI = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+APP = os.path.join(CONTIKI, "apps", "staffetta-test")
+COOJA_JAR = os.path.join(CONTIKI, "tools", "cooja", "dist", "cooja.jar")
+LOGSTAT = os.path.join(CONTIKI, "tools", "staffetta-logstat")
+TOPOLOGY = os.path.join(CONTIKI, "tools", "csc", "csc-generate-topology")
+
+# Gradient modes map onto the staffetta.h gradient options
+GRADIENTS = {
+    "wakeups": {},
+    "none": {"WITH_GRADIENT": 0},
+    "hop": {"HC_GRADIENT": 1},
+    "bcp": {"BCP_GRADIENT": 1},
+    "edc": {"ORW_GRADIENT": 1},
+}
+
+DEFAULTS = {
+    "template": os.path.join(CONTIKI, "cooja_sim", "staffetta_9.csc"),
+    "nodes": "9",
+    "layout": "grid",
+    "sink": "corner",
+    "spacing": "",
+    "degree": "8",
+    "budget": "750",
+    "gradient": "wakeups",
+    "avg_size": "5",
+    "seeds": "123456",
+    "duration": "600",
+    "timeout": "0",
+}
+
+SWEPT = ("nodes", "layout", "budget", "gradient", "avg_size", "seeds")
+
+LAYOUTS = ("grid", "random", "clustered", "corridor")
+
+# Cooja writes the script log to COOJA.testlog in its working directory.
+# Print it in the loglistener format the analysis tools expect.
+SCRIPT = """TIMEOUT(%d, log.testOK());
+function pad(n, w) { n = "" + n; while (n.length < w) n = "0" + n; return n; }
+while (true) {
+  var ms = Math.floor(time / 1000);
+  log.log(pad(Math.floor(ms / 60000), 2) + ":" + pad(Math.floor(ms / 1000) %% 60, 2) +
+          "." + pad(ms %% 1000, 3) + "\\tID:" + id + "\\t" + msg + "\\n");
+  YIELD();
+}
+"""
+
+
+def read_sweep(path):
+    conf = dict(DEFAULTS)
+    with open(path) as f:
+        for num, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            if "=" not in line:
+                sys.exit("%s:%d: expected 'key = values'" % (path, num))
+            key, value = [s.strip() for s in line.split("=", 1)]
+            if key not in DEFAULTS:
+                sys.exit("%s:%d: unknown key '%s'" % (path, num, key))
+            conf[key] = value
+    if not os.path.isabs(conf["template"]):
+        conf["template"] = os.path.join(os.path.dirname(os.path.abspath(path)),
+                                        conf["template"])
+    grid = {k: conf[k].split() for k in SWEPT}
+    for g in grid["gradient"]:
+        if g not in GRADIENTS:
+            sys.exit("unknown gradient '%s' (%s)" % (g, ", ".join(GRADIENTS)))
+    for l in grid["layout"]:
+        if l not in LAYOUTS:
+            sys.exit("unknown layout '%s' (%s)" % (l, ", ".join(LAYOUTS)))
+    return conf, grid
+
+
+def firmware_defines(budget, gradient, avg_size):
+    opts = {"BUDGET": budget, "AVG_SIZE": avg_size}
+    opts.update(GRADIENTS[gradient])
+    return ",".join("STAFFETTA_CONF_%s=%s" % kv for kv in sorted(opts.items()))
+
+
+def firmware_path(outdir, budget, gradient, avg_size):
+    return os.path.join(outdir, "firmware",
+                        "b%s-%s-a%s.sky" % (budget, gradient, avg_size))
+
+
+def build_firmware(outdir, budget, gradient, avg_size):
+    fw = firmware_path(outdir, budget, gradient, avg_size)
+    if os.path.exists(fw):
+        return fw
+    name = os.path.basename(fw)[:-len(".sky")]
+    # Each configuration builds in its own copy of the app, so that
+    # obj_sky and the saved defines of different builds never mix
+    builddir = os.path.join(outdir, "build", name)
+    shutil.rmtree(builddir, ignore_errors=True)
+    shutil.copytree(APP, builddir)
+    cmd = ["make", "-C", builddir, "staffetta-test.sky", "TARGET=sky",
+           "CONTIKI=" + CONTIKI,
+           "DEFINES=" + firmware_defines(budget, gradient, avg_size)]
+    with open(os.path.join(builddir, "build.log"), "w") as log:
+        if subprocess.call(cmd, stdout=log, stderr=subprocess.STDOUT) != 0:
+            raise RuntimeError("firmware build failed, see %s/build.log" % builddir)
+    os.makedirs(os.path.dirname(fw), exist_ok=True)
+    shutil.copy(os.path.join(builddir, "staffetta-test.sky"), fw)
+    return fw
+
+
+def make_csc(conf, run, firmware, duration):
+    """Generate the run's topology with csc-generate-topology"""
+    rundir = run["dir"]
+    with open(os.path.join(rundir, "log.js"), "w") as f:
+        f.write(SCRIPT % (duration * 1000))
+    cmd = [TOPOLOGY, conf["template"], "-n", run["nodes"], "-l", run["layout"],
+           "-s", run["seeds"], "--sink", conf["sink"], "--degree", conf["degree"],
+           "--title", run["name"], "--firmware", firmware,
+           "--script", os.path.join(rundir, "log.js"),
+           "-o", os.path.join(rundir, "run.csc")]
+    if conf["spacing"]:
+        cmd += ["--spacing", conf["spacing"]]
+    with open(os.path.join(rundir, "topology.txt"), "w") as out:
+        if subprocess.call(cmd, stderr=out) != 0:
+            raise RuntimeError("topology generation failed, see %s/topology.txt" % rundir)
+
+
+def run_cooja(rundir, timeout):
+    log = os.path.join(rundir, "loglistener.txt")
+    cmd = ["java", "-Xshare:on", "-jar", COOJA_JAR,
+           "-nogui=run.csc", "-contiki=" + CONTIKI]
+    start = time.time()
+    with open(os.path.join(rundir, "cooja.log"), "w") as out:
+        try:
+            ret = subprocess.call(cmd, cwd=rundir, stdout=out,
+                                  stderr=subprocess.STDOUT,
+                                  timeout=timeout or None)
+        except subprocess.TimeoutExpired:
+            ret = "timeout"
+    testlog = os.path.join(rundir, "COOJA.testlog")
+    if ret == 0 and os.path.exists(testlog):
+        os.rename(testlog, log)
+        status = "ok"
+    else:
+        status = "failed (%s)" % ret
+    with open(os.path.join(rundir, "status"), "w") as f:
+        f.write("%s %.0f\n" % (status, time.time() - start))
+    return status
+
+
+def logstat(logs):
+    """Run staffetta-logstat over the logs, return {log: {metric: value}}"""
+    tool = os.path.join(LOGSTAT, "staffetta-logstat")
+    if subprocess.call(["make", "-s", "-C", LOGSTAT]) != 0 or not logs:
+        return {}
+    out = subprocess.check_output([tool] + logs, universal_newlines=True)
+    stats, cur = {}, None
+    for line in out.splitlines():
+        key, _, value = line.partition(": ")
+        if key == "file":
+            cur = stats.setdefault(value, {})
+        elif cur is not None and value and key in ("generated", "delivered",
+                                                   "duplicates", "pdr",
+                                                   "avg latency", "p95 latency",
+                                                   "avg power", "var power",
+                                                   "avg duty"):
+            cur[key.replace(" ", "_")] = value
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Staffetta Cooja parameter sweep")
+    parser.add_argument("sweep", help="sweep file")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(),
+                        help="concurrent Cooja instances (default: cores)")
+    parser.add_argument("-o", "--outdir", default="sweep-out")
+    parser.add_argument("--dry-run", action="store_true",
+                        help="generate the .csc files without running them")
+    args = parser.parse_args()
+
+    conf, grid = read_sweep(args.sweep)
+    outdir = os.path.abspath(args.outdir)
+    duration = int(conf["duration"])
+
+    runs = []
+    for values in itertools.product(*(grid[k] for k in SWEPT)):
+        run = dict(zip(SWEPT, values))
+        run["name"] = "n%(nodes)s-%(layout)s-b%(budget)s-%(gradient)s-a%(avg_size)s-s%(seeds)s" % run
+        runs.append(run)
+    print("%d runs in %s" % (len(runs), outdir))
+
+    configs = sorted(set((r["budget"], r["gradient"], r["avg_size"]) for r in runs))
+    firmwares = {c: firmware_path(outdir, *c) for c in configs}
+    if not args.dry_run:
+        with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+            for f in [pool.submit(build_firmware, outdir, *c) for c in configs]:
+                f.result()
+
+    pending = []
+    for run in runs:
+        rundir = os.path.join(outdir, "runs", run["name"])
+        run["dir"] = rundir
+        if os.path.exists(os.path.join(rundir, "loglistener.txt")):
+            continue
+        os.makedirs(rundir, exist_ok=True)
+        fw = firmwares[(run["budget"], run["gradient"], run["avg_size"])]
+        make_csc(conf, run, fw, duration)
+        pending.append(run)
+    print("%d runs to simulate, %d already done" % (len(pending), len(runs) - len(pending)))
+    if args.dry_run:
+        return
+
+    with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        jobs = {pool.submit(run_cooja, r["dir"], int(conf["timeout"])): r for r in pending}
+        for done, f in enumerate(as_completed(jobs), 1):
+            print("[%d/%d] %s: %s" % (done, len(pending), jobs[f]["name"], f.result()))
+            sys.stdout.flush()
+
+    logs = [os.path.join(r["dir"], "loglistener.txt") for r in runs]
+    stats = logstat([l for l in logs if os.path.exists(l)])
+    columns = list(SWEPT) + ["status", "generated", "delivered", "duplicates",
+                             "pdr", "avg_latency", "p95_latency", "avg_power",
+                             "var_power", "avg_duty"]
+    with open(os.path.join(outdir, "results.csv"), "w") as f:
+        table = csv.writer(f)
+        table.writerow(columns)
+        for run, log in zip(runs, logs):
+            row = dict(run)
+            row.update(stats.get(log, {}))
+            try:
+                with open(os.path.join(run["dir"], "status")) as s:
+                    row["status"] = s.read().rsplit(" ", 1)[0]
+            except IOError:
+                row["status"] = "done" if log in stats else "missing"
+            table.writerow([row.get(c, "") for c in columns])
+    print("results in %s" % os.path.join(outdir, "results.csv"))
+
+
+if __name__ == "__main__":
+    main()